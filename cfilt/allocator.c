@@ -0,0 +1,228 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/allocator.h"
+
+#include <stdlib.h>
+
+static void*
+cfilt_allocator_default_alloc(void* ctx, size_t size, size_t align)
+{
+    (void)ctx;
+
+    void* ptr;
+    if (posix_memalign(&ptr, align, size ? size : 1))
+    {
+        return NULL;
+    }
+
+    return ptr;
+}
+
+static void
+cfilt_allocator_default_free(void* ctx, void* ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+static cfilt_allocator default_allocator = {
+    cfilt_allocator_default_alloc, cfilt_allocator_default_free, NULL, 0, 0
+};
+
+static cfilt_allocator* global_allocator = &default_allocator;
+
+cfilt_allocator*
+cfilt_allocator_default(void)
+{
+    return &default_allocator;
+}
+
+void
+cfilt_allocator_set(cfilt_allocator* allocator)
+{
+    global_allocator = allocator ? allocator : &default_allocator;
+}
+
+cfilt_allocator*
+cfilt_allocator_get(void)
+{
+    return global_allocator;
+}
+
+void*
+cfilt_alloc(cfilt_allocator* allocator, const size_t size, const size_t align)
+{
+    if (allocator == NULL)
+    {
+        allocator = global_allocator;
+    }
+
+    void* ptr = allocator->alloc(allocator->ctx, size, align);
+    if (ptr)
+    {
+        ++allocator->allocs;
+    }
+
+    return ptr;
+}
+
+void
+cfilt_free(cfilt_allocator* allocator, void* ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    if (allocator == NULL)
+    {
+        allocator = global_allocator;
+    }
+
+    ++allocator->frees;
+    allocator->free(allocator->ctx, ptr);
+}
+
+// The headers are the first member so that frees can find their allocator
+typedef struct
+{
+    gsl_matrix matrix;
+    cfilt_allocator* allocator;
+} cfilt_matrix_block;
+
+typedef struct
+{
+    gsl_vector vector;
+    cfilt_allocator* allocator;
+} cfilt_vector_block;
+
+typedef struct
+{
+    gsl_permutation permutation;
+    cfilt_allocator* allocator;
+} cfilt_permutation_block;
+
+gsl_matrix*
+cfilt_matrix_alloc(cfilt_allocator* allocator, const size_t n, const size_t m)
+{
+    if (allocator == NULL)
+    {
+        allocator = global_allocator;
+    }
+
+    const size_t header = CFILT_ALIGN_UP(sizeof(cfilt_matrix_block));
+    cfilt_matrix_block* block =
+      cfilt_alloc(allocator, header + n * m * sizeof(double), CFILT_ALIGN);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    block->matrix.size1 = n;
+    block->matrix.size2 = m;
+    block->matrix.tda = m;
+    block->matrix.data = (double*)((char*)block + header);
+    block->matrix.block = NULL;
+    block->matrix.owner = 0;
+    block->allocator = allocator;
+
+    return &block->matrix;
+}
+
+void
+cfilt_matrix_free(gsl_matrix* mat)
+{
+    if (mat)
+    {
+        cfilt_matrix_block* block = (cfilt_matrix_block*)mat;
+        cfilt_free(block->allocator, block);
+    }
+}
+
+gsl_vector*
+cfilt_vector_alloc(cfilt_allocator* allocator, const size_t n)
+{
+    if (allocator == NULL)
+    {
+        allocator = global_allocator;
+    }
+
+    const size_t header = CFILT_ALIGN_UP(sizeof(cfilt_vector_block));
+    cfilt_vector_block* block =
+      cfilt_alloc(allocator, header + n * sizeof(double), CFILT_ALIGN);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    block->vector.size = n;
+    block->vector.stride = 1;
+    block->vector.data = (double*)((char*)block + header);
+    block->vector.block = NULL;
+    block->vector.owner = 0;
+    block->allocator = allocator;
+
+    return &block->vector;
+}
+
+void
+cfilt_vector_free(gsl_vector* vec)
+{
+    if (vec)
+    {
+        cfilt_vector_block* block = (cfilt_vector_block*)vec;
+        cfilt_free(block->allocator, block);
+    }
+}
+
+gsl_permutation*
+cfilt_permutation_alloc(cfilt_allocator* allocator, const size_t n)
+{
+    if (allocator == NULL)
+    {
+        allocator = global_allocator;
+    }
+
+    const size_t header = CFILT_ALIGN_UP(sizeof(cfilt_permutation_block));
+    cfilt_permutation_block* block =
+      cfilt_alloc(allocator, header + n * sizeof(size_t), CFILT_ALIGN);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    block->permutation.size = n;
+    block->permutation.data = (size_t*)((char*)block + header);
+    block->allocator = allocator;
+
+    gsl_permutation_init(&block->permutation);
+
+    return &block->permutation;
+}
+
+void
+cfilt_permutation_free(gsl_permutation* perm)
+{
+    if (perm)
+    {
+        cfilt_permutation_block* block = (cfilt_permutation_block*)perm;
+        cfilt_free(block->allocator, block);
+    }
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_ALLOCATOR_H_
+#define CFILT_ALLOCATOR_H_
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_permutation.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Every allocation made by cfilt goes through a cfilt_allocator. Objects
+ * remember the allocator they were allocated from and give their memory back
+ * to it, so the global allocator can be changed at any time. The *_alloc_from
+ * variants of the filters' alloc functions take a specific allocator, NULL
+ * meaning the global one.
+ *
+ * alloc returns memory aligned on at least align bytes (a power of two no
+ * smaller than sizeof(void*)) or NULL. allocs and frees count the calls that
+ * went through the allocator and are updated without synchronization.
+ *
+ * Matrices, vectors and permutations from cfilt_*_alloc hold their data in
+ * the same allocation as their header. They must be released with the
+ * matching cfilt_*_free, never with gsl_*_free.
+ */
+
+#define CFILT_ALIGN 64
+#define CFILT_ALIGN_UP(size)                                                   \
+    (((size) + CFILT_ALIGN - 1) & ~(size_t)(CFILT_ALIGN - 1))
+
+typedef struct
+{
+    void* (*alloc)(void* ctx, size_t size, size_t align);
+    void (*free)(void* ctx, void* ptr);
+    void* ctx;
+
+    size_t allocs;
+    size_t frees;
+} cfilt_allocator;
+
+// posix_memalign and free
+cfilt_allocator* cfilt_allocator_default(void);
+
+// NULL restores the default allocator
+void cfilt_allocator_set(cfilt_allocator* allocator);
+
+cfilt_allocator* cfilt_allocator_get(void);
+
+void* cfilt_alloc(cfilt_allocator* allocator, const size_t size,
+                  const size_t align);
+
+void cfilt_free(cfilt_allocator* allocator, void* ptr);
+
+gsl_matrix* cfilt_matrix_alloc(cfilt_allocator* allocator, const size_t n,
+                               const size_t m);
+
+void cfilt_matrix_free(gsl_matrix* mat);
+
+gsl_vector* cfilt_vector_alloc(cfilt_allocator* allocator, const size_t n);
+
+void cfilt_vector_free(gsl_vector* vec);
+
+gsl_permutation* cfilt_permutation_alloc(cfilt_allocator* allocator,
+                                         const size_t n);
+
+void cfilt_permutation_free(gsl_permutation* perm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_ALLOCATOR_H_
@@ -22,9 +22,7 @@
 
 #include <gsl/gsl_blas.h>
 #include <gsl/gsl_errno.h>
-#include <gsl/gsl_linalg.h>
 #include <gsl/gsl_matrix.h>
-#include <gsl/gsl_permutation.h>
 
 #include <math.h>
 #include <string.h>
@@ -42,92 +40,154 @@ cfilt_discrete_white_noise(gsl_vector* tau, const double sigma, gsl_matrix* Q)
     return GSL_SUCCESS;
 }
 
-static void
-cfilt_mahalanobis_free(gsl_matrix* x_copy, gsl_matrix* mu_copy,
-                       gsl_matrix* xmuq, gsl_matrix* cov_inv,
-                       gsl_matrix* mahalanobis, gsl_permutation* perm)
+int
+cfilt_mahalanobis_workspace_alloc(cfilt_mahalanobis_workspace* w,
+                                  const size_t n)
 {
-    M_FREE_IF_NOT_NULL(x_copy);
-    M_FREE_IF_NOT_NULL(mu_copy);
-    M_FREE_IF_NOT_NULL(cov_inv);
-    M_FREE_IF_NOT_NULL(xmuq);
-    M_FREE_IF_NOT_NULL(mahalanobis);
-
-    if (perm)
+    if (n == 0)
     {
-        gsl_permutation_free(perm);
+        GSL_ERROR("cannot initialize a workspace of dimension 0", GSL_EINVAL);
     }
+
+    memset(w, 0, sizeof(cfilt_mahalanobis_workspace));
+
+    M_ALLOC_ASSERT(w->L, n, n, cfilt_mahalanobis_workspace_free, w);
+    V_ALLOC_ASSERT(w->d, n, cfilt_mahalanobis_workspace_free, w);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_mahalanobis_workspace_free(cfilt_mahalanobis_workspace* w)
+{
+    M_FREE_IF_NOT_NULL(w->L);
+    V_FREE_IF_NOT_NULL(w->d);
 }
 
 int
-cfilt_mahalanobis(gsl_vector* x, gsl_vector* mu, gsl_matrix* cov, double* res)
+cfilt_mahalanobis_factor(const gsl_matrix* cov,
+                         cfilt_mahalanobis_workspace* w)
 {
-    const int N = x->size;
-    gsl_matrix* x_copy = gsl_matrix_alloc(N, 1);
-    gsl_matrix* mu_copy = gsl_matrix_alloc(N, 1);
-    gsl_matrix* xmuq = gsl_matrix_alloc(1, N);
-    gsl_matrix* cov_inv = gsl_matrix_alloc(N, N);
-    gsl_matrix* mahalanobis = gsl_matrix_alloc(1, 1);
-    gsl_permutation* perm = gsl_permutation_alloc(N);
-
-    if (!x_copy || !mu_copy || !cov_inv || !mahalanobis || !perm)
+    EXEC_ASSERT(gsl_matrix_memcpy, w->L, cov);
+    if (cfilt_matrix_cholesky(w->L) != GSL_SUCCESS)
     {
-        cfilt_mahalanobis_free(x_copy, mu_copy, xmuq, cov_inv, mahalanobis,
-                               perm);
+        GSL_ERROR("covariance must be positive definite", GSL_EDOM);
+    }
 
-        return GSL_ENOMEM;
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_mahalanobis_chol(const gsl_vector* x, const gsl_vector* mu,
+                       const gsl_matrix* L, gsl_vector* work, double* res)
+{
+    // (x - mu)^T(LL^T)^-1(x - mu) = |L^-1(x - mu)|^2
+    EXEC_ASSERT(gsl_vector_memcpy, work, x);
+    if (mu)
+    {
+        EXEC_ASSERT(gsl_vector_sub, work, mu);
     }
 
-    // TODO : Make this a util function
-    gsl_vector_view x_copy_view = gsl_matrix_column(x_copy, 0);
-    gsl_vector* x_copy_vector = &x_copy_view.vector;
-    EXEC_ASSERT(gsl_vector_memcpy, x_copy_vector, x);
+    EXEC_ASSERT(gsl_blas_dtrsv, CblasLower, CblasNoTrans, CblasNonUnit, L,
+                work);
+
+    *res = gsl_blas_dnrm2(work);
 
-    gsl_vector_view mu_copy_view = gsl_matrix_column(mu_copy, 0);
-    gsl_vector* mu_copy_vector = &mu_copy_view.vector;
-    EXEC_ASSERT(gsl_vector_memcpy, mu_copy_vector, mu);
+    return GSL_SUCCESS;
+}
 
-    // x - mu
-    EXEC_ASSERT(gsl_matrix_sub, x_copy, mu_copy);
+int
+cfilt_mahalanobis_batch(const gsl_matrix* X, const gsl_vector* mu,
+                        const gsl_matrix* L, gsl_matrix* work, gsl_vector* res,
+                        const double gate, unsigned char* mask)
+{
+    if (work->size1 != X->size1 || work->size2 != X->size2 ||
+        res->size != X->size1)
+    {
+        GSL_ERROR("work must match X and res must hold one value per row",
+                  GSL_EBADLEN);
+    }
 
-    // Q^(-1)
-    EXEC_ASSERT(cfilt_matrix_invert, cov, cov_inv, perm);
+    // Rows of work are (x_i - mu)^T, solved all at once for
+    // (x_i - mu)^TL^-T = (L^-1(x_i - mu))^T
+    EXEC_ASSERT(gsl_matrix_memcpy, work, X);
+    if (mu)
+    {
+        for (size_t i = 0; i < work->size1; ++i)
+        {
+            gsl_vector_view row = gsl_matrix_row(work, i);
+            EXEC_ASSERT(gsl_vector_sub, &row.vector, mu);
+        }
+    }
 
-    // (x - mu)^TQ^(-1)
-    EXEC_ASSERT(gsl_blas_dgemm, CblasTrans, CblasNoTrans, 1.0, x_copy, cov_inv,
-                0.0, xmuq);
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasRight, CblasLower, CblasTrans,
+                CblasNonUnit, 1.0, L, work);
 
-    // (x - mu)Q^-1(x - mu)
-    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, xmuq, x_copy,
-                0.0, mahalanobis);
+    for (size_t i = 0; i < work->size1; ++i)
+    {
+        const double* row = gsl_matrix_const_ptr(work, i, 0);
+
+        double d2 = 0.0;
+        for (size_t j = 0; j < work->size2; ++j)
+        {
+            d2 += row[j] * row[j];
+        }
+
+        gsl_vector_set(res, i, sqrt(d2));
+        if (mask)
+        {
+            mask[i] = d2 <= gate;
+        }
+    }
 
-    *res = sqrt(*(double*)mahalanobis->data);
+    return GSL_SUCCESS;
+}
 
-    cfilt_mahalanobis_free(x_copy, mu_copy, xmuq, cov_inv, mahalanobis, perm);
+int
+cfilt_mahalanobis_ws(const gsl_vector* x, const gsl_vector* mu,
+                     const gsl_matrix* cov, cfilt_mahalanobis_workspace* w,
+                     double* res)
+{
+    EXEC_ASSERT(cfilt_mahalanobis_factor, cov, w);
+    EXEC_ASSERT(cfilt_mahalanobis_chol, x, mu, w->L, w->d, res);
 
     return GSL_SUCCESS;
 }
 
 int
-cfilt_norm_estimated_error_squared(gsl_vector* x_, gsl_matrix* cov, double* res)
+cfilt_norm_estimated_error_squared_ws(const gsl_vector* x_,
+                                      const gsl_matrix* cov,
+                                      cfilt_mahalanobis_workspace* w,
+                                      double* res)
 {
     // Here, x_ = x - x_estimation
-    // We do not compute the difference here because it would require an
-    // intermediary result which requires memory allocation.
-    // Unlike the previous function, this one is simple enough not to do it.
-    gsl_vector* zero = gsl_vector_alloc(x_->size);
-    if (zero == NULL)
-    {
-        return GSL_ENOMEM;
-    }
+    EXEC_ASSERT(cfilt_mahalanobis_ws, x_, NULL, cov, w, res);
 
-    gsl_vector_set_zero(zero);
+    *res *= *res;
 
-    EXEC_ASSERT(cfilt_mahalanobis, x_, zero, cov, res);
+    return GSL_SUCCESS;
+}
 
-    *res *= *res;
+int
+cfilt_mahalanobis(gsl_vector* x, gsl_vector* mu, gsl_matrix* cov, double* res)
+{
+    cfilt_mahalanobis_workspace w;
+    EXEC_ASSERT(cfilt_mahalanobis_workspace_alloc, &w, x->size);
 
-    gsl_vector_free(zero);
+    const int status = cfilt_mahalanobis_ws(x, mu, cov, &w, res);
+    cfilt_mahalanobis_workspace_free(&w);
 
-    return GSL_SUCCESS;
+    return status;
+}
+
+int
+cfilt_norm_estimated_error_squared(gsl_vector* x_, gsl_matrix* cov, double* res)
+{
+    cfilt_mahalanobis_workspace w;
+    EXEC_ASSERT(cfilt_mahalanobis_workspace_alloc, &w, x_->size);
+
+    const int status = cfilt_norm_estimated_error_squared_ws(x_, cov, &w, res);
+    cfilt_mahalanobis_workspace_free(&w);
+
+    return status;
 }
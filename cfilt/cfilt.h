@@ -23,6 +23,8 @@
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_vector.h>
 
+#include <sys/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,12 +38,68 @@ typedef struct
 int cfilt_discrete_white_noise(gsl_vector* tau, const double sigma,
                                gsl_matrix* Q);
 
+/**
+ * Allocating versions, kept for convenience. Calls in a loop should reuse a
+ * workspace with the *_ws functions below.
+ */
 int cfilt_mahalanobis(gsl_vector* x, gsl_vector* mu, gsl_matrix* cov,
                       double* res);
 
 int cfilt_norm_estimated_error_squared(gsl_vector* x_, gsl_matrix* cov,
                                        double* res);
 
+/**
+ * Scratch space for distances in dimension n. L holds the lower cholesky
+ * factor of the last covariance given to cfilt_mahalanobis_factor or
+ * cfilt_mahalanobis_ws, so further points against the same covariance only
+ * need cfilt_mahalanobis_chol(x, mu, w->L, w->d, res).
+ *
+ * The covariance must be positive definite, GSL_EDOM is reported otherwise.
+ * mu may be NULL for a zero mean.
+ *
+ * factor : Theta(n^3)
+ * chol   : Theta(n^2)
+ * batch  : Theta(pn^2)
+ * ws     : Theta(n^3)
+ */
+typedef struct
+{
+    gsl_matrix* L;
+    gsl_vector* d;
+} cfilt_mahalanobis_workspace;
+
+int cfilt_mahalanobis_workspace_alloc(cfilt_mahalanobis_workspace* w,
+                                      const size_t n);
+
+void cfilt_mahalanobis_workspace_free(cfilt_mahalanobis_workspace* w);
+
+int cfilt_mahalanobis_factor(const gsl_matrix* cov,
+                             cfilt_mahalanobis_workspace* w);
+
+// L is a lower cholesky factor of the covariance, its upper triangle is not
+// referenced. work is a vector of the same dimension.
+int cfilt_mahalanobis_chol(const gsl_vector* x, const gsl_vector* mu,
+                           const gsl_matrix* L, gsl_vector* work, double* res);
+
+// Distances of every row of X (p x n) to mu for the same factored
+// covariance, through one triangular solve for all of them. work is p x n
+// and res holds p values. When mask is not NULL, mask[i] tells whether the
+// squared distance of row i passes the gate (a chi-square quantile for n
+// degrees of freedom).
+int cfilt_mahalanobis_batch(const gsl_matrix* X, const gsl_vector* mu,
+                            const gsl_matrix* L, gsl_matrix* work,
+                            gsl_vector* res, const double gate,
+                            unsigned char* mask);
+
+int cfilt_mahalanobis_ws(const gsl_vector* x, const gsl_vector* mu,
+                         const gsl_matrix* cov, cfilt_mahalanobis_workspace* w,
+                         double* res);
+
+int cfilt_norm_estimated_error_squared_ws(const gsl_vector* x_,
+                                          const gsl_matrix* cov,
+                                          cfilt_mahalanobis_workspace* w,
+                                          double* res);
+
 #ifdef __cplusplus
 }
 #endif
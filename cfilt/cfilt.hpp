@@ -0,0 +1,623 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_HPP_
+#define CFILT_HPP_
+
+/**
+ * Header only C++ counterparts of kalman.h, gh.h and ukf.h whose dimensions
+ * are template parameters. Every matrix is a row major std::array held by
+ * value, nothing is allocated on the heap and every loop has a compile time
+ * trip count. The fields keep the names and meaning of the C structures.
+ *
+ * Functions that can fail return the same GSL status codes as the C API.
+ * Requires C++11.
+ */
+
+#include <gsl/gsl_errno.h>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace cfilt
+{
+template <std::size_t rows, std::size_t cols, typename Scalar = double>
+using Matrix = std::array<Scalar, rows * cols>;
+
+template <std::size_t n, typename Scalar = double>
+using Vector = std::array<Scalar, n>;
+
+namespace detail
+{
+// Lower cholesky factor of the symmetric matrix A, only its lower triangle
+// is read. Returns GSL_EDOM when A is not positive definite.
+template <std::size_t n, typename Scalar>
+inline int
+cholesky(const Matrix<n, n, Scalar>& A, Matrix<n, n, Scalar>& L)
+{
+    L.fill(Scalar(0));
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        for (std::size_t j = 0; j <= i; ++j)
+        {
+            Scalar acc = A[i * n + j];
+            for (std::size_t l = 0; l < j; ++l)
+            {
+                acc -= L[i * n + l] * L[j * n + l];
+            }
+
+            if (i != j)
+            {
+                L[i * n + j] = acc / L[j * n + j];
+            }
+            else if (acc > Scalar(0))
+            {
+                L[i * n + i] = std::sqrt(acc);
+            }
+            else
+            {
+                return GSL_EDOM;
+            }
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+// Solves X(LL^T) = B for X in place, B being rows x n
+template <std::size_t rows, std::size_t n, typename Scalar>
+inline void
+cholesky_solve_right(const Matrix<n, n, Scalar>& L, Matrix<rows, n, Scalar>& B)
+{
+    for (std::size_t i = 0; i < rows; ++i)
+    {
+        Scalar* b = &B[i * n];
+        for (std::size_t a = 0; a < n; ++a)
+        {
+            for (std::size_t c = 0; c < a; ++c)
+            {
+                b[a] -= L[a * n + c] * b[c];
+            }
+
+            b[a] /= L[a * n + a];
+        }
+
+        for (std::size_t a = n; a-- > 0;)
+        {
+            for (std::size_t c = a + 1; c < n; ++c)
+            {
+                b[a] -= L[c * n + a] * b[c];
+            }
+
+            b[a] /= L[a * n + a];
+        }
+    }
+}
+} // namespace detail
+
+/**
+ * See kalman.h. n, m and k are the number of state variables, control inputs
+ * and measurement variables. Only the joint update with a full covariance is
+ * provided and update returns GSL_EDOM, leaving the filter untouched, when
+ * HP_H^T + R is not positive definite.
+ */
+template <std::size_t n, std::size_t m, std::size_t k, typename Scalar = double>
+struct KalmanFilter
+{
+    static_assert(n > 1 && m > 0 && k > 0,
+                  "n m and k must be non zero positive integers and n must be "
+                  "greater than 1");
+
+    Vector<n, Scalar> x{};
+    Vector<n, Scalar> x_{};
+    Vector<k, Scalar> z{};
+    Vector<m, Scalar> u{};
+    Vector<k, Scalar> y{};
+
+    Matrix<n, n, Scalar> F{};
+    Matrix<n, m, Scalar> B{};
+    Matrix<n, n, Scalar> Q{};
+    Matrix<n, n, Scalar> P{};
+    Matrix<n, n, Scalar> P_{};
+    Matrix<k, n, Scalar> H{};
+    Matrix<k, k, Scalar> R{};
+    Matrix<n, k, Scalar> K{};
+
+    void
+    predict()
+    {
+        // x_ = Fx + Bu
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            Scalar acc = Scalar(0);
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                acc += F[i * n + j] * x[j];
+            }
+
+            for (std::size_t j = 0; j < m; ++j)
+            {
+                acc += B[i * m + j] * u[j];
+            }
+
+            x_[i] = acc;
+        }
+
+        // P_ = FPF^T + Q
+        Matrix<n, n, Scalar> FP;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                Scalar acc = Scalar(0);
+                for (std::size_t l = 0; l < n; ++l)
+                {
+                    acc += F[i * n + l] * P[l * n + j];
+                }
+
+                FP[i * n + j] = acc;
+            }
+        }
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t j = 0; j <= i; ++j)
+            {
+                Scalar acc = Scalar(0);
+                for (std::size_t l = 0; l < n; ++l)
+                {
+                    acc += FP[i * n + l] * F[j * n + l];
+                }
+
+                P_[i * n + j] = acc + Q[i * n + j];
+                P_[j * n + i] = acc + Q[j * n + i];
+            }
+        }
+    }
+
+    int
+    update()
+    {
+        // S = HP_H^T + R
+        Matrix<n, k, Scalar> PH_T;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t a = 0; a < k; ++a)
+            {
+                Scalar acc = Scalar(0);
+                for (std::size_t j = 0; j < n; ++j)
+                {
+                    acc += P_[i * n + j] * H[a * n + j];
+                }
+
+                PH_T[i * k + a] = acc;
+            }
+        }
+
+        Matrix<k, k, Scalar> S;
+        for (std::size_t a = 0; a < k; ++a)
+        {
+            for (std::size_t c = 0; c <= a; ++c)
+            {
+                Scalar acc = R[a * k + c];
+                for (std::size_t j = 0; j < n; ++j)
+                {
+                    acc += H[a * n + j] * PH_T[j * k + c];
+                }
+
+                S[a * k + c] = acc;
+            }
+        }
+
+        // K = P_H^TS^-1 through two triangular solves
+        Matrix<k, k, Scalar> L;
+        const int status = detail::cholesky<k>(S, L);
+        if (status != GSL_SUCCESS)
+        {
+            return status;
+        }
+
+        K = PH_T;
+        detail::cholesky_solve_right<n, k>(L, K);
+
+        // y = z - Hx_
+        for (std::size_t a = 0; a < k; ++a)
+        {
+            Scalar acc = z[a];
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                acc -= H[a * n + j] * x_[j];
+            }
+
+            y[a] = acc;
+        }
+
+        // x = x_ + Ky
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            Scalar acc = x_[i];
+            for (std::size_t a = 0; a < k; ++a)
+            {
+                acc += K[i * k + a] * y[a];
+            }
+
+            x[i] = acc;
+        }
+
+        // P = P_ - K(P_H^T)^T
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t j = 0; j <= i; ++j)
+            {
+                Scalar acc = P_[i * n + j];
+                for (std::size_t a = 0; a < k; ++a)
+                {
+                    acc -= K[i * k + a] * PH_T[j * k + a];
+                }
+
+                P[i * n + j] = acc;
+                P[j * n + i] = acc;
+            }
+        }
+
+        return GSL_SUCCESS;
+    }
+};
+
+/**
+ * See gh.h, dim being the filter dimension.
+ */
+template <std::size_t dim, typename Scalar = double>
+struct GHFilter
+{
+    static_assert(dim > 0, "cannot initialize a gh filter of size 0");
+
+    Vector<dim, Scalar> gh{};
+    Vector<dim, Scalar> x{};
+    Vector<dim, Scalar> x_pred{};
+
+    Vector<dim, Scalar> _z{};
+    std::array<char, dim> _upd{};
+
+    void
+    write(const Scalar val, const std::size_t ord)
+    {
+        _z[ord] = val;
+        _upd[ord] = 1;
+    }
+
+    void
+    predict(const Scalar dt)
+    {
+        for (std::size_t i = 0; i < dim - 1; ++i)
+        {
+            x_pred[i] = x[i];
+            unsigned int denum = 1;
+            Scalar dt_ = dt;
+            for (std::size_t j = i + 1; j < dim; ++j)
+            {
+                x_pred[i] += x[j] * dt_ / denum;
+                dt_ *= dt;
+                denum *= (denum + 1);
+            }
+        }
+
+        x_pred[dim - 1] = x[dim - 1];
+    }
+
+    void
+    update(const Scalar dt)
+    {
+        x[0] += _upd[0] ? (gh[0] * (_z[0] - x_pred[0])) : x_pred[0];
+        _upd[0] = 0;
+        for (std::size_t i = dim - 1; i > 0; --i)
+        {
+            x[i] = x_pred[i];
+            Scalar residual = Scalar(0);
+
+            if (_upd[i])
+            {
+                residual = _z[i] - x_pred[i];
+                _upd[i] = 0;
+            }
+            else if (_upd[i - 1])
+            {
+                residual = (_z[i - 1] - x[i - 1]) / dt - x_pred[i];
+            }
+
+            x[i] += gh[i] * residual;
+        }
+    }
+};
+
+/**
+ * See sigma.h. Sigma point generators used by UKF must provide the same
+ * members as this one: a point count, points (count x n), mu_weights,
+ * sigma_weights and generate(mu, cov).
+ */
+template <std::size_t n, typename Scalar = double>
+struct VanDerMerweSigma
+{
+    typedef Scalar scalar_type;
+    static constexpr std::size_t dim = n;
+    static constexpr std::size_t count = 2 * n + 1;
+
+    Matrix<count, n, Scalar> points{};
+    Vector<count, Scalar> mu_weights{};
+    Vector<count, Scalar> sigma_weights{};
+    Scalar lambda;
+
+    VanDerMerweSigma(const Scalar alpha, const Scalar beta, const Scalar kappa)
+      : lambda(alpha * alpha * (n + kappa) - n)
+    {
+        const Scalar weight = Scalar(1) / (Scalar(2) * (n + lambda));
+        mu_weights.fill(weight);
+        sigma_weights.fill(weight);
+
+        mu_weights[0] = lambda / (lambda + n);
+        sigma_weights[0] = mu_weights[0] + 1 - alpha * alpha + beta;
+    }
+
+    int
+    generate(const Vector<n, Scalar>& mu, const Matrix<n, n, Scalar>& cov)
+    {
+        // sqrt((n + lambda) * cov)
+        Matrix<n, n, Scalar> scaled;
+        for (std::size_t i = 0; i < n * n; ++i)
+        {
+            scaled[i] = (n + lambda) * cov[i];
+        }
+
+        Matrix<n, n, Scalar> L;
+        const int status = detail::cholesky<n>(scaled, L);
+        if (status != GSL_SUCCESS)
+        {
+            return status;
+        }
+
+        // mu +/- columns of the lower factor, the outer products of the
+        // columns of L sum to LL^T
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            points[j] = mu[j];
+        }
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                points[(i + 1) * n + j] = mu[j] + L[j * n + i];
+                points[(i + 1 + n) * n + j] = mu[j] - L[j * n + i];
+            }
+        }
+
+        return GSL_SUCCESS;
+    }
+};
+
+/**
+ * See ukf.h, k being the number of measurement variables. The state and
+ * measurement functions are callables given to predict and update:
+ *      f(const Vector<n>& point, Vector<n>& out)
+ *      h(const Vector<n>& point, Vector<k>& out)
+ * Means and residuals are the plain weighted sums and differences. update
+ * redraws the sigma points around the prediction before applying h.
+ */
+template <std::size_t n, std::size_t k, typename SigmaGen>
+struct UKF
+{
+    typedef typename SigmaGen::scalar_type Scalar;
+    static constexpr std::size_t count = SigmaGen::count;
+    static_assert(SigmaGen::dim == n,
+                  "Sigma generator dimensionality does not match filter's "
+                  "dimensions");
+
+    SigmaGen gen;
+
+    Vector<n, Scalar> x_{};
+    Vector<n, Scalar> x{};
+    Vector<k, Scalar> z{};
+    Vector<k, Scalar> u_z{};
+    Vector<k, Scalar> y{};
+
+    Matrix<n, n, Scalar> Q{};
+    Matrix<count, n, Scalar> Y{};
+    Matrix<n, n, Scalar> P_{};
+    Matrix<n, n, Scalar> P{};
+    Matrix<k, k, Scalar> P_z{};
+    Matrix<k, k, Scalar> R{};
+    Matrix<n, k, Scalar> K{};
+    Matrix<count, k, Scalar> Z{};
+
+    explicit UKF(const SigmaGen& gen_) : gen(gen_) {}
+
+    template <typename Fx>
+    int
+    predict(Fx&& f)
+    {
+        // Y = f(X)
+        const int status = gen.generate(x, P);
+        if (status != GSL_SUCCESS)
+        {
+            return status;
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Vector<n, Scalar> point, out;
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                point[j] = gen.points[i * n + j];
+            }
+
+            f(point, out);
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                Y[i * n + j] = out[j];
+            }
+        }
+
+        // x_ = sum_i [mu_weight * Y_i]
+        x_.fill(Scalar(0));
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                x_[j] += gen.mu_weights[i] * Y[i * n + j];
+            }
+        }
+
+        // P_ = sum_i [sigma_weight * (Y_i - x_)(Y_i - x_)^T] + Q
+        P_ = Q;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            for (std::size_t a = 0; a < n; ++a)
+            {
+                const Scalar da = gen.sigma_weights[i] * (Y[i * n + a] - x_[a]);
+                for (std::size_t b = 0; b < n; ++b)
+                {
+                    P_[a * n + b] += da * (Y[i * n + b] - x_[b]);
+                }
+            }
+        }
+
+        return GSL_SUCCESS;
+    }
+
+    template <typename Hx>
+    int
+    update(Hx&& h)
+    {
+        // The sigma points are redrawn from (x_, P_) so that the measurement
+        // covariance accounts for Q, then Z = h(Y)
+        const int status = gen.generate(x_, P_);
+        if (status != GSL_SUCCESS)
+        {
+            return status;
+        }
+
+        Y = gen.points;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Vector<n, Scalar> point;
+            Vector<k, Scalar> out;
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                point[j] = Y[i * n + j];
+            }
+
+            h(point, out);
+            for (std::size_t j = 0; j < k; ++j)
+            {
+                Z[i * k + j] = out[j];
+            }
+        }
+
+        // u_z = sum_i [mu_weight * Z_i], y = z - u_z
+        u_z.fill(Scalar(0));
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            for (std::size_t j = 0; j < k; ++j)
+            {
+                u_z[j] += gen.mu_weights[i] * Z[i * k + j];
+            }
+        }
+
+        for (std::size_t j = 0; j < k; ++j)
+        {
+            y[j] = z[j] - u_z[j];
+        }
+
+        // P_z = sum_i [sigma_weight * (Z_i - u_z)(Z_i - u_z)^T] + R
+        // P_xz = sum_i [sigma_weight * (Y_i - x_)(Z_i - u_z)^T]
+        Matrix<n, k, Scalar> P_xz{};
+        P_z = R;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const Scalar weight = gen.sigma_weights[i];
+            for (std::size_t a = 0; a < k; ++a)
+            {
+                const Scalar da = weight * (Z[i * k + a] - u_z[a]);
+                for (std::size_t b = 0; b < k; ++b)
+                {
+                    P_z[a * k + b] += da * (Z[i * k + b] - u_z[b]);
+                }
+            }
+
+            for (std::size_t a = 0; a < n; ++a)
+            {
+                const Scalar da = weight * (Y[i * n + a] - x_[a]);
+                for (std::size_t b = 0; b < k; ++b)
+                {
+                    P_xz[a * k + b] += da * (Z[i * k + b] - u_z[b]);
+                }
+            }
+        }
+
+        // K = P_xzP_z^-1
+        Matrix<k, k, Scalar> L;
+        if (detail::cholesky<k>(P_z, L) != GSL_SUCCESS)
+        {
+            return GSL_EDOM;
+        }
+
+        K = P_xz;
+        detail::cholesky_solve_right<n, k>(L, K);
+
+        // x = x_ + Ky
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            Scalar acc = x_[i];
+            for (std::size_t a = 0; a < k; ++a)
+            {
+                acc += K[i * k + a] * y[a];
+            }
+
+            x[i] = acc;
+        }
+
+        // P = P_ - KP_zK^T = P_ - K(P_xz)^T
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                Scalar acc = P_[i * n + j];
+                for (std::size_t a = 0; a < k; ++a)
+                {
+                    acc -= K[i * k + a] * P_xz[j * k + a];
+                }
+
+                P[i * n + j] = acc;
+            }
+        }
+
+        return GSL_SUCCESS;
+    }
+};
+
+template <std::size_t n, typename Scalar>
+constexpr std::size_t VanDerMerweSigma<n, Scalar>::dim;
+template <std::size_t n, typename Scalar>
+constexpr std::size_t VanDerMerweSigma<n, Scalar>::count;
+template <std::size_t n, std::size_t k, typename SigmaGen>
+constexpr std::size_t UKF<n, k, SigmaGen>::count;
+} // namespace cfilt
+
+#endif // CFILT_HPP_
@@ -0,0 +1,250 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/cost.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+
+#include <math.h>
+#include <string.h>
+
+// Tracks and detections per tile, a tile of detections stays in L1 while
+// every track of the tile goes over it
+#define TILE_TRACKS 16
+#define TILE_DETECTIONS 256
+
+int
+cfilt_cost_workspace_alloc(cfilt_cost_workspace* w, const size_t n,
+                           const size_t capacity)
+{
+    return cfilt_cost_workspace_alloc_from(w, NULL, n, capacity);
+}
+
+int
+cfilt_cost_workspace_alloc_from(cfilt_cost_workspace* w,
+                                cfilt_allocator* allocator, const size_t n,
+                                const size_t capacity)
+{
+    if (n * capacity == 0)
+    {
+        GSL_ERROR("n and capacity must be non zero positive integers",
+                  GSL_EINVAL);
+    }
+
+    memset(w, 0, sizeof(cfilt_cost_workspace));
+    w->_allocator = allocator ? allocator : cfilt_allocator_get();
+
+    const size_t L_size = CFILT_ALIGN_UP(capacity * n * n * sizeof(double));
+    const size_t mu_size = CFILT_ALIGN_UP(capacity * n * sizeof(double));
+    const size_t status_size = capacity * sizeof(int);
+
+    w->_ptr = cfilt_alloc(w->_allocator, L_size + 2 * mu_size + status_size,
+                          CFILT_ALIGN);
+    if (w->_ptr == NULL)
+    {
+        GSL_ERROR("failed to allocate space for cost workspace", GSL_ENOMEM);
+    }
+
+    w->n = n;
+    w->capacity = capacity;
+    w->L = w->_ptr;
+    w->mu = (double*)((char*)w->_ptr + L_size);
+    w->radius = (double*)((char*)w->_ptr + L_size + mu_size);
+    w->status = (int*)((char*)w->_ptr + L_size + 2 * mu_size);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_cost_workspace_free(cfilt_cost_workspace* w)
+{
+    if (w->_ptr)
+    {
+        cfilt_free(w->_allocator, w->_ptr);
+    }
+
+    memset(w, 0, sizeof(cfilt_cost_workspace));
+}
+
+// Lower cholesky factor of S into the track's slot, only its lower triangle
+// is read afterwards
+static int
+cfilt_cost_factor_track(double* L, const gsl_matrix* S, const size_t n)
+{
+    gsl_matrix_view L_view = gsl_matrix_view_array(L, n, n);
+    EXEC_ASSERT(gsl_matrix_memcpy, &L_view.matrix, S);
+
+    return cfilt_matrix_cholesky(&L_view.matrix);
+}
+
+int
+cfilt_cost_factor(cfilt_cost_workspace* w, const gsl_vector* const* mu,
+                  const gsl_matrix* const* S, const size_t T,
+                  const double gate)
+{
+    if (T > w->capacity)
+    {
+        GSL_ERROR("more tracks than the workspace capacity", GSL_EBADLEN);
+    }
+
+    const size_t n = w->n;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (size_t i = 0; i < T; ++i)
+    {
+        double* L = w->L + i * n * n;
+        w->status[i] = cfilt_cost_factor_track(L, S[i], n);
+        for (size_t k = 0; k < n; ++k)
+        {
+            w->mu[i * n + k] = gsl_vector_get(mu[i], k);
+            w->radius[i * n + k] =
+              w->status[i] == GSL_SUCCESS
+                ? sqrt(gate * gsl_matrix_get(S[i], k, k))
+                : 0.0;
+        }
+    }
+
+    w->count = T;
+
+    return GSL_SUCCESS;
+}
+
+// Squared distance of z to track i, GSL_POSINF as soon as it leaves the box
+// or exceeds the gate
+static inline double
+cfilt_cost_cell(const cfilt_cost_workspace* w, const size_t i,
+                const double* z, const double gate)
+{
+    const size_t n = w->n;
+    const double* mu = w->mu + i * n;
+    const double* radius = w->radius + i * n;
+    if (w->status[i] != GSL_SUCCESS)
+    {
+        return GSL_POSINF;
+    }
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        if (fabs(z[k] - mu[k]) > radius[k])
+        {
+            return GSL_POSINF;
+        }
+    }
+
+    // |L^-1(z - mu)|^2 by forward substitution
+    const double* L = w->L + i * n * n;
+    double y[n];
+    double d2 = 0.0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        double acc = z[k] - mu[k];
+        for (size_t l = 0; l < k; ++l)
+        {
+            acc -= L[k * n + l] * y[l];
+        }
+
+        y[k] = acc / L[k * n + k];
+        d2 += y[k] * y[k];
+    }
+
+    return d2 <= gate ? d2 : GSL_POSINF;
+}
+
+int
+cfilt_cost_fill(const cfilt_cost_workspace* w, const size_t T,
+                const gsl_matrix* Z, const double gate, gsl_matrix* cost)
+{
+    if (T > w->count)
+    {
+        GSL_ERROR("more tracks than were factored", GSL_EINVAL);
+    }
+
+    if (Z->size2 != w->n || cost->size1 < T || cost->size2 < Z->size1)
+    {
+        GSL_ERROR("Z must have n columns and cost must be at least T x D",
+                  GSL_EBADLEN);
+    }
+
+    const size_t D = Z->size1;
+    const size_t track_tiles = (T + TILE_TRACKS - 1) / TILE_TRACKS;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t t = 0; t < track_tiles; ++t)
+    {
+        const size_t i_end = min((t + 1) * TILE_TRACKS, T);
+        for (size_t j0 = 0; j0 < D; j0 += TILE_DETECTIONS)
+        {
+            const size_t j_end = min(j0 + TILE_DETECTIONS, D);
+            for (size_t i = t * TILE_TRACKS; i < i_end; ++i)
+            {
+                double* row = gsl_matrix_ptr(cost, i, 0);
+                for (size_t j = j0; j < j_end; ++j)
+                {
+                    row[j] = cfilt_cost_cell(
+                      w, i, gsl_matrix_const_ptr(Z, j, 0), gate);
+                }
+            }
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_cost_pairs(const cfilt_cost_workspace* w, const gsl_matrix* Z,
+                 const size_t* pairs, const size_t count, const double gate,
+                 double* d2)
+{
+    if (Z->size2 != w->n)
+    {
+        GSL_ERROR("Z must have n columns", GSL_EBADLEN);
+    }
+
+    for (size_t p = 0; p < count; ++p)
+    {
+        const size_t i = pairs[2 * p];
+        const size_t j = pairs[2 * p + 1];
+        if (i >= w->count || j >= Z->size1)
+        {
+            GSL_ERROR("pair out of the factored tracks or detections",
+                      GSL_EINVAL);
+        }
+
+        d2[p] = cfilt_cost_cell(w, i, gsl_matrix_const_ptr(Z, j, 0), gate);
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_cost_matrix(cfilt_cost_workspace* w, const gsl_vector* const* mu,
+                  const gsl_matrix* const* S, const size_t T,
+                  const gsl_matrix* Z, const double gate, gsl_matrix* cost)
+{
+    EXEC_ASSERT(cfilt_cost_factor, w, mu, S, T, gate);
+    EXEC_ASSERT(cfilt_cost_fill, w, T, Z, gate, cost);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_COST_H_
+#define CFILT_COST_H_
+
+#include "cfilt/allocator.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Track to detection cost matrices for data association.
+ *
+ * Each of the T tracks is given by its predicted measurement mu_i and its
+ * innovation covariance S_i (n x n), the D detections are the rows of Z
+ * (D x n). cost(i, j) is the squared mahalanobis distance of detection j to
+ * track i, or GSL_POSINF when it exceeds the gate (a chi-square quantile for
+ * n degrees of freedom).
+ *
+ * Every S_i is factored once. A cell is first checked against the bounding
+ * box of the track's gate ellipse, |z_k - mu_k| <= sqrt(gate * S_kk) for
+ * every k, and the exact distance is only computed inside of it. The matrix
+ * is filled in tiles of tracks and detections, split across threads when
+ * built with OpenMP. With many tracks, a cfilt_grid (see grid.h) over the
+ * boxes narrows the cells down to candidate pairs for cfilt_cost_pairs.
+ *
+ * A track whose S_i is not positive definite is gated out of every cell
+ * (GSL_POSINF, and a zero box radius) rather than failing the others.
+ * status[i] tells which tracks of the last factorization failed (GSL_EDOM)
+ * and which did not (GSL_SUCCESS).
+ *
+ * alloc : Theta(capacity * n^2)
+ * cost  : O(Tn^3 + TDn^2), Theta(TDn) for cells outside the boxes
+ */
+
+typedef struct
+{
+    size_t n;
+    size_t capacity;
+
+    double* L;      // capacity x n x n lower cholesky factors
+    double* mu;     // capacity x n
+    double* radius; // capacity x n, half widths of the gate bounding boxes
+    int* status;    // capacity
+    size_t count;   // Tracks factored by the last cfilt_cost_factor
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_cost_workspace;
+
+int cfilt_cost_workspace_alloc(cfilt_cost_workspace* w, const size_t n,
+                               const size_t capacity);
+
+int cfilt_cost_workspace_alloc_from(cfilt_cost_workspace* w,
+                                    cfilt_allocator* allocator,
+                                    const size_t n, const size_t capacity);
+
+void cfilt_cost_workspace_free(cfilt_cost_workspace* w);
+
+// Factors the T <= capacity tracks into the workspace
+int cfilt_cost_factor(cfilt_cost_workspace* w, const gsl_vector* const* mu,
+                      const gsl_matrix* const* S, const size_t T,
+                      const double gate);
+
+// Fills the first T <= count rows of cost (at least T x D) from the factored
+// tracks
+int cfilt_cost_fill(const cfilt_cost_workspace* w, const size_t T,
+                    const gsl_matrix* Z, const double gate, gsl_matrix* cost);
+
+// Squared distances d2[p] (or GSL_POSINF) of the count (track, detection)
+// pairs given as in cfilt_grid_query, from the factored tracks
+int cfilt_cost_pairs(const cfilt_cost_workspace* w, const gsl_matrix* Z,
+                     const size_t* pairs, const size_t count,
+                     const double gate, double* d2);
+
+// cfilt_cost_factor followed by cfilt_cost_fill
+int cfilt_cost_matrix(cfilt_cost_workspace* w, const gsl_vector* const* mu,
+                      const gsl_matrix* const* S, const size_t T,
+                      const gsl_matrix* Z, const double gate, gsl_matrix* cost);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_COST_H_
@@ -0,0 +1,381 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/discretize.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_linalg.h>
+
+#include <math.h>
+#include <string.h>
+
+// Degree of the Pade approximant
+#define DISCRETIZE_PADE 6
+
+// Terms of the Singer series before they stop mattering for x < 1
+#define DISCRETIZE_SERIES 40
+
+int
+cfilt_discretize_workspace_alloc(cfilt_discretize_workspace* w, const size_t n,
+                                 const size_t p)
+{
+    return cfilt_discretize_workspace_alloc_from(w, NULL, n, p);
+}
+
+int
+cfilt_discretize_workspace_alloc_from(cfilt_discretize_workspace* w,
+                                      cfilt_allocator* allocator,
+                                      const size_t n, const size_t p)
+{
+    if (n * p == 0)
+    {
+        GSL_ERROR("n and p must be non zero positive integers", GSL_EINVAL);
+    }
+
+    memset(w, 0, sizeof(cfilt_discretize_workspace));
+    w->_allocator = allocator ? allocator : cfilt_allocator_get();
+    w->n = n;
+    w->p = p;
+
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->M, 2 * n, 2 * n,
+                        cfilt_discretize_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->E, 2 * n, 2 * n,
+                        cfilt_discretize_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->X, 2 * n, 2 * n,
+                        cfilt_discretize_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->N, 2 * n, 2 * n,
+                        cfilt_discretize_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->D, 2 * n, 2 * n,
+                        cfilt_discretize_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->T, 2 * n, 2 * n,
+                        cfilt_discretize_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->GQc, n, p,
+                        cfilt_discretize_workspace_free, w);
+
+    w->perm = cfilt_permutation_alloc(w->_allocator, 2 * n);
+    if (w->perm == NULL)
+    {
+        cfilt_discretize_workspace_free(w);
+        GSL_ERROR("failed to allocate space for permutation", GSL_ENOMEM);
+    }
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_discretize_workspace_free(cfilt_discretize_workspace* w)
+{
+    M_FREE_IF_NOT_NULL(w->M);
+    M_FREE_IF_NOT_NULL(w->E);
+    M_FREE_IF_NOT_NULL(w->X);
+    M_FREE_IF_NOT_NULL(w->N);
+    M_FREE_IF_NOT_NULL(w->D);
+    M_FREE_IF_NOT_NULL(w->T);
+    M_FREE_IF_NOT_NULL(w->GQc);
+    P_FREE_IF_NOT_NULL(w->perm);
+
+    memset(w, 0, sizeof(cfilt_discretize_workspace));
+}
+
+static double
+cfilt_discretize_norm_inf(const gsl_matrix* A)
+{
+    double norm = 0.0;
+    for (size_t i = 0; i < A->size1; ++i)
+    {
+        double sum = 0.0;
+        for (size_t j = 0; j < A->size2; ++j)
+        {
+            sum += fabs(gsl_matrix_get(A, i, j));
+        }
+
+        norm = sum > norm ? sum : norm;
+    }
+
+    return norm;
+}
+
+// E = exp(M), M being scaled in place (Golub and Van Loan, algorithm 11.3.1)
+static int
+cfilt_discretize_expm(cfilt_discretize_workspace* w)
+{
+    const double norm = cfilt_discretize_norm_inf(w->M);
+    int squarings = 0;
+    if (norm > 0.0)
+    {
+        // ||M|| / 2^squarings <= 1/2
+        squarings = 1 + (int)ceil(log2(norm));
+        squarings = squarings > 0 ? squarings : 0;
+    }
+
+    gsl_matrix_scale(w->M, ldexp(1.0, -squarings));
+
+    // N = sum c_k M^k and D = sum (-1)^k c_k M^k
+    double c = 0.5;
+    gsl_matrix_set_identity(w->N);
+    gsl_matrix_set_identity(w->D);
+    EXEC_ASSERT(gsl_matrix_memcpy, w->X, w->M);
+    for (int k = 1; k <= DISCRETIZE_PADE; ++k)
+    {
+        if (k > 1)
+        {
+            const int q = DISCRETIZE_PADE;
+            c *= (double)(q - k + 1) / (k * (2 * q - k + 1));
+            EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, w->M,
+                        w->X, 0.0, w->T);
+            EXEC_ASSERT(gsl_matrix_memcpy, w->X, w->T);
+        }
+
+        for (size_t i = 0; i < w->X->size1; ++i)
+        {
+            for (size_t j = 0; j < w->X->size2; ++j)
+            {
+                const double x = c * gsl_matrix_get(w->X, i, j);
+                *gsl_matrix_ptr(w->N, i, j) += x;
+                *gsl_matrix_ptr(w->D, i, j) += k % 2 ? -x : x;
+            }
+        }
+    }
+
+    // E = D^-1N
+    int signum;
+    EXEC_ASSERT(gsl_linalg_LU_decomp, w->D, w->perm, &signum);
+    EXEC_ASSERT(gsl_matrix_memcpy, w->E, w->N);
+    for (size_t j = 0; j < w->E->size2; ++j)
+    {
+        gsl_vector_view col = gsl_matrix_column(w->E, j);
+        EXEC_ASSERT(gsl_linalg_LU_svx, w->D, w->perm, &col.vector);
+    }
+
+    for (int s = 0; s < squarings; ++s)
+    {
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, w->E,
+                    w->E, 0.0, w->T);
+        EXEC_ASSERT(gsl_matrix_memcpy, w->E, w->T);
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_discretize_van_loan(const gsl_matrix* A, const gsl_matrix* G,
+                          const gsl_matrix* Qc, const double dt, gsl_matrix* F,
+                          gsl_matrix* Q, cfilt_discretize_workspace* w)
+{
+    const size_t n = w->n;
+    const size_t p = w->p;
+    if (A->size1 != n || A->size2 != n || G->size1 != n || G->size2 != p ||
+        Qc->size1 != p || Qc->size2 != p || F->size1 != n || F->size2 != n ||
+        Q->size1 != n || Q->size2 != n)
+    {
+        GSL_ERROR("model and workspace dimensions differ", GSL_EBADLEN);
+    }
+
+    gsl_matrix_view M11 = gsl_matrix_submatrix(w->M, 0, 0, n, n);
+    gsl_matrix_view M12 = gsl_matrix_submatrix(w->M, 0, n, n, n);
+    gsl_matrix_view M21 = gsl_matrix_submatrix(w->M, n, 0, n, n);
+    gsl_matrix_view M22 = gsl_matrix_submatrix(w->M, n, n, n, n);
+
+    EXEC_ASSERT(gsl_matrix_memcpy, &M11.matrix, A);
+    gsl_matrix_scale(&M11.matrix, -dt);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, G, Qc, 0.0,
+                w->GQc);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, dt, w->GQc, G, 0.0,
+                &M12.matrix);
+    gsl_matrix_set_zero(&M21.matrix);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, &M22.matrix, A);
+    gsl_matrix_scale(&M22.matrix, dt);
+
+    EXEC_ASSERT(cfilt_discretize_expm, w);
+
+    // F = E22^T and Q = FE12
+    gsl_matrix_view E12 = gsl_matrix_submatrix(w->E, 0, n, n, n);
+    gsl_matrix_view E22 = gsl_matrix_submatrix(w->E, n, n, n, n);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, F, &E22.matrix);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, F,
+                &E12.matrix, 0.0, Q);
+
+    return cfilt_matrix_symmetrize(Q, 0);
+}
+
+static double
+cfilt_discretize_factorial(const size_t k)
+{
+    double f = 1.0;
+    for (size_t i = 2; i <= k; ++i)
+    {
+        f *= i;
+    }
+
+    return f;
+}
+
+int
+cfilt_discretize_integrator(const double q, const double dt, gsl_matrix* F,
+                            gsl_matrix* Q)
+{
+    const size_t n = F->size1;
+    if (n == 0 || F->size2 != n || Q->size1 != n || Q->size2 != n)
+    {
+        GSL_ERROR("F and Q must be square matrices of the same size",
+                  GSL_EBADLEN);
+    }
+
+    // F_ij = dt^(j - i) / (j - i)!
+    // Q_ij = q dt^(2n - 1 - i - j) / ((n - 1 - i)!(n - 1 - j)!(2n - 1 - i - j))
+    gsl_matrix_set_zero(F);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = i; j < n; ++j)
+        {
+            gsl_matrix_set(F, i, j,
+                           pow(dt, j - i) / cfilt_discretize_factorial(j - i));
+        }
+
+        for (size_t j = 0; j <= i; ++j)
+        {
+            const size_t e = 2 * n - 1 - i - j;
+            const double q_ij =
+              q * pow(dt, e) /
+              (cfilt_discretize_factorial(n - 1 - i) *
+               cfilt_discretize_factorial(n - 1 - j) * e);
+            gsl_matrix_set(Q, i, j, q_ij);
+            gsl_matrix_set(Q, j, i, q_ij);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+// Singer term B(x) / alpha^lead for x = alpha dt, where
+// B(x) = poly(x) + a e^-2x + b e^-x + c xe^-x vanishes like x^lead
+typedef struct
+{
+    double poly[4];
+    double a;
+    double b;
+    double c;
+    int lead;
+} cfilt_discretize_singer_term;
+
+static double
+cfilt_discretize_singer_eval(const cfilt_discretize_singer_term* t,
+                             const double alpha, const double dt)
+{
+    const double x = alpha * dt;
+    if (x >= 1.0)
+    {
+        const double e = exp(-x);
+        const double B = t->poly[0] +
+                         x * (t->poly[1] + x * (t->poly[2] + x * t->poly[3])) +
+                         t->a * e * e + (t->b + t->c * x) * e;
+
+        return B / pow(alpha, t->lead);
+    }
+
+    // The orders under lead cancel out, dt^lead sum_k c_k x^(k - lead) with
+    // c_k = a(-2)^k / k! + b(-1)^k / k! + c(-1)^(k - 1) / (k - 1)!
+    double e2 = 1.0;
+    double e1 = 1.0;
+    for (int k = 1; k <= t->lead; ++k)
+    {
+        e2 *= -2.0 / k;
+        e1 *= -1.0 / k;
+    }
+
+    double sum = 0.0;
+    double xk = 1.0;
+    for (int k = t->lead; k < t->lead + DISCRETIZE_SERIES; ++k)
+    {
+        sum += (t->a * e2 + (t->b - t->c * k) * e1) * xk;
+        xk *= x;
+        e2 *= -2.0 / (k + 1);
+        e1 *= -1.0 / (k + 1);
+    }
+
+    return pow(dt, t->lead) * sum;
+}
+
+int
+cfilt_discretize_singer(const double alpha, const double q, const double dt,
+                        gsl_matrix* F, gsl_matrix* Q)
+{
+    if (F->size1 != 3 || F->size2 != 3 || Q->size1 != 3 || Q->size2 != 3)
+    {
+        GSL_ERROR("the singer model has 3 states", GSL_EBADLEN);
+    }
+
+    if (!(alpha >= 0.0))
+    {
+        GSL_ERROR("the maneuver rate must be non negative", GSL_EDOM);
+    }
+
+    // Singer (1970), with q / 2 factored out of Q
+    static const cfilt_discretize_singer_term F02 = { { -1, 1, 0, 0 },
+                                                      0, 1, 0, 2 };
+    static const cfilt_discretize_singer_term F12 = { { 1, 0, 0, 0 },
+                                                      0, -1, 0, 1 };
+    static const cfilt_discretize_singer_term Q00 = {
+        { 1, 2, -2, 2.0 / 3.0 }, -1, 0, -4, 5
+    };
+    static const cfilt_discretize_singer_term Q01 = { { 1, -2, 1, 0 },
+                                                      1, -2, 2, 4 };
+    static const cfilt_discretize_singer_term Q02 = { { 1, 0, 0, 0 },
+                                                      -1, 0, -2, 3 };
+    static const cfilt_discretize_singer_term Q11 = { { -3, 2, 0, 0 },
+                                                      -1, 4, 0, 3 };
+    static const cfilt_discretize_singer_term Q12 = { { 1, 0, 0, 0 },
+                                                      1, -2, 0, 2 };
+    static const cfilt_discretize_singer_term Q22 = { { 1, 0, 0, 0 },
+                                                      -1, 0, 0, 1 };
+
+    gsl_matrix_set_identity(F);
+    gsl_matrix_set(F, 0, 1, dt);
+    gsl_matrix_set(F, 0, 2, cfilt_discretize_singer_eval(&F02, alpha, dt));
+    gsl_matrix_set(F, 1, 2, cfilt_discretize_singer_eval(&F12, alpha, dt));
+    gsl_matrix_set(F, 2, 2, exp(-alpha * dt));
+
+    const cfilt_discretize_singer_term* terms[3][3] = {
+        { &Q00, &Q01, &Q02 }, { &Q01, &Q11, &Q12 }, { &Q02, &Q12, &Q22 }
+    };
+    for (size_t i = 0; i < 3; ++i)
+    {
+        for (size_t j = 0; j < 3; ++j)
+        {
+            gsl_matrix_set(Q, i, j,
+                           0.5 * q *
+                             cfilt_discretize_singer_eval(terms[i][j], alpha,
+                                                          dt));
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_discretize_build(const double dt, gsl_matrix* F, gsl_matrix* Q,
+                       void* ctx)
+{
+    const cfilt_discretize_model* model = ctx;
+
+    return cfilt_discretize_van_loan(model->A, model->G, model->Qc, dt, F, Q,
+                                     model->w);
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_DISCRETIZE_H_
+#define CFILT_DISCRETIZE_H_
+
+#include "cfilt/allocator.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_permutation.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Discretization of the continuous model
+ *
+ *   dx/dt = Ax + Gw, E[w(t)w(s)^T] = Qc delta(t - s)
+ *
+ * A (n x n), G (n x p) and Qc (p x p), into F (n x n) and Q (n x n) for a
+ * time step dt.
+ *
+ * cfilt_discretize_van_loan takes the exponential of
+ *
+ *   M = [ -A  GQcG^T ] dt
+ *       [  0     A^T ]
+ *
+ * to get F = E22^T and Q = FE12, with a degree 6 Pade approximant after
+ * scaling M down to a norm of 1/2, and squaring back. The workspace holds
+ * every intermediary for a given (n, p).
+ *
+ * Common models have closed forms and need no workspace:
+ *
+ *   - cfilt_discretize_integrator for a chain of n integrators driven by
+ *     white noise of spectral density q on its last derivative, for instance
+ *     n = 2 for constant velocity and n = 3 for constant acceleration. F and
+ *     Q are those of one axis, several axes go in diagonal blocks.
+ *   - cfilt_discretize_singer for the Singer acceleration model (position,
+ *     velocity, acceleration) da/dt = -alpha a + w, q being the spectral
+ *     density of w (2 alpha sigma^2 for a maneuver variance sigma^2). Small
+ *     alpha dt go through series expansions instead of the exponential
+ *     terms that cancel, and alpha = 0 is constant acceleration.
+ *
+ * cfilt_discretize_build wraps the Van Loan discretization of a
+ * cfilt_discretize_model for cfilt_dt_cache (see dt_cache.h).
+ *
+ * van_loan   : O(n^3 log(||M||))
+ * integrator : Theta(n^2)
+ * singer     : Theta(1)
+ */
+
+typedef struct
+{
+    size_t n;
+    size_t p;
+
+    gsl_matrix* M;
+    gsl_matrix* E;
+    gsl_matrix* X;
+    gsl_matrix* N;
+    gsl_matrix* D;
+    gsl_matrix* T;
+    gsl_matrix* GQc;
+    gsl_permutation* perm;
+
+    cfilt_allocator* _allocator;
+
+} cfilt_discretize_workspace;
+
+int cfilt_discretize_workspace_alloc(cfilt_discretize_workspace* w,
+                                     const size_t n, const size_t p);
+
+int cfilt_discretize_workspace_alloc_from(cfilt_discretize_workspace* w,
+                                          cfilt_allocator* allocator,
+                                          const size_t n, const size_t p);
+
+void cfilt_discretize_workspace_free(cfilt_discretize_workspace* w);
+
+int cfilt_discretize_van_loan(const gsl_matrix* A, const gsl_matrix* G,
+                              const gsl_matrix* Qc, const double dt,
+                              gsl_matrix* F, gsl_matrix* Q,
+                              cfilt_discretize_workspace* w);
+
+int cfilt_discretize_integrator(const double q, const double dt, gsl_matrix* F,
+                                gsl_matrix* Q);
+
+int cfilt_discretize_singer(const double alpha, const double q,
+                            const double dt, gsl_matrix* F, gsl_matrix* Q);
+
+typedef struct
+{
+    const gsl_matrix* A;
+    const gsl_matrix* G;
+    const gsl_matrix* Qc;
+    cfilt_discretize_workspace* w;
+} cfilt_discretize_model;
+
+// ctx is a cfilt_discretize_model
+int cfilt_discretize_build(const double dt, gsl_matrix* F, gsl_matrix* Q,
+                           void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_DISCRETIZE_H_
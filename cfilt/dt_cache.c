@@ -0,0 +1,195 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/dt_cache.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_errno.h>
+
+#include <math.h>
+#include <string.h>
+
+int
+cfilt_dt_cache_alloc(cfilt_dt_cache* cache, const size_t n,
+                     const size_t capacity, const double quantum,
+                     cfilt_dt_cache_build build, void* ctx)
+{
+    return cfilt_dt_cache_alloc_from(cache, NULL, n, capacity, quantum, build,
+                                     ctx);
+}
+
+int
+cfilt_dt_cache_alloc_from(cfilt_dt_cache* cache, cfilt_allocator* allocator,
+                          const size_t n, const size_t capacity,
+                          const double quantum, cfilt_dt_cache_build build,
+                          void* ctx)
+{
+    if (n * capacity == 0)
+    {
+        GSL_ERROR("n and capacity must be non zero positive integers",
+                  GSL_EINVAL);
+    }
+
+    if (build == NULL || !(quantum >= 0.0))
+    {
+        GSL_ERROR("a builder and a non negative quantum are required",
+                  GSL_EINVAL);
+    }
+
+    memset(cache, 0, sizeof(cfilt_dt_cache));
+    cache->_allocator = allocator ? allocator : cfilt_allocator_get();
+    cache->n = n;
+    cache->capacity = capacity;
+    cache->quantum = quantum;
+    cache->build = build;
+    cache->ctx = ctx;
+
+    cache->_entries =
+      cfilt_alloc(cache->_allocator, capacity * sizeof(cfilt_dt_cache_entry),
+                  CFILT_ALIGN);
+    if (cache->_entries == NULL)
+    {
+        GSL_ERROR("failed to allocate space for cache entries", GSL_ENOMEM);
+    }
+
+    cfilt_dt_cache_clear(cache);
+
+    M_ALLOC_ASSERT_FROM(cache->_allocator, cache->F, capacity * n, n,
+                        cfilt_dt_cache_free, cache);
+    M_ALLOC_ASSERT_FROM(cache->_allocator, cache->Q, capacity * n, n,
+                        cfilt_dt_cache_free, cache);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_dt_cache_free(cfilt_dt_cache* cache)
+{
+    if (cache->_entries)
+    {
+        cfilt_free(cache->_allocator, cache->_entries);
+    }
+
+    M_FREE_IF_NOT_NULL(cache->F);
+    M_FREE_IF_NOT_NULL(cache->Q);
+
+    memset(cache, 0, sizeof(cfilt_dt_cache));
+}
+
+void
+cfilt_dt_cache_clear(cfilt_dt_cache* cache)
+{
+    memset(cache->_entries, 0,
+           cache->capacity * sizeof(cfilt_dt_cache_entry));
+    cache->_clock = 0;
+}
+
+// Index of dt's entry, built on a miss
+static int
+cfilt_dt_cache_find(cfilt_dt_cache* cache, double dt, size_t* index)
+{
+    if (!isfinite(dt))
+    {
+        GSL_ERROR("time step must be finite", GSL_EINVAL);
+    }
+
+    int64_t key;
+    if (cache->quantum > 0.0)
+    {
+        key = llround(dt / cache->quantum);
+        dt = key * cache->quantum;
+    }
+    else
+    {
+        // -0.0 and 0.0 share an entry
+        dt += 0.0;
+        memcpy(&key, &dt, sizeof(key));
+    }
+
+    // The least recently used entry goes first, empty ones before all
+    size_t lru = 0;
+    for (size_t i = 0; i < cache->capacity; ++i)
+    {
+        cfilt_dt_cache_entry* entry = cache->_entries + i;
+        if (entry->stamp && entry->key == key)
+        {
+            entry->stamp = ++cache->_clock;
+            ++cache->hits;
+            *index = i;
+
+            return GSL_SUCCESS;
+        }
+
+        if (entry->stamp < cache->_entries[lru].stamp)
+        {
+            lru = i;
+        }
+    }
+
+    const size_t n = cache->n;
+    cfilt_dt_cache_entry* entry = cache->_entries + lru;
+    gsl_matrix_view F = gsl_matrix_submatrix(cache->F, lru * n, 0, n, n);
+    gsl_matrix_view Q = gsl_matrix_submatrix(cache->Q, lru * n, 0, n, n);
+
+    ++cache->misses;
+    entry->stamp = 0;
+    const int status = cache->build(dt, &F.matrix, &Q.matrix, cache->ctx);
+    if (status != GSL_SUCCESS)
+    {
+        return status;
+    }
+
+    entry->key = key;
+    entry->stamp = ++cache->_clock;
+    *index = lru;
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_dt_cache_get(cfilt_dt_cache* cache, const double dt, gsl_matrix* F,
+                   gsl_matrix* Q)
+{
+    size_t i;
+    EXEC_ASSERT(cfilt_dt_cache_find, cache, dt, &i);
+
+    const size_t n = cache->n;
+    if (F)
+    {
+        gsl_matrix_view F_i = gsl_matrix_submatrix(cache->F, i * n, 0, n, n);
+        EXEC_ASSERT(gsl_matrix_memcpy, F, &F_i.matrix);
+    }
+
+    if (Q)
+    {
+        gsl_matrix_view Q_i = gsl_matrix_submatrix(cache->Q, i * n, 0, n, n);
+        EXEC_ASSERT(gsl_matrix_memcpy, Q, &Q_i.matrix);
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_dt_cache_predict(cfilt_dt_cache* cache, cfilt_kalman_filter* filt,
+                       const double dt)
+{
+    EXEC_ASSERT(cfilt_dt_cache_get, cache, dt, filt->F, filt->Q);
+
+    return cfilt_kalman_filter_predict(filt);
+}
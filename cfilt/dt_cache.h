@@ -0,0 +1,109 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_DT_CACHE_H_
+#define CFILT_DT_CACHE_H_
+
+#include "cfilt/allocator.h"
+#include "cfilt/kalman.h"
+
+#include <gsl/gsl_matrix.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Discretized models keyed by time step, for filters whose measurements come
+ * at irregular times.
+ *
+ * build fills F and Q (n x n) for a time step dt, from a continuous model or
+ * anything else, with ctx passed along. It is only called on a miss: the
+ * last capacity time steps seen are kept and the least recently used one is
+ * replaced. With a non zero quantum, dt is rounded to the nearest multiple
+ * of it and build receives the rounded time step, so that jittery time steps
+ * share an entry. Otherwise only identical time steps do. A failed build is
+ * not kept.
+ *
+ * cfilt_dt_cache_get copies the model of dt into F and Q, either may be NULL.
+ * cfilt_dt_cache_predict copies it into the filter's F and Q and predicts.
+ * Nothing is allocated by either.
+ *
+ * get : O(capacity + n^2) on a hit, O(capacity + n^2 + build) on a miss
+ */
+
+typedef int (*cfilt_dt_cache_build)(const double dt, gsl_matrix* F,
+                                    gsl_matrix* Q, void* ctx);
+
+typedef struct
+{
+    int64_t key;
+    size_t stamp; // Last use, 0 when empty
+} cfilt_dt_cache_entry;
+
+typedef struct
+{
+    size_t n;
+    size_t capacity;
+    double quantum;
+    cfilt_dt_cache_build build;
+    void* ctx;
+
+    size_t hits;
+    size_t misses;
+
+    // Model of entry i in rows [i * n, (i + 1) * n) of F and Q
+    gsl_matrix* F;
+    gsl_matrix* Q;
+    cfilt_dt_cache_entry* _entries;
+    size_t _clock;
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_dt_cache;
+
+int cfilt_dt_cache_alloc(cfilt_dt_cache* cache, const size_t n,
+                         const size_t capacity, const double quantum,
+                         cfilt_dt_cache_build build, void* ctx);
+
+int cfilt_dt_cache_alloc_from(cfilt_dt_cache* cache,
+                              cfilt_allocator* allocator, const size_t n,
+                              const size_t capacity, const double quantum,
+                              cfilt_dt_cache_build build, void* ctx);
+
+void cfilt_dt_cache_free(cfilt_dt_cache* cache);
+
+// Forgets every entry, for instance when the model behind build changed
+void cfilt_dt_cache_clear(cfilt_dt_cache* cache);
+
+int cfilt_dt_cache_get(cfilt_dt_cache* cache, const double dt, gsl_matrix* F,
+                       gsl_matrix* Q);
+
+int cfilt_dt_cache_predict(cfilt_dt_cache* cache, cfilt_kalman_filter* filt,
+                           const double dt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_DT_CACHE_H_
@@ -0,0 +1,257 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/fixed_lag.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+#include <string.h>
+
+int
+cfilt_fixed_lag_alloc(cfilt_fixed_lag* fl, const size_t n, const size_t lag,
+                      const size_t stride)
+{
+    return cfilt_fixed_lag_alloc_from(fl, NULL, n, lag, stride);
+}
+
+int
+cfilt_fixed_lag_alloc_from(cfilt_fixed_lag* fl, cfilt_allocator* allocator,
+                           const size_t n, const size_t lag,
+                           const size_t stride)
+{
+    if (n * stride == 0)
+    {
+        GSL_ERROR("n and stride must be non zero positive integers",
+                  GSL_EINVAL);
+    }
+
+    memset(fl, 0, sizeof(cfilt_fixed_lag));
+    fl->_allocator = allocator ? allocator : cfilt_allocator_get();
+    fl->n = n;
+    fl->lag = lag;
+    fl->stride = stride;
+
+    const size_t s = lag + stride;
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->xs, stride, n,
+                        cfilt_fixed_lag_free, fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->Ps, stride * n, n,
+                        cfilt_fixed_lag_free, fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_X, s, n, cfilt_fixed_lag_free,
+                        fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_X_, s, n, cfilt_fixed_lag_free,
+                        fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_P, s * n, n,
+                        cfilt_fixed_lag_free, fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_P_, s * n, n,
+                        cfilt_fixed_lag_free, fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_C, s * n, n,
+                        cfilt_fixed_lag_free, fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_L, n, n, cfilt_fixed_lag_free,
+                        fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_T, n, n, cfilt_fixed_lag_free,
+                        fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_D, n, n, cfilt_fixed_lag_free,
+                        fl);
+    M_ALLOC_ASSERT_FROM(fl->_allocator, fl->_Ps, n, n, cfilt_fixed_lag_free,
+                        fl);
+    V_ALLOC_ASSERT_FROM(fl->_allocator, fl->_xs, n, cfilt_fixed_lag_free, fl);
+    V_ALLOC_ASSERT_FROM(fl->_allocator, fl->_d, n, cfilt_fixed_lag_free, fl);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_fixed_lag_free(cfilt_fixed_lag* fl)
+{
+    M_FREE_IF_NOT_NULL(fl->xs);
+    M_FREE_IF_NOT_NULL(fl->Ps);
+    M_FREE_IF_NOT_NULL(fl->_X);
+    M_FREE_IF_NOT_NULL(fl->_X_);
+    M_FREE_IF_NOT_NULL(fl->_P);
+    M_FREE_IF_NOT_NULL(fl->_P_);
+    M_FREE_IF_NOT_NULL(fl->_C);
+    M_FREE_IF_NOT_NULL(fl->_L);
+    M_FREE_IF_NOT_NULL(fl->_T);
+    M_FREE_IF_NOT_NULL(fl->_D);
+    M_FREE_IF_NOT_NULL(fl->_Ps);
+    V_FREE_IF_NOT_NULL(fl->_xs);
+    V_FREE_IF_NOT_NULL(fl->_d);
+
+    memset(fl, 0, sizeof(cfilt_fixed_lag));
+}
+
+void
+cfilt_fixed_lag_reset(cfilt_fixed_lag* fl)
+{
+    fl->count = 0;
+    fl->ready = 0;
+    fl->first = 0;
+}
+
+// Block of step t in a ring of n x n matrices
+static gsl_matrix_view
+cfilt_fixed_lag_block(const cfilt_fixed_lag* fl, gsl_matrix* ring,
+                      const size_t t)
+{
+    const size_t n = fl->n;
+    return gsl_matrix_submatrix(ring, (t % (fl->lag + fl->stride)) * n, 0, n,
+                                n);
+}
+
+static gsl_vector_view
+cfilt_fixed_lag_row(const cfilt_fixed_lag* fl, gsl_matrix* ring,
+                    const size_t t)
+{
+    return gsl_matrix_row(ring, t % (fl->lag + fl->stride));
+}
+
+// Smoother gain of step t - 1 from the filter at step t
+static int
+cfilt_fixed_lag_gain(cfilt_fixed_lag* fl, const cfilt_kalman_filter* filt,
+                     const size_t t)
+{
+    gsl_matrix_view P = cfilt_fixed_lag_block(fl, fl->_P, t - 1);
+    gsl_matrix_view C = cfilt_fixed_lag_block(fl, fl->_C, t - 1);
+
+    // C^T solves P_t_ C^T = FP_t-1
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->F,
+                &P.matrix, 0.0, fl->_T);
+    EXEC_ASSERT(gsl_matrix_memcpy, fl->_L, filt->P_);
+    if (cfilt_matrix_cholesky(fl->_L) != GSL_SUCCESS)
+    {
+        GSL_ERROR("predicted covariance is not positive definite", GSL_EDOM);
+    }
+
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasLeft, CblasLower, CblasNoTrans,
+                CblasNonUnit, 1.0, fl->_L, fl->_T);
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasLeft, CblasLower, CblasTrans,
+                CblasNonUnit, 1.0, fl->_L, fl->_T);
+
+    return gsl_matrix_transpose_memcpy(&C.matrix, fl->_T);
+}
+
+// Backward pass from the newest step t down to the oldest one of the ring
+static int
+cfilt_fixed_lag_smooth(cfilt_fixed_lag* fl, const size_t t)
+{
+    const size_t n = fl->n;
+    const size_t first = t + 1 - (fl->lag + fl->stride);
+
+    gsl_vector_view x = cfilt_fixed_lag_row(fl, fl->_X, t);
+    gsl_matrix_view P = cfilt_fixed_lag_block(fl, fl->_P, t);
+    EXEC_ASSERT(gsl_vector_memcpy, fl->_xs, &x.vector);
+    EXEC_ASSERT(gsl_matrix_memcpy, fl->_Ps, &P.matrix);
+
+    for (size_t s = t; s-- > first;)
+    {
+        gsl_vector_view x_next = cfilt_fixed_lag_row(fl, fl->_X_, s + 1);
+        gsl_matrix_view P_next = cfilt_fixed_lag_block(fl, fl->_P_, s + 1);
+        gsl_matrix_view C = cfilt_fixed_lag_block(fl, fl->_C, s);
+        x = cfilt_fixed_lag_row(fl, fl->_X, s);
+        P = cfilt_fixed_lag_block(fl, fl->_P, s);
+
+        // xs_s = x_s + C_s(xs_s+1 - x_s+1_)
+        EXEC_ASSERT(gsl_vector_memcpy, fl->_d, fl->_xs);
+        EXEC_ASSERT(gsl_vector_sub, fl->_d, &x_next.vector);
+        EXEC_ASSERT(gsl_vector_memcpy, fl->_xs, &x.vector);
+        EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, &C.matrix, fl->_d, 1.0,
+                    fl->_xs);
+
+        // Ps_s = P_s + C_s(Ps_s+1 - P_s+1_)C_s^T
+        EXEC_ASSERT(gsl_matrix_sub, fl->_Ps, &P_next.matrix);
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0,
+                    &C.matrix, fl->_Ps, 0.0, fl->_D);
+        EXEC_ASSERT(gsl_matrix_memcpy, fl->_Ps, &P.matrix);
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, fl->_D,
+                    &C.matrix, 1.0, fl->_Ps);
+        EXEC_ASSERT(cfilt_matrix_symmetrize, fl->_Ps, 0);
+
+        if (s < first + fl->stride)
+        {
+            gsl_vector_view xs = gsl_matrix_row(fl->xs, s - first);
+            gsl_matrix_view Ps =
+              gsl_matrix_submatrix(fl->Ps, (s - first) * n, 0, n, n);
+            EXEC_ASSERT(gsl_vector_memcpy, &xs.vector, fl->_xs);
+            EXEC_ASSERT(gsl_matrix_memcpy, &Ps.matrix, fl->_Ps);
+        }
+    }
+
+    // With no lag, the newest step is the last of the batch
+    if (fl->lag == 0)
+    {
+        gsl_vector_view xs = gsl_matrix_row(fl->xs, fl->stride - 1);
+        gsl_matrix_view Ps =
+          gsl_matrix_submatrix(fl->Ps, (fl->stride - 1) * n, 0, n, n);
+        x = cfilt_fixed_lag_row(fl, fl->_X, t);
+        P = cfilt_fixed_lag_block(fl, fl->_P, t);
+        EXEC_ASSERT(gsl_vector_memcpy, &xs.vector, &x.vector);
+        EXEC_ASSERT(gsl_matrix_memcpy, &Ps.matrix, &P.matrix);
+    }
+
+    fl->first = first;
+    fl->ready = fl->stride;
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_fixed_lag_push(cfilt_fixed_lag* fl, const cfilt_kalman_filter* filt)
+{
+    if (filt->x->size != fl->n)
+    {
+        GSL_ERROR("filter and smoother dimensions differ", GSL_EBADLEN);
+    }
+
+    const size_t t = fl->count;
+    fl->ready = 0;
+
+    if (t > 0)
+    {
+        EXEC_ASSERT(cfilt_fixed_lag_gain, fl, filt, t);
+    }
+
+    const gsl_vector* x;
+    const gsl_matrix* P;
+    cfilt_kalman_filter_posterior(filt, &x, &P);
+
+    gsl_vector_view x_t = cfilt_fixed_lag_row(fl, fl->_X, t);
+    gsl_vector_view x_t_ = cfilt_fixed_lag_row(fl, fl->_X_, t);
+    gsl_matrix_view P_t = cfilt_fixed_lag_block(fl, fl->_P, t);
+    gsl_matrix_view P_t_ = cfilt_fixed_lag_block(fl, fl->_P_, t);
+    EXEC_ASSERT(gsl_vector_memcpy, &x_t.vector, x);
+    EXEC_ASSERT(gsl_vector_memcpy, &x_t_.vector, filt->x_);
+
+    // The lower triangle holds the covariance in either mode
+    EXEC_ASSERT(gsl_matrix_memcpy, &P_t.matrix, P);
+    EXEC_ASSERT(gsl_matrix_memcpy, &P_t_.matrix, filt->P_);
+    EXEC_ASSERT(cfilt_matrix_symmetrize, &P_t.matrix, 0);
+    EXEC_ASSERT(cfilt_matrix_symmetrize, &P_t_.matrix, 0);
+
+    ++fl->count;
+
+    const size_t s = fl->lag + fl->stride;
+    if (fl->count >= s && (fl->count - s) % fl->stride == 0)
+    {
+        EXEC_ASSERT(cfilt_fixed_lag_smooth, fl, t);
+    }
+
+    return GSL_SUCCESS;
+}
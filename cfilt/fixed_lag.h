@@ -0,0 +1,110 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_FIXED_LAG_H_
+#define CFILT_FIXED_LAG_H_
+
+#include "cfilt/allocator.h"
+#include "cfilt/kalman.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fixed lag smoother over a cfilt_kalman_filter run: the estimate of step
+ * t - lag given every measurement up to step t.
+ *
+ * cfilt_fixed_lag_push is called after each predict (and update, when there
+ * is a measurement). It keeps the last lag + stride steps in a ring of x, P,
+ * x_ and P_. The smoother gain of a step,
+ *
+ *   C_s = P_sF_s+1^T(P_s+1_)^-1
+ *
+ * only depends on the filter, so it is computed once with a cholesky solve
+ * when step s + 1 is pushed and kept in the ring in place of F. Every stride
+ * steps, a backward pass over the ring (see rts.h) leaves the smoothed
+ * estimates of the stride oldest steps in rows of xs and blocks of Ps, ready
+ * is set to stride and first to the step of the first one. ready is 0
+ * otherwise.
+ *
+ * With stride = 1 the estimate of step t - lag comes out of every push. A
+ * larger stride amortizes the backward pass over stride steps, the estimates
+ * then come out in batches and are smoothed over lag to lag + stride - 1
+ * steps. Nothing is allocated by push.
+ *
+ * push : O(n^3) and O((lag + stride) n^3) every stride pushes
+ */
+
+typedef struct
+{
+    size_t n;
+    size_t lag;
+    size_t stride;
+    size_t count; // Steps pushed
+
+    size_t ready;
+    size_t first;
+    gsl_matrix* xs; // stride x n
+    gsl_matrix* Ps; // stride * n x n
+
+    // Ring of lag + stride steps, step s in row (block) s % (lag + stride)
+    gsl_matrix* _X;
+    gsl_matrix* _X_;
+    gsl_matrix* _P;
+    gsl_matrix* _P_;
+    gsl_matrix* _C;
+
+    // Gain and backward pass scratch space
+    gsl_matrix* _L;
+    gsl_matrix* _T;
+    gsl_matrix* _D;
+    gsl_matrix* _Ps;
+    gsl_vector* _xs;
+    gsl_vector* _d;
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_fixed_lag;
+
+int cfilt_fixed_lag_alloc(cfilt_fixed_lag* fl, const size_t n,
+                          const size_t lag, const size_t stride);
+
+int cfilt_fixed_lag_alloc_from(cfilt_fixed_lag* fl, cfilt_allocator* allocator,
+                               const size_t n, const size_t lag,
+                               const size_t stride);
+
+void cfilt_fixed_lag_free(cfilt_fixed_lag* fl);
+
+// Forgets every step
+void cfilt_fixed_lag_reset(cfilt_fixed_lag* fl);
+
+int cfilt_fixed_lag_push(cfilt_fixed_lag* fl, const cfilt_kalman_filter* filt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_FIXED_LAG_H_
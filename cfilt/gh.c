@@ -18,27 +18,39 @@
  */
 
 #include "cfilt/gh.h"
+#include "cfilt/allocator.h"
 
 #include <gsl/gsl_errno.h>
 
-#include <stdlib.h>
 #include <string.h>
 
 int
 cfilt_gh_alloc(cfilt_gh_filter* filt, const size_t dim)
+{
+    return cfilt_gh_alloc_from(filt, NULL, dim);
+}
+
+int
+cfilt_gh_alloc_from(cfilt_gh_filter* filt, cfilt_allocator* allocator,
+                    const size_t dim)
 {
     if (dim == 0)
     {
         GSL_ERROR("cannot initialize a gh filter of size 0", GSL_EINVAL);
     }
 
+    const size_t size = 4 * dim * sizeof(double) + dim * sizeof(char);
+
     filt->dim = dim;
-    filt->_ptr = calloc(1, 4 * dim * sizeof(double) + dim * sizeof(char));
+    filt->_allocator = allocator ? allocator : cfilt_allocator_get();
+    filt->_ptr = cfilt_alloc(filt->_allocator, size, sizeof(double));
     if (filt->_ptr == NULL)
     {
         GSL_ERROR("failed to allocate space for gh filter", GSL_ENOMEM);
     }
 
+    memset(filt->_ptr, 0, size);
+
     filt->gh = filt->_ptr;
     filt->x = (void*)filt->gh + dim * sizeof(double);
     filt->x_pred = (void*)filt->x + dim * sizeof(double);
@@ -51,7 +63,7 @@ cfilt_gh_alloc(cfilt_gh_filter* filt, const size_t dim)
 void
 cfilt_gh_free(cfilt_gh_filter* filt)
 {
-    free(filt->_ptr);
+    cfilt_free(filt->_allocator, filt->_ptr);
     memset(filt, 0, sizeof(cfilt_gh_filter));
 }
 
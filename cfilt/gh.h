@@ -59,6 +59,8 @@
  * update : Theta(n)
  */
 
+#include "cfilt/allocator.h"
+
 #include <sys/types.h>
 
 #ifdef __cplusplus
@@ -75,11 +77,15 @@ typedef struct
     char* _upd;
     double* _z;
     void* _ptr;
+    cfilt_allocator* _allocator;
 
 } cfilt_gh_filter;
 
 int cfilt_gh_alloc(cfilt_gh_filter* filt, const size_t dim);
 
+int cfilt_gh_alloc_from(cfilt_gh_filter* filt, cfilt_allocator* allocator,
+                        const size_t dim);
+
 void cfilt_gh_free(cfilt_gh_filter* filt);
 
 void cfilt_gh_write(cfilt_gh_filter* filt, const double val, const size_t ord);
@@ -0,0 +1,363 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/grid.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_errno.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+int
+cfilt_grid_alloc(cfilt_grid* g, const size_t dims, const size_t capacity,
+                 const size_t max_cells, const double cell)
+{
+    return cfilt_grid_alloc_from(g, NULL, dims, capacity, max_cells, cell);
+}
+
+int
+cfilt_grid_alloc_from(cfilt_grid* g, cfilt_allocator* allocator,
+                      const size_t dims, const size_t capacity,
+                      const size_t max_cells, const double cell)
+{
+    if (dims * capacity * max_cells == 0 || !(cell > 0.0))
+    {
+        GSL_ERROR("dims, capacity and max_cells must be non zero positive "
+                  "integers and cell must be positive",
+                  GSL_EINVAL);
+    }
+
+    memset(g, 0, sizeof(cfilt_grid));
+    g->_allocator = allocator ? allocator : cfilt_allocator_get();
+
+    // About two buckets per linked node when every track spans a cell
+    size_t buckets = 1;
+    while (buckets < 2 * capacity)
+    {
+        buckets <<= 1;
+    }
+
+    const size_t nodes = capacity * max_cells;
+    const size_t sizes[] = {
+        CFILT_ALIGN_UP(buckets * sizeof(size_t)),
+        CFILT_ALIGN_UP(3 * nodes * sizeof(size_t)),
+        CFILT_ALIGN_UP(4 * capacity * sizeof(size_t)),
+        CFILT_ALIGN_UP(2 * capacity * dims * sizeof(long)),
+        CFILT_ALIGN_UP(2 * capacity * dims * sizeof(double)),
+    };
+
+    size_t size = 0;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        size += sizes[i];
+    }
+
+    g->_ptr = cfilt_alloc(g->_allocator, size, CFILT_ALIGN);
+    if (g->_ptr == NULL)
+    {
+        GSL_ERROR("failed to allocate space for grid", GSL_ENOMEM);
+    }
+
+    g->dims = dims;
+    g->capacity = capacity;
+    g->max_cells = max_cells;
+    g->cell = cell;
+    g->_buckets = buckets;
+
+    char* ptr = g->_ptr;
+    g->_head = (size_t*)ptr, ptr += sizes[0];
+    g->_next = (size_t*)ptr;
+    g->_prev = g->_next + nodes;
+    g->_bucket = g->_prev + nodes;
+    ptr += sizes[1];
+    g->_cells = (size_t*)ptr;
+    g->_stamp = g->_cells + capacity;
+    g->_big_pos = g->_stamp + capacity;
+    g->_big = g->_big_pos + capacity;
+    ptr += sizes[2];
+    g->_lo = (long*)ptr;
+    g->_hi = g->_lo + capacity * dims;
+    ptr += sizes[3];
+    g->_center = (double*)ptr;
+    g->_radius = g->_center + capacity * dims;
+
+    for (size_t b = 0; b < buckets; ++b)
+    {
+        g->_head[b] = CFILT_GRID_NONE;
+    }
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        g->_cells[i] = CFILT_GRID_NONE;
+        g->_big_pos[i] = CFILT_GRID_NONE;
+    }
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_grid_free(cfilt_grid* g)
+{
+    if (g->_ptr)
+    {
+        cfilt_free(g->_allocator, g->_ptr);
+    }
+
+    memset(g, 0, sizeof(cfilt_grid));
+}
+
+static inline long
+cfilt_grid_coordinate(const cfilt_grid* g, const double x)
+{
+    return (long)floor(x / g->cell);
+}
+
+static inline size_t
+cfilt_grid_hash(const cfilt_grid* g, const long* c)
+{
+    uint64_t h = 0;
+    for (size_t d = 0; d < g->dims; ++d)
+    {
+        h = (h ^ (uint64_t)c[d]) * 0x9E3779B97F4A7C15ull;
+    }
+
+    return (size_t)(h ^ (h >> 32)) & (g->_buckets - 1);
+}
+
+static void
+cfilt_grid_unlink(cfilt_grid* g, const size_t i)
+{
+    if (g->_big_pos[i] != CFILT_GRID_NONE)
+    {
+        const size_t last = g->_big[--g->_big_count];
+        g->_big[g->_big_pos[i]] = last;
+        g->_big_pos[last] = g->_big_pos[i];
+        g->_big_pos[i] = CFILT_GRID_NONE;
+    }
+
+    if (g->_cells[i] == CFILT_GRID_NONE)
+    {
+        return;
+    }
+
+    const size_t first = i * g->max_cells;
+    for (size_t node = first; node < first + g->_cells[i]; ++node)
+    {
+        const size_t next = g->_next[node];
+        const size_t prev = g->_prev[node];
+        if (prev == CFILT_GRID_NONE)
+        {
+            g->_head[g->_bucket[node]] = next;
+        }
+        else
+        {
+            g->_next[prev] = next;
+        }
+
+        if (next != CFILT_GRID_NONE)
+        {
+            g->_prev[next] = prev;
+        }
+    }
+
+    g->_cells[i] = CFILT_GRID_NONE;
+}
+
+// Links track i into every cell of its range, or aside when there are too
+// many of them
+static void
+cfilt_grid_link(cfilt_grid* g, const size_t i)
+{
+    const size_t dims = g->dims;
+    const long* lo = g->_lo + i * dims;
+    const long* hi = g->_hi + i * dims;
+
+    size_t cells = 1;
+    for (size_t d = 0; d < dims && cells <= g->max_cells; ++d)
+    {
+        cells *= (size_t)(hi[d] - lo[d] + 1);
+    }
+
+    if (cells > g->max_cells)
+    {
+        g->_big_pos[i] = g->_big_count;
+        g->_big[g->_big_count++] = i;
+        g->_cells[i] = 0;
+        return;
+    }
+
+    // Odometer over the cells of the range
+    long c[dims];
+    memcpy(c, lo, dims * sizeof(long));
+
+    size_t node = i * g->max_cells;
+    for (size_t n = 0; n < cells; ++n, ++node)
+    {
+        const size_t b = cfilt_grid_hash(g, c);
+        g->_bucket[node] = b;
+        g->_prev[node] = CFILT_GRID_NONE;
+        g->_next[node] = g->_head[b];
+        if (g->_head[b] != CFILT_GRID_NONE)
+        {
+            g->_prev[g->_head[b]] = node;
+        }
+
+        g->_head[b] = node;
+
+        for (size_t d = 0; d < dims && ++c[d] > hi[d]; ++d)
+        {
+            c[d] = lo[d];
+        }
+    }
+
+    g->_cells[i] = cells;
+}
+
+int
+cfilt_grid_update(cfilt_grid* g, const size_t i, const double* center,
+                  const double* radius)
+{
+    if (i >= g->capacity)
+    {
+        GSL_ERROR("track index beyond the grid capacity", GSL_EINVAL);
+    }
+
+    const size_t dims = g->dims;
+    long* lo = g->_lo + i * dims;
+    long* hi = g->_hi + i * dims;
+
+    int moved = g->_cells[i] == CFILT_GRID_NONE;
+    for (size_t d = 0; d < dims; ++d)
+    {
+        const long l = cfilt_grid_coordinate(g, center[d] - radius[d]);
+        const long h = cfilt_grid_coordinate(g, center[d] + radius[d]);
+        moved |= l != lo[d] || h != hi[d];
+        lo[d] = l;
+        hi[d] = h;
+    }
+
+    memcpy(g->_center + i * dims, center, dims * sizeof(double));
+    memcpy(g->_radius + i * dims, radius, dims * sizeof(double));
+
+    if (moved)
+    {
+        cfilt_grid_unlink(g, i);
+        cfilt_grid_link(g, i);
+    }
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_grid_remove(cfilt_grid* g, const size_t i)
+{
+    if (i < g->capacity)
+    {
+        cfilt_grid_unlink(g, i);
+    }
+}
+
+static inline int
+cfilt_grid_inside(const cfilt_grid* g, const size_t i, const double* z)
+{
+    const double* center = g->_center + i * g->dims;
+    const double* radius = g->_radius + i * g->dims;
+    for (size_t d = 0; d < g->dims; ++d)
+    {
+        if (fabs(z[d] - center[d]) > radius[d])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int
+cfilt_grid_query(cfilt_grid* g, const gsl_matrix* Z, size_t* pairs,
+                 const size_t max_pairs, size_t* count)
+{
+    if (Z->size2 < g->dims)
+    {
+        GSL_ERROR("Z must have at least dims columns", GSL_EBADLEN);
+    }
+
+    const size_t dims = g->dims;
+    for (size_t i = 0; i < g->capacity; ++i)
+    {
+        g->_stamp[i] = CFILT_GRID_NONE;
+    }
+
+    size_t p = 0;
+    long c[dims];
+    for (size_t j = 0; j < Z->size1; ++j)
+    {
+        const double* z = gsl_matrix_const_ptr(Z, j, 0);
+        for (size_t d = 0; d < dims; ++d)
+        {
+            c[d] = cfilt_grid_coordinate(g, z[d]);
+        }
+
+        // Colliding cells and tracks seen twice are filtered by the box
+        // and the stamp
+        size_t node = g->_head[cfilt_grid_hash(g, c)];
+        for (; node != CFILT_GRID_NONE; node = g->_next[node])
+        {
+            const size_t i = node / g->max_cells;
+            if (g->_stamp[i] == j || !cfilt_grid_inside(g, i, z))
+            {
+                continue;
+            }
+
+            if (p == max_pairs)
+            {
+                GSL_ERROR("more candidate pairs than max_pairs", GSL_EBADLEN);
+            }
+
+            g->_stamp[i] = j;
+            pairs[2 * p] = i;
+            pairs[2 * p + 1] = j;
+            ++p;
+        }
+
+        for (size_t b = 0; b < g->_big_count; ++b)
+        {
+            const size_t i = g->_big[b];
+            if (!cfilt_grid_inside(g, i, z))
+            {
+                continue;
+            }
+
+            if (p == max_pairs)
+            {
+                GSL_ERROR("more candidate pairs than max_pairs", GSL_EBADLEN);
+            }
+
+            pairs[2 * p] = i;
+            pairs[2 * p + 1] = j;
+            ++p;
+        }
+    }
+
+    *count = p;
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_GRID_H_
+#define CFILT_GRID_H_
+
+#include "cfilt/allocator.h"
+
+#include <gsl/gsl_matrix.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Spatial hash of track gates for coarse gating.
+ *
+ * Space (the first dims components of the measurements) is split in cubic
+ * cells of width cell, hashed into a fixed number of buckets. Track i is
+ * given by the center and the half widths of its gate bounding box (mu and
+ * radius of cost.h) and lands in every cell its box overlaps. A detection
+ * then only looks at the tracks of its own cell, and candidate pairs are
+ * those whose detection lies inside of the track's box.
+ *
+ * Updates are incremental. A track whose box still spans the same cells only
+ * has its box replaced, and only tracks changing cells are unlinked and
+ * relinked. A track spanning more than max_cells cells is kept aside and
+ * checked against every detection instead. A cell width close to the typical
+ * gate width keeps tracks to a few cells each.
+ *
+ * Track indices are chosen by the caller (below capacity), for instance the
+ * indices of a cfilt_cost_workspace so that cfilt_cost_pairs computes the
+ * exact distances of the candidates.
+ *
+ * update : O(dims * cells spanned) or O(dims) when no cell changes
+ * query  : O(capacity + D * (dims + bucket length) + oversized tracks * D)
+ */
+
+#define CFILT_GRID_NONE ((size_t)-1)
+
+typedef struct
+{
+    size_t dims;
+    size_t capacity;
+    size_t max_cells;
+    double cell;
+
+    size_t _buckets; // Power of two
+    size_t* _head;   // First node of each bucket
+
+    // Track i owns nodes [i * max_cells, (i + 1) * max_cells)
+    size_t* _next;
+    size_t* _prev;
+    size_t* _bucket;
+
+    // Per track
+    size_t* _cells;   // Linked nodes, CFILT_GRID_NONE when absent
+    long* _lo;        // capacity x dims, cell ranges
+    long* _hi;        // capacity x dims
+    double* _center;  // capacity x dims
+    double* _radius;  // capacity x dims
+    size_t* _stamp;   // Last detection that saw the track
+    size_t* _big_pos; // Position in _big or CFILT_GRID_NONE
+    size_t* _big;     // Tracks over max_cells cells
+    size_t _big_count;
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_grid;
+
+int cfilt_grid_alloc(cfilt_grid* g, const size_t dims, const size_t capacity,
+                     const size_t max_cells, const double cell);
+
+int cfilt_grid_alloc_from(cfilt_grid* g, cfilt_allocator* allocator,
+                          const size_t dims, const size_t capacity,
+                          const size_t max_cells, const double cell);
+
+void cfilt_grid_free(cfilt_grid* g);
+
+// Inserts track i or moves it to its new box
+int cfilt_grid_update(cfilt_grid* g, const size_t i, const double* center,
+                      const double* radius);
+
+void cfilt_grid_remove(cfilt_grid* g, const size_t i);
+
+// Candidate pairs of the detections (rows of Z, at least dims columns), as
+// (track, detection) in pairs[2p] and pairs[2p + 1]. Fails with GSL_EBADLEN
+// when there are more than max_pairs of them.
+int cfilt_grid_query(cfilt_grid* g, const gsl_matrix* Z, size_t* pairs,
+                     const size_t max_pairs, size_t* count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_GRID_H_
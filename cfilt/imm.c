@@ -0,0 +1,354 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/imm.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+#include <math.h>
+#include <string.h>
+
+typedef struct
+{
+    gsl_matrix** p;
+    size_t n;
+    size_t m;
+} cfilt_imm_matrix_layout;
+
+typedef struct
+{
+    gsl_vector** p;
+    size_t n;
+} cfilt_imm_vector_layout;
+
+int
+cfilt_imm_alloc(cfilt_imm* imm, const size_t r, const size_t n,
+                const size_t m, const size_t k)
+{
+    return cfilt_imm_alloc_from(imm, NULL, r, n, m, k);
+}
+
+int
+cfilt_imm_alloc_from(cfilt_imm* imm, cfilt_allocator* allocator,
+                     const size_t r, const size_t n, const size_t m,
+                     const size_t k)
+{
+    if (r == 0)
+    {
+        GSL_ERROR("r must be a non zero positive integer", GSL_EINVAL);
+    }
+
+    memset(imm, 0, sizeof(cfilt_imm));
+    imm->_allocator = allocator ? allocator : cfilt_allocator_get();
+    imm->r = r;
+
+    const cfilt_imm_matrix_layout matrices[] = {
+        { &imm->PI, r, r },       { &imm->P_, n, n },
+        { &imm->P, n, n },        { &imm->X, r, n },
+        { &imm->Ps, r * n, n },   { &imm->_X0, r, n },
+        { &imm->_Ps0, r * n, n }, { &imm->_W, r, r },
+    };
+    const cfilt_imm_vector_layout vectors[] = {
+        { &imm->mu, r }, { &imm->z, k },   { &imm->x_, n }, { &imm->x, n },
+        { &imm->_c, r }, { &imm->_lw, r }, { &imm->_d, n },
+    };
+    const size_t n_matrices = sizeof(matrices) / sizeof(matrices[0]);
+    const size_t n_vectors = sizeof(vectors) / sizeof(vectors[0]);
+
+    size_t size = CFILT_ALIGN_UP(r * sizeof(cfilt_kalman_filter));
+    for (size_t i = 0; i < n_matrices; ++i)
+    {
+        size += CFILT_ALIGN_UP(sizeof(gsl_matrix)) +
+                CFILT_ALIGN_UP(matrices[i].n * matrices[i].m * sizeof(double));
+    }
+
+    for (size_t i = 0; i < n_vectors; ++i)
+    {
+        size += CFILT_ALIGN_UP(sizeof(gsl_vector)) +
+                CFILT_ALIGN_UP(vectors[i].n * sizeof(double));
+    }
+
+    imm->_ptr = cfilt_alloc(imm->_allocator, size, CFILT_ALIGN);
+    if (imm->_ptr == NULL)
+    {
+        GSL_ERROR("failed to allocate space for imm", GSL_ENOMEM);
+    }
+
+    memset(imm->_ptr, 0, size);
+
+    char* ptr = imm->_ptr;
+    imm->models = (cfilt_kalman_filter*)ptr;
+    ptr += CFILT_ALIGN_UP(r * sizeof(cfilt_kalman_filter));
+
+    for (size_t i = 0; i < n_matrices; ++i)
+    {
+        gsl_matrix* mat = (gsl_matrix*)ptr;
+        ptr += CFILT_ALIGN_UP(sizeof(gsl_matrix));
+
+        mat->size1 = matrices[i].n;
+        mat->size2 = matrices[i].m;
+        mat->tda = matrices[i].m;
+        mat->data = (double*)ptr;
+        ptr += CFILT_ALIGN_UP(matrices[i].n * matrices[i].m * sizeof(double));
+
+        *matrices[i].p = mat;
+    }
+
+    for (size_t i = 0; i < n_vectors; ++i)
+    {
+        gsl_vector* vec = (gsl_vector*)ptr;
+        ptr += CFILT_ALIGN_UP(sizeof(gsl_vector));
+
+        vec->size = vectors[i].n;
+        vec->stride = 1;
+        vec->data = (double*)ptr;
+        ptr += CFILT_ALIGN_UP(vectors[i].n * sizeof(double));
+
+        *vectors[i].p = vec;
+    }
+
+    for (size_t i = 0; i < r; ++i)
+    {
+        cfilt_kalman_filter* filt = &imm->models[i];
+        if (cfilt_kalman_filter_alloc_from(filt, imm->_allocator, n, m, k) !=
+            GSL_SUCCESS)
+        {
+            cfilt_imm_free(imm);
+            return GSL_ENOMEM;
+        }
+
+        // The filter's own x and P storage is left unused
+        filt->x->data = gsl_matrix_ptr(imm->X, i, 0);
+        filt->P->data = gsl_matrix_ptr(imm->Ps, i * n, 0);
+    }
+
+    // Models stay put 90% of the time and are equally likely at first
+    for (size_t i = 0; i < r; ++i)
+    {
+        for (size_t j = 0; j < r; ++j)
+        {
+            const double pi = r == 1 ? 1.0 : i == j ? 0.9 : 0.1 / (r - 1);
+            gsl_matrix_set(imm->PI, i, j, pi);
+        }
+    }
+
+    gsl_vector_set_all(imm->mu, 1.0 / r);
+    gsl_vector_set_all(imm->_c, 1.0 / r);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_imm_free(cfilt_imm* imm)
+{
+    if (imm->models)
+    {
+        for (size_t i = 0; i < imm->r; ++i)
+        {
+            cfilt_kalman_filter_free(&imm->models[i]);
+        }
+    }
+
+    if (imm->_ptr)
+    {
+        cfilt_free(imm->_allocator, imm->_ptr);
+    }
+
+    memset(imm, 0, sizeof(cfilt_imm));
+}
+
+static int
+cfilt_imm_check(const cfilt_imm* imm)
+{
+    for (size_t i = 0; i < imm->r; ++i)
+    {
+        if (imm->models[i].cov_mode != CFILT_KALMAN_COVARIANCE_FULL ||
+            imm->models[i].steady_state || imm->models[i].freeze_window > 0)
+        {
+            GSL_ERROR("imm models must propagate full, unfrozen covariances",
+                      GSL_EINVAL);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+// B = B + aA for contiguous matrices of the same size
+static int
+cfilt_imm_matrix_axpy(const double a, const gsl_matrix* A, gsl_matrix* B)
+{
+    gsl_vector_const_view A_vec =
+      gsl_vector_const_view_array(A->data, A->size1 * A->size2);
+    gsl_vector_view B_vec = gsl_vector_view_array(B->data, B->size1 * B->size2);
+
+    return gsl_blas_daxpy(a, &A_vec.vector, &B_vec.vector);
+}
+
+// x = sum w_i x_i, P = sum w_i (P_i + (x_i - x)(x_i - x)^T) over the models'
+// predictions or posteriors
+static int
+cfilt_imm_combine(cfilt_imm* imm, const gsl_vector* w, const int prior,
+                  gsl_vector* x, gsl_matrix* P)
+{
+    const size_t n = x->size;
+
+    gsl_vector_set_zero(x);
+    for (size_t i = 0; i < imm->r; ++i)
+    {
+        gsl_vector_view x_i = gsl_matrix_row(imm->X, i);
+        EXEC_ASSERT(gsl_blas_daxpy, gsl_vector_get(w, i),
+                    prior ? imm->models[i].x_ : &x_i.vector, x);
+    }
+
+    gsl_matrix_set_zero(P);
+    for (size_t i = 0; i < imm->r; ++i)
+    {
+        const double w_i = gsl_vector_get(w, i);
+        if (w_i == 0.0)
+        {
+            continue;
+        }
+
+        gsl_vector_view x_i = gsl_matrix_row(imm->X, i);
+        gsl_matrix_view P_i = gsl_matrix_submatrix(imm->Ps, i * n, 0, n, n);
+
+        EXEC_ASSERT(gsl_vector_memcpy, imm->_d,
+                    prior ? imm->models[i].x_ : &x_i.vector);
+        EXEC_ASSERT(gsl_vector_sub, imm->_d, x);
+        EXEC_ASSERT(cfilt_imm_matrix_axpy, w_i,
+                    prior ? imm->models[i].P_ : &P_i.matrix, P);
+        EXEC_ASSERT(gsl_blas_dger, w_i, imm->_d, imm->_d, P);
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_imm_mix(cfilt_imm* imm)
+{
+    const size_t r = imm->r;
+    const size_t n = imm->x->size;
+
+    // c = PI^Tmu
+    EXEC_ASSERT(gsl_blas_dgemv, CblasTrans, 1.0, imm->PI, imm->mu, 0.0,
+                imm->_c);
+
+    // An unreachable model keeps its own estimate
+    for (size_t i = 0; i < r; ++i)
+    {
+        for (size_t j = 0; j < r; ++j)
+        {
+            const double c_j = gsl_vector_get(imm->_c, j);
+            const double w = c_j > 0.0 ? gsl_matrix_get(imm->PI, i, j) *
+                                           gsl_vector_get(imm->mu, i) / c_j
+                                       : i == j;
+            gsl_matrix_set(imm->_W, i, j, w);
+        }
+    }
+
+    // Row j of X0 is sum_i w_ij x_i
+    EXEC_ASSERT(gsl_blas_dgemm, CblasTrans, CblasNoTrans, 1.0, imm->_W, imm->X,
+                0.0, imm->_X0);
+
+    for (size_t j = 0; j < r; ++j)
+    {
+        gsl_vector_view x0_j = gsl_matrix_row(imm->_X0, j);
+        gsl_matrix_view P0_j = gsl_matrix_submatrix(imm->_Ps0, j * n, 0, n, n);
+
+        gsl_matrix_set_zero(&P0_j.matrix);
+        for (size_t i = 0; i < r; ++i)
+        {
+            const double w = gsl_matrix_get(imm->_W, i, j);
+            if (w == 0.0)
+            {
+                continue;
+            }
+
+            gsl_vector_view x_i = gsl_matrix_row(imm->X, i);
+            gsl_matrix_view P_i = gsl_matrix_submatrix(imm->Ps, i * n, 0, n, n);
+
+            EXEC_ASSERT(gsl_vector_memcpy, imm->_d, &x_i.vector);
+            EXEC_ASSERT(gsl_vector_sub, imm->_d, &x0_j.vector);
+            EXEC_ASSERT(cfilt_imm_matrix_axpy, w, &P_i.matrix, &P0_j.matrix);
+            EXEC_ASSERT(gsl_blas_dger, w, imm->_d, imm->_d, &P0_j.matrix);
+        }
+    }
+
+    // The models read their x and P straight from X and Ps
+    EXEC_ASSERT(gsl_matrix_memcpy, imm->X, imm->_X0);
+    EXEC_ASSERT(gsl_matrix_memcpy, imm->Ps, imm->_Ps0);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_imm_predict(cfilt_imm* imm)
+{
+    EXEC_ASSERT(cfilt_imm_check, imm);
+    EXEC_ASSERT(cfilt_imm_mix, imm);
+
+    for (size_t i = 0; i < imm->r; ++i)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_predict, &imm->models[i]);
+    }
+
+    return cfilt_imm_combine(imm, imm->_c, 1, imm->x_, imm->P_);
+}
+
+int
+cfilt_imm_update(cfilt_imm* imm)
+{
+    EXEC_ASSERT(cfilt_imm_check, imm);
+
+    // log c_iN(z; H_ix_i, S_i) from each model's own factorization of S_i
+    for (size_t i = 0; i < imm->r; ++i)
+    {
+        cfilt_kalman_filter* filt = &imm->models[i];
+
+        filt->innovation_stats = 1;
+        EXEC_ASSERT(gsl_vector_memcpy, filt->z, imm->z);
+        EXEC_ASSERT(cfilt_kalman_filter_update, filt);
+
+        gsl_vector_set(imm->_lw, i,
+                       log(gsl_vector_get(imm->_c, i)) + filt->log_likelihood);
+    }
+
+    const double lw_max = gsl_vector_max(imm->_lw);
+    if (!isfinite(lw_max))
+    {
+        GSL_ERROR("no model explains the measurement", GSL_EDOM);
+    }
+
+    double sum = 0.0;
+    for (size_t i = 0; i < imm->r; ++i)
+    {
+        sum += exp(gsl_vector_get(imm->_lw, i) - lw_max);
+    }
+
+    imm->log_likelihood = lw_max + log(sum);
+    for (size_t i = 0; i < imm->r; ++i)
+    {
+        gsl_vector_set(imm->mu, i,
+                       exp(gsl_vector_get(imm->_lw, i) - imm->log_likelihood));
+    }
+
+    return cfilt_imm_combine(imm, imm->mu, 0, imm->x, imm->P);
+}
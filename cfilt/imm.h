@@ -0,0 +1,121 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_IMM_H_
+#define CFILT_IMM_H_
+
+#include "cfilt/allocator.h"
+#include "cfilt/kalman.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Interacting multiple model filter over r linear Kalman filters sharing the
+ * same dimensions (n, m, k), for instance constant velocity, constant
+ * acceleration and coordinated turn models written in a common state.
+ *
+ * PI (r x r)   : Markov switching matrix, PI_ij = p(model j | model i before)
+ * mu (r x 1)   : Model probabilities
+ * z  (k x 1)   : Measurement, copied into every model on update
+ *
+ * cfilt_imm_predict mixes the model conditioned estimates,
+ *
+ *   c_j      = sum_i PI_ij mu_i
+ *   w_ij     = PI_ij mu_i / c_j
+ *   x0_j     = sum_i w_ij x_i
+ *   P0_j     = sum_i w_ij (P_i + (x_i - x0_j)(x_i - x0_j)^T)
+ *
+ * predicts every model from its mixed estimate and combines the predictions
+ * into x_ and P_ with the weights c. cfilt_imm_update updates every model,
+ * weighs them by their measurement likelihood and combines the posteriors
+ * into x and P the same way. The likelihoods are the log_likelihood of each
+ * model's own update (innovation_stats is turned on, see kalman.h), so
+ * nothing is factored twice. log_likelihood receives log p(z) under the
+ * mixture.
+ *
+ * The models' F, B, Q, H, R and u are set by the caller, like their initial x
+ * and P. Their x and P are rebound at allocation time to rows of X and blocks
+ * of Ps, so that every model conditioned estimate lives in one contiguous
+ * array. Models must keep the full covariance mode, and neither be in steady
+ * state nor freeze their gain (their P is overwritten by the mixing). Nothing
+ * is allocated by predict and update.
+ *
+ * predict : O(r^2 n^2 + r * kalman predict)
+ * update  : O(r * kalman update + r n^2)
+ */
+
+typedef struct
+{
+    size_t r;
+    cfilt_kalman_filter* models;
+
+    gsl_matrix* PI;
+    gsl_vector* mu;
+    gsl_vector* z;
+
+    // Combined estimates
+    gsl_vector* x_;
+    gsl_matrix* P_;
+    gsl_vector* x;
+    gsl_matrix* P;
+    double log_likelihood;
+
+    // Model conditioned estimates, x of model i in row i of X (r x n) and P
+    // in rows [i * n, (i + 1) * n) of Ps (rn x n)
+    gsl_matrix* X;
+    gsl_matrix* Ps;
+
+    // Mixing scratch space
+    gsl_matrix* _X0;
+    gsl_matrix* _Ps0;
+    gsl_matrix* _W;  // Mixing weights w_ij
+    gsl_vector* _c;  // Predicted model probabilities
+    gsl_vector* _lw; // Log weights of the update
+    gsl_vector* _d;
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_imm;
+
+int cfilt_imm_alloc(cfilt_imm* imm, const size_t r, const size_t n,
+                    const size_t m, const size_t k);
+
+int cfilt_imm_alloc_from(cfilt_imm* imm, cfilt_allocator* allocator,
+                         const size_t r, const size_t n, const size_t m,
+                         const size_t k);
+
+void cfilt_imm_free(cfilt_imm* imm);
+
+int cfilt_imm_predict(cfilt_imm* imm);
+
+int cfilt_imm_update(cfilt_imm* imm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_IMM_H_
@@ -23,20 +23,40 @@
 #include <gsl/gsl_blas.h>
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_linalg.h>
+#include <gsl/gsl_math.h>
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_permutation.h>
 #include <gsl/gsl_vector.h>
 
+#include <math.h>
 #include <string.h>
 
-#define V_ALLOC_ASSERT_(p, n)                                                  \
-    V_ALLOC_ASSERT(p, n, cfilt_kalman_filter_free, filt)
-#define M_ALLOC_ASSERT_(p, n, m)                                               \
-    M_ALLOC_ASSERT(p, n, m, cfilt_kalman_filter_free, filt)
+// Every matrix, vector and the permutation live in one block, each header
+// and each data array starting on its own cache line
+typedef struct
+{
+    gsl_matrix** p;
+    size_t n;
+    size_t m;
+} cfilt_kalman_filter_matrix_layout;
+
+typedef struct
+{
+    gsl_vector** p;
+    size_t n;
+} cfilt_kalman_filter_vector_layout;
 
 int
 cfilt_kalman_filter_alloc(cfilt_kalman_filter* filt, const size_t n,
                           const size_t m, const size_t k)
+{
+    return cfilt_kalman_filter_alloc_from(filt, NULL, n, m, k);
+}
+
+int
+cfilt_kalman_filter_alloc_from(cfilt_kalman_filter* filt,
+                               cfilt_allocator* allocator, const size_t n,
+                               const size_t m, const size_t k)
 {
     if (n * m * k == 0 || n == 1)
     {
@@ -46,75 +66,178 @@ cfilt_kalman_filter_alloc(cfilt_kalman_filter* filt, const size_t n,
     }
 
     memset(filt, 0, sizeof(cfilt_kalman_filter));
+    filt->_allocator = allocator ? allocator : cfilt_allocator_get();
+
+    const cfilt_kalman_filter_matrix_layout matrices[] = {
+        { &filt->F, n, n },         { &filt->B, n, m },
+        { &filt->Q, n, n },         { &filt->P, n, n },
+        { &filt->P_, n, n },        { &filt->H, k, n },
+        { &filt->R, k, k },         { &filt->K, n, k },
+        { &filt->_FP, n, n },       { &filt->_HP, k, n },
+        { &filt->_PH_T, n, k },     { &filt->_PH_T_R, k, k },
+        { &filt->_I, n, n },        { &filt->_P_prev, n, n },
+        { &filt->_F_frozen, n, n }, { &filt->_Q_frozen, n, n },
+        { &filt->_H_frozen, k, n }, { &filt->_R_frozen, k, k },
+    };
+    const cfilt_kalman_filter_vector_layout vectors[] = {
+        { &filt->x, n }, { &filt->x_, n }, { &filt->z, k },
+        { &filt->u, m }, { &filt->y, k },
+    };
+    const size_t n_matrices = sizeof(matrices) / sizeof(matrices[0]);
+    const size_t n_vectors = sizeof(vectors) / sizeof(vectors[0]);
 
-    M_ALLOC_ASSERT_(filt->F, n, n);
-    M_ALLOC_ASSERT_(filt->P_, n, n);
-    M_ALLOC_ASSERT_(filt->B, n, m);
-    M_ALLOC_ASSERT_(filt->Q, n, n);
-    M_ALLOC_ASSERT_(filt->P, n, n);
-    M_ALLOC_ASSERT_(filt->H, k, n);
-    M_ALLOC_ASSERT_(filt->R, k, k);
-    M_ALLOC_ASSERT_(filt->K, n, k);
-
-    V_ALLOC_ASSERT_(filt->x, n);
-    V_ALLOC_ASSERT_(filt->x_, n);
-    V_ALLOC_ASSERT_(filt->z, k);
-    V_ALLOC_ASSERT_(filt->u, m);
-    V_ALLOC_ASSERT_(filt->y, k);
-
-    M_ALLOC_ASSERT_(filt->_FP, n, n);
-    M_ALLOC_ASSERT_(filt->_PH_T, n, k);
-    M_ALLOC_ASSERT_(filt->_PH_T_R, k, k);
-    M_ALLOC_ASSERT_(filt->_inv, k, k);
-    M_ALLOC_ASSERT_(filt->_I, n, n);
-
-    filt->_perm = gsl_permutation_alloc(k);
-    if (filt->_perm == NULL)
+    size_t size = CFILT_ALIGN_UP(sizeof(gsl_permutation)) +
+                  CFILT_ALIGN_UP(k * sizeof(size_t));
+    for (size_t i = 0; i < n_matrices; ++i)
     {
-        return GSL_ENOMEM;
+        size += CFILT_ALIGN_UP(sizeof(gsl_matrix)) +
+                CFILT_ALIGN_UP(matrices[i].n * matrices[i].m * sizeof(double));
+    }
+
+    for (size_t i = 0; i < n_vectors; ++i)
+    {
+        size += CFILT_ALIGN_UP(sizeof(gsl_vector)) +
+                CFILT_ALIGN_UP(vectors[i].n * sizeof(double));
+    }
+
+    filt->_ptr = cfilt_alloc(filt->_allocator, size, CFILT_ALIGN);
+    if (filt->_ptr == NULL)
+    {
+        GSL_ERROR("failed to allocate space for kalman filter", GSL_ENOMEM);
+    }
+
+    memset(filt->_ptr, 0, size);
+
+    // The views own nothing, freeing the block releases everything
+    char* ptr = filt->_ptr;
+    for (size_t i = 0; i < n_matrices; ++i)
+    {
+        gsl_matrix* mat = (gsl_matrix*)ptr;
+        ptr += CFILT_ALIGN_UP(sizeof(gsl_matrix));
+
+        mat->size1 = matrices[i].n;
+        mat->size2 = matrices[i].m;
+        mat->tda = matrices[i].m;
+        mat->data = (double*)ptr;
+        ptr += CFILT_ALIGN_UP(matrices[i].n * matrices[i].m * sizeof(double));
+
+        *matrices[i].p = mat;
+    }
+
+    for (size_t i = 0; i < n_vectors; ++i)
+    {
+        gsl_vector* vec = (gsl_vector*)ptr;
+        ptr += CFILT_ALIGN_UP(sizeof(gsl_vector));
+
+        vec->size = vectors[i].n;
+        vec->stride = 1;
+        vec->data = (double*)ptr;
+        ptr += CFILT_ALIGN_UP(vectors[i].n * sizeof(double));
+
+        *vectors[i].p = vec;
     }
 
+    filt->_perm = (gsl_permutation*)ptr;
+    ptr += CFILT_ALIGN_UP(sizeof(gsl_permutation));
+    filt->_perm->size = k;
+    filt->_perm->data = (size_t*)ptr;
+
+    filt->_predict_fixed = cfilt_kalman_fixed_predict_select(n, m);
+    filt->_update_fixed = cfilt_kalman_fixed_update_select(n, k);
+
     return GSL_SUCCESS;
 }
 
 void
 cfilt_kalman_filter_free(cfilt_kalman_filter* filt)
 {
-    M_FREE_IF_NOT_NULL(filt->F);
-    M_FREE_IF_NOT_NULL(filt->B);
-    M_FREE_IF_NOT_NULL(filt->Q);
-    M_FREE_IF_NOT_NULL(filt->P);
-    M_FREE_IF_NOT_NULL(filt->H);
-    M_FREE_IF_NOT_NULL(filt->R);
-    M_FREE_IF_NOT_NULL(filt->K);
+    if (filt->_ptr)
+    {
+        cfilt_free(filt->_allocator, filt->_ptr);
+    }
 
-    V_FREE_IF_NOT_NULL(filt->x);
-    V_FREE_IF_NOT_NULL(filt->x_);
-    V_FREE_IF_NOT_NULL(filt->z);
-    V_FREE_IF_NOT_NULL(filt->u);
-    V_FREE_IF_NOT_NULL(filt->y);
+    memset(filt, 0, sizeof(cfilt_kalman_filter));
+}
 
-    M_FREE_IF_NOT_NULL(filt->_FP);
-    M_FREE_IF_NOT_NULL(filt->_PH_T);
-    M_FREE_IF_NOT_NULL(filt->_PH_T_R);
-    M_FREE_IF_NOT_NULL(filt->_inv);
-    M_FREE_IF_NOT_NULL(filt->_I);
+static int
+cfilt_kalman_filter_predict_covariance_lower(cfilt_kalman_filter* filt)
+{
+    // FP with P's lower triangle only
+    EXEC_ASSERT(gsl_blas_dsymm, CblasRight, CblasLower, 1.0, filt->P,
+                filt->F, 0.0, filt->_FP);
 
-    if (filt->_perm)
+    // P_ = FPF^T + Q, row i only needs F's first i + 1 rows
+    for (size_t i = 0; i < filt->P_->size1; ++i)
     {
-        gsl_permutation_free(filt->_perm);
+        gsl_matrix_view F_rows = gsl_matrix_submatrix(filt->F, 0, 0, i + 1,
+                                                      filt->F->size2);
+        gsl_vector_view FP_row = gsl_matrix_row(filt->_FP, i);
+        gsl_vector_view P_row = gsl_matrix_subrow(filt->P_, i, 0, i + 1);
+        gsl_vector_view Q_row = gsl_matrix_subrow(filt->Q, i, 0, i + 1);
+
+        EXEC_ASSERT(gsl_vector_memcpy, &P_row.vector, &Q_row.vector);
+        EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, &F_rows.matrix,
+                    &FP_row.vector, 1.0, &P_row.vector);
     }
+
+    return GSL_SUCCESS;
+}
+
+static void
+cfilt_kalman_filter_unfreeze(cfilt_kalman_filter* filt)
+{
+    filt->steady_state = 0;
+    filt->_frozen = 0;
+    filt->_converged = 0;
 }
 
 int
 cfilt_kalman_filter_predict(cfilt_kalman_filter* filt)
 {
+    // A skipped update or a new process model invalidates the frozen gain
+    if (!filt->_updated)
+    {
+        filt->_converged = 0;
+    }
+
+    if (filt->_frozen &&
+        (!filt->_updated ||
+         cfilt_matrix_cmp(filt->F, filt->_F_frozen) != GSL_SUCCESS ||
+         cfilt_matrix_cmp(filt->Q, filt->_Q_frozen) != GSL_SUCCESS))
+    {
+        cfilt_kalman_filter_unfreeze(filt);
+    }
+
+    filt->_updated = 0;
+    filt->_predicted = 1;
+
+    // The small dimension kernel computes x_ and P_ together
+    if (!filt->steady_state && filt->_predict_fixed &&
+        filt->cov_mode == CFILT_KALMAN_COVARIANCE_FULL)
+    {
+        filt->_predict_fixed(filt->F->data, filt->B->data, filt->Q->data,
+                             filt->P->data, filt->x->data, filt->u->data,
+                             filt->x_->data, filt->P_->data);
+        return GSL_SUCCESS;
+    }
+
     // x_ = Fx + Bu
     EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->F, filt->x, 0.0,
                 filt->x_);
     EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->B, filt->u, 1.0,
                 filt->x_);
 
+    if (filt->steady_state)
+    {
+        return GSL_SUCCESS;
+    }
+
+    if (filt->cov_mode == CFILT_KALMAN_COVARIANCE_LOWER)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_predict_covariance_lower, filt);
+        return GSL_SUCCESS;
+    }
+
     // P_ = FPF^T + Q
     EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->F,
                 filt->P, 0.0, filt->_FP);
@@ -125,20 +248,312 @@ cfilt_kalman_filter_predict(cfilt_kalman_filter* filt)
     return GSL_SUCCESS;
 }
 
-int
-cfilt_kalman_filter_update(cfilt_kalman_filter* filt)
+static int
+cfilt_kalman_filter_innovation_covariance(cfilt_kalman_filter* filt)
 {
-    // K = P_H^T(HP_H^T + R)^-1
+    // _PH_T_R = HP_H^T + R
     // _PH_T_R is used to avoid changing R
-    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, filt->P_,
-                filt->H, 0.0, filt->_PH_T);
     EXEC_ASSERT(gsl_matrix_memcpy, filt->_PH_T_R, filt->R);
     EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->H,
                 filt->_PH_T, 1.0, filt->_PH_T_R);
-    EXEC_ASSERT(cfilt_matrix_invert, filt->_PH_T_R, filt->_inv, filt->_perm);
-    EXEC_ASSERT(gsl_matrix_memcpy, filt->_PH_T_R, filt->_inv);
-    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->_PH_T,
-                filt->_PH_T_R, 0.0, filt->K);
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_gain_lu(cfilt_kalman_filter* filt)
+{
+    // The cholesky factorization overwrote the innovation covariance
+    EXEC_ASSERT(cfilt_kalman_filter_innovation_covariance, filt);
+
+    int signum;
+    EXEC_ASSERT(gsl_linalg_LU_decomp, filt->_PH_T_R, filt->_perm, &signum);
+    filt->_S_lu = 1;
+
+    // S is symmetric so each row of K solves S K_i^T = (P_H^T)_i^T
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->K, filt->_PH_T);
+    for (size_t i = 0; i < filt->K->size1; ++i)
+    {
+        gsl_vector_view row = gsl_matrix_row(filt->K, i);
+        EXEC_ASSERT(gsl_linalg_LU_svx, filt->_PH_T_R, filt->_perm,
+                    &row.vector);
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_gain(cfilt_kalman_filter* filt)
+{
+    // K = P_H^T(HP_H^T + R)^-1
+    if (filt->cov_mode == CFILT_KALMAN_COVARIANCE_LOWER)
+    {
+        EXEC_ASSERT(gsl_blas_dsymm, CblasRight, CblasLower, 1.0, filt->P_,
+                    filt->H, 0.0, filt->_HP);
+        EXEC_ASSERT(gsl_matrix_transpose_memcpy, filt->_PH_T, filt->_HP);
+    }
+    else
+    {
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, filt->P_,
+                    filt->H, 0.0, filt->_PH_T);
+    }
+
+    EXEC_ASSERT(cfilt_kalman_filter_innovation_covariance, filt);
+
+    if (cfilt_matrix_cholesky(filt->_PH_T_R) != GSL_SUCCESS)
+    {
+        return cfilt_kalman_filter_gain_lu(filt);
+    }
+
+    filt->_S_lu = 0;
+
+    // KLL^T = P_H^T is solved with two triangular solves instead of
+    // inverting the innovation covariance
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->K, filt->_PH_T);
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasRight, CblasLower, CblasTrans,
+                CblasNonUnit, 1.0, filt->_PH_T_R, filt->K);
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasRight, CblasLower, CblasNoTrans,
+                CblasNonUnit, 1.0, filt->_PH_T_R, filt->K);
+
+    return GSL_SUCCESS;
+}
+
+// nis = y^TS^-1y and log|S| from the factors of S left in _PH_T_R by the
+// last gain computation
+static int
+cfilt_kalman_filter_innovation_stats(cfilt_kalman_filter* filt)
+{
+    const size_t k = filt->y->size;
+
+    double w[k];
+    gsl_vector_view w_view = gsl_vector_view_array(w, k);
+    EXEC_ASSERT(gsl_vector_memcpy, &w_view.vector, filt->y);
+
+    if (filt->_S_lu)
+    {
+        EXEC_ASSERT(gsl_linalg_LU_svx, filt->_PH_T_R, filt->_perm,
+                    &w_view.vector);
+        EXEC_ASSERT(gsl_blas_ddot, filt->y, &w_view.vector, &filt->nis);
+        filt->log_det_S = gsl_linalg_LU_lndet(filt->_PH_T_R);
+
+        return GSL_SUCCESS;
+    }
+
+    // |L^-1y|^2 and 2 sum log L_ii
+    EXEC_ASSERT(gsl_blas_dtrsv, CblasLower, CblasNoTrans, CblasNonUnit,
+                filt->_PH_T_R, &w_view.vector);
+    EXEC_ASSERT(gsl_blas_ddot, &w_view.vector, &w_view.vector, &filt->nis);
+
+    filt->log_det_S = 0.0;
+    for (size_t i = 0; i < k; ++i)
+    {
+        filt->log_det_S += 2.0 * log(gsl_matrix_get(filt->_PH_T_R, i, i));
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_r_is_diagonal(const cfilt_kalman_filter* filt)
+{
+    for (size_t i = 0; i < filt->R->size1; ++i)
+    {
+        for (size_t j = 0; j < filt->R->size2; ++j)
+        {
+            if (i != j && gsl_matrix_get(filt->R, i, j) != 0.0)
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Returns GSL_EDOM without calling the error handler when a scalar innovation
+// variance is not positive, x_ and P_ are left untouched for the joint update
+static int
+cfilt_kalman_filter_update_sequential(cfilt_kalman_filter* filt)
+{
+    const int lower = filt->cov_mode == CFILT_KALMAN_COVARIANCE_LOWER;
+
+    // y = z - Hx_
+    EXEC_ASSERT(gsl_vector_memcpy, filt->y, filt->z);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, -1.0, filt->H, filt->x_, 1.0,
+                filt->y);
+
+    EXEC_ASSERT(gsl_vector_memcpy, filt->x, filt->x_);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->P, filt->P_);
+
+    // The joint density factors into the scalar ones, so the nis and the log
+    // determinant are sums over the scalar updates
+    const int stats = filt->innovation_stats;
+    if (stats)
+    {
+        filt->nis = 0.0;
+        filt->log_det_S = 0.0;
+    }
+
+    for (size_t i = 0; i < filt->H->size1; ++i)
+    {
+        // Column i of _PH_T holds Ph_i for the current P
+        gsl_vector_view h = gsl_matrix_row(filt->H, i);
+        gsl_vector_view Ph = gsl_matrix_column(filt->_PH_T, i);
+
+        if (lower)
+        {
+            EXEC_ASSERT(gsl_blas_dsymv, CblasLower, 1.0, filt->P, &h.vector,
+                        0.0, &Ph.vector);
+        }
+        else
+        {
+            EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->P, &h.vector,
+                        0.0, &Ph.vector);
+        }
+
+        // s = h^TPh + r_i
+        double s;
+        EXEC_ASSERT(gsl_blas_ddot, &h.vector, &Ph.vector, &s);
+        s += gsl_matrix_get(filt->R, i, i);
+        if (!(s > 0.0))
+        {
+            return GSL_EDOM;
+        }
+
+        // x = x + Ph(z_i - h^Tx)/s
+        double hx;
+        EXEC_ASSERT(gsl_blas_ddot, &h.vector, filt->x, &hx);
+        const double e = gsl_vector_get(filt->z, i) - hx;
+        EXEC_ASSERT(gsl_blas_daxpy, e / s, &Ph.vector, filt->x);
+
+        if (stats)
+        {
+            filt->nis += e * e / s;
+            filt->log_det_S += log(s);
+        }
+
+        // P = P - PhPh^T/s
+        if (lower)
+        {
+            EXEC_ASSERT(gsl_blas_dsyr, CblasLower, -1.0 / s, &Ph.vector,
+                        filt->P);
+        }
+        else
+        {
+            EXEC_ASSERT(gsl_blas_dger, -1.0 / s, &Ph.vector, &Ph.vector,
+                        filt->P);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_update_steady_state(cfilt_kalman_filter* filt)
+{
+    // y = z - Hx_
+    EXEC_ASSERT(gsl_vector_memcpy, filt->y, filt->z);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, -1.0, filt->H, filt->x_, 1.0,
+                filt->y);
+
+    // x = x_ + Ky
+    EXEC_ASSERT(gsl_vector_memcpy, filt->x, filt->x_);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->K, filt->y, 1.0,
+                filt->x);
+
+    if (filt->innovation_stats)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_innovation_stats, filt);
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_freeze(cfilt_kalman_filter* filt)
+{
+    // The sequential update does not produce K
+    EXEC_ASSERT(cfilt_kalman_filter_gain, filt);
+
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_F_frozen, filt->F);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_Q_frozen, filt->Q);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_H_frozen, filt->H);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_R_frozen, filt->R);
+
+    filt->steady_state = 1;
+    filt->_frozen = 1;
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_track_convergence(cfilt_kalman_filter* filt)
+{
+    // Relative frobenius norm of P - P_prev
+    double num = 0.0;
+    double den = 0.0;
+    for (size_t i = 0; i < filt->P->size1; ++i)
+    {
+        const size_t cols =
+          filt->cov_mode == CFILT_KALMAN_COVARIANCE_LOWER ? i + 1
+                                                          : filt->P->size2;
+        for (size_t j = 0; j < cols; ++j)
+        {
+            const double p = gsl_matrix_get(filt->P, i, j);
+            const double dp = p - gsl_matrix_get(filt->_P_prev, i, j);
+            num += dp * dp;
+            den += p * p;
+        }
+    }
+
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_P_prev, filt->P);
+
+    const double tol = filt->freeze_tol;
+    if (filt->_converged > 0 && num <= tol * tol * den)
+    {
+        if (filt->_converged++ >= filt->freeze_window)
+        {
+            EXEC_ASSERT(cfilt_kalman_filter_freeze, filt);
+        }
+    }
+    else
+    {
+        // The first update only records P
+        filt->_converged = 1;
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_update_full(cfilt_kalman_filter* filt)
+{
+    // The specialized kernel and the sequential update leave x_ and P_
+    // untouched when the innovation covariance is not SPD, the joint update
+    // below then takes over with its LU fallback
+    if (filt->_update_fixed &&
+        filt->update_mode != CFILT_KALMAN_UPDATE_SEQUENTIAL &&
+        filt->cov_mode == CFILT_KALMAN_COVARIANCE_FULL &&
+        filt->_update_fixed(filt->H->data, filt->R->data, filt->P_->data,
+                            filt->x_->data, filt->z->data, filt->K->data,
+                            filt->y->data, filt->x->data, filt->P->data,
+                            filt->innovation_stats ? &filt->nis : NULL,
+                            &filt->log_det_S) == GSL_SUCCESS)
+    {
+        return GSL_SUCCESS;
+    }
+
+    const int sequential =
+      filt->update_mode == CFILT_KALMAN_UPDATE_SEQUENTIAL ||
+      (filt->update_mode == CFILT_KALMAN_UPDATE_AUTO &&
+       cfilt_kalman_filter_r_is_diagonal(filt));
+    if (sequential &&
+        cfilt_kalman_filter_update_sequential(filt) == GSL_SUCCESS)
+    {
+        return GSL_SUCCESS;
+    }
+
+    EXEC_ASSERT(cfilt_kalman_filter_gain, filt);
 
     // y = z - Hx_
     // y is used to avoid changing z
@@ -146,12 +561,36 @@ cfilt_kalman_filter_update(cfilt_kalman_filter* filt)
     EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, -1.0, filt->H, filt->x_, 1.0,
                 filt->y);
 
+    if (filt->innovation_stats)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_innovation_stats, filt);
+    }
+
     // x = x_ + Ky
     // x_ is copied over to x to avoid changing x_
     EXEC_ASSERT(gsl_vector_memcpy, filt->x, filt->x_);
     EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->K, filt->y, 1.0,
                 filt->x);
 
+    if (filt->cov_mode == CFILT_KALMAN_COVARIANCE_LOWER)
+    {
+        // P = P_ - K(HP_), lower triangle only
+        for (size_t i = 0; i < filt->P->size1; ++i)
+        {
+            gsl_matrix_view HP_cols =
+              gsl_matrix_submatrix(filt->_HP, 0, 0, filt->_HP->size1, i + 1);
+            gsl_vector_view K_row = gsl_matrix_row(filt->K, i);
+            gsl_vector_view P_row = gsl_matrix_subrow(filt->P, i, 0, i + 1);
+            gsl_vector_view P__row = gsl_matrix_subrow(filt->P_, i, 0, i + 1);
+
+            EXEC_ASSERT(gsl_vector_memcpy, &P_row.vector, &P__row.vector);
+            EXEC_ASSERT(gsl_blas_dgemv, CblasTrans, -1.0, &HP_cols.matrix,
+                        &K_row.vector, 1.0, &P_row.vector);
+        }
+
+        return GSL_SUCCESS;
+    }
+
     // P = (I - KH)P_
     gsl_matrix_set_identity(filt->_I);
     EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, -1.0, filt->K,
@@ -161,3 +600,494 @@ cfilt_kalman_filter_update(cfilt_kalman_filter* filt)
 
     return GSL_SUCCESS;
 }
+
+// A new measurement model invalidates the frozen gain
+static void
+cfilt_kalman_filter_check_frozen(cfilt_kalman_filter* filt)
+{
+    if (filt->_frozen &&
+        (cfilt_matrix_cmp(filt->H, filt->_H_frozen) != GSL_SUCCESS ||
+         cfilt_matrix_cmp(filt->R, filt->_R_frozen) != GSL_SUCCESS))
+    {
+        cfilt_kalman_filter_unfreeze(filt);
+    }
+}
+
+static void
+cfilt_kalman_filter_log_likelihood(cfilt_kalman_filter* filt)
+{
+    filt->log_likelihood = -0.5 * (filt->nis + filt->log_det_S +
+                                   filt->y->size * log(2.0 * M_PI));
+}
+
+int
+cfilt_kalman_filter_update(cfilt_kalman_filter* filt)
+{
+    cfilt_kalman_filter_check_frozen(filt);
+    filt->_updated = 1;
+    filt->_predicted = 0;
+
+    if (filt->steady_state)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_update_steady_state, filt);
+    }
+    else
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_update_full, filt);
+
+        if (filt->freeze_window > 0)
+        {
+            EXEC_ASSERT(cfilt_kalman_filter_track_convergence, filt);
+        }
+    }
+
+    if (filt->innovation_stats)
+    {
+        cfilt_kalman_filter_log_likelihood(filt);
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_filter_update_combined(cfilt_kalman_filter* filt,
+                                    const gsl_vector* y, const gsl_matrix* C)
+{
+    cfilt_kalman_filter_check_frozen(filt);
+    filt->_updated = 1;
+    filt->_predicted = 0;
+
+    if (y != filt->y)
+    {
+        EXEC_ASSERT(gsl_vector_memcpy, filt->y, y);
+    }
+
+    if (!filt->steady_state)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_gain, filt);
+    }
+
+    // x = x_ + Ky
+    EXEC_ASSERT(gsl_vector_memcpy, filt->x, filt->x_);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->K, filt->y, 1.0,
+                filt->x);
+
+    if (filt->innovation_stats)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_innovation_stats, filt);
+        cfilt_kalman_filter_log_likelihood(filt);
+    }
+
+    if (filt->steady_state)
+    {
+        return GSL_SUCCESS;
+    }
+
+    // P = P_ - KCK^T, _PH_T is free once K is known
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->K, C,
+                0.0, filt->_PH_T);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->P, filt->P_);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, -1.0, filt->_PH_T,
+                filt->K, 1.0, filt->P);
+
+    if (filt->freeze_window > 0)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_track_convergence, filt);
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_filter_posterior(const cfilt_kalman_filter* filt,
+                              const gsl_vector** x, const gsl_matrix** P)
+{
+    *x = filt->_predicted ? filt->x_ : filt->x;
+    *P = filt->_predicted ? filt->P_ : filt->P;
+
+    return filt->_updated;
+}
+
+int
+cfilt_kalman_filter_set_posterior(cfilt_kalman_filter* filt,
+                                  const gsl_vector* x, const gsl_matrix* P)
+{
+    EXEC_ASSERT(gsl_vector_memcpy, filt->x, x);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->P, P);
+    filt->_updated = 1;
+    filt->_predicted = 0;
+
+    return GSL_SUCCESS;
+}
+
+static void
+cfilt_kalman_filter_dare_free(gsl_matrix* A, gsl_matrix* G, gsl_matrix* X,
+                              gsl_matrix* W, gsl_matrix* W_inv,
+                              gsl_matrix* V1, gsl_matrix* V2, gsl_matrix* T,
+                              gsl_permutation* perm)
+{
+    M_FREE_IF_NOT_NULL(A);
+    M_FREE_IF_NOT_NULL(G);
+    M_FREE_IF_NOT_NULL(X);
+    M_FREE_IF_NOT_NULL(W);
+    M_FREE_IF_NOT_NULL(W_inv);
+    M_FREE_IF_NOT_NULL(V1);
+    M_FREE_IF_NOT_NULL(V2);
+    M_FREE_IF_NOT_NULL(T);
+
+    P_FREE_IF_NOT_NULL(perm);
+}
+
+// One structure-preserving doubling step on (A, G, X), returns the relative
+// change of X in the frobenius norm through delta.
+static int
+cfilt_kalman_filter_dare_step(gsl_matrix* A, gsl_matrix* G, gsl_matrix* X,
+                              gsl_matrix* W, gsl_matrix* W_inv,
+                              gsl_matrix* V1, gsl_matrix* V2, gsl_matrix* T,
+                              gsl_permutation* perm, double* delta)
+{
+    // W = I + GX
+    gsl_matrix_set_identity(W);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, G, X, 1.0, W);
+    EXEC_ASSERT(cfilt_matrix_invert, W, W_inv, perm);
+
+    // V1 = W^-1A, V2 = W^-1G
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, W_inv, A, 0.0,
+                V1);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, W_inv, G, 0.0,
+                V2);
+
+    // X = X + A^TXV1
+    EXEC_ASSERT(gsl_blas_dgemm, CblasTrans, CblasNoTrans, 1.0, A, X, 0.0, T);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, T, V1, 0.0, W);
+
+    double num = 0.0;
+    double den = 0.0;
+    for (size_t i = 0; i < X->size1; ++i)
+    {
+        for (size_t j = 0; j < X->size2; ++j)
+        {
+            const double dx = gsl_matrix_get(W, i, j);
+            const double x = gsl_matrix_get(X, i, j) + dx;
+            gsl_matrix_set(X, i, j, x);
+            num += dx * dx;
+            den += x * x;
+        }
+    }
+
+    *delta = den > 0.0 ? sqrt(num / den) : sqrt(num);
+
+    // G = G + AV2A^T
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, A, V2, 0.0, T);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, T, A, 1.0, G);
+
+    // A = AV1
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, A, V1, 0.0, T);
+    EXEC_ASSERT(gsl_matrix_memcpy, A, T);
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_kalman_filter_dare(cfilt_kalman_filter* filt, gsl_matrix* A,
+                         gsl_matrix* G, gsl_matrix* X, gsl_matrix* W,
+                         gsl_matrix* W_inv, gsl_matrix* V1, gsl_matrix* V2,
+                         gsl_matrix* T, gsl_permutation* perm,
+                         const double tol, const size_t max_iter)
+{
+    // P_ = FP_F^T - FP_H^T(HP_H^T + R)^-1HP_F^T + Q is the dual of the
+    // control riccati equation with A = F^T and B = H^T so the doubling
+    // starts from A = F^T, G = H^TR^-1H and X = Q.
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, A, filt->F);
+    EXEC_ASSERT(gsl_matrix_memcpy, X, filt->Q);
+
+    int signum;
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_PH_T_R, filt->R);
+    EXEC_ASSERT(gsl_linalg_LU_decomp, filt->_PH_T_R, filt->_perm, &signum);
+
+    // _PH_T is borrowed to hold H^TR^-1
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, filt->_PH_T, filt->H);
+    for (size_t i = 0; i < filt->_PH_T->size1; ++i)
+    {
+        gsl_vector_view row = gsl_matrix_row(filt->_PH_T, i);
+        EXEC_ASSERT(gsl_linalg_LU_svx, filt->_PH_T_R, filt->_perm,
+                    &row.vector);
+    }
+
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->_PH_T,
+                filt->H, 0.0, G);
+
+    for (size_t i = 0; i < max_iter; ++i)
+    {
+        double delta;
+        EXEC_ASSERT(cfilt_kalman_filter_dare_step, A, G, X, W, W_inv, V1, V2,
+                    T, perm, &delta);
+
+        if (delta <= tol)
+        {
+            EXEC_ASSERT(gsl_matrix_memcpy, filt->P_, X);
+            return GSL_SUCCESS;
+        }
+    }
+
+    GSL_ERROR("riccati doubling did not converge", GSL_EMAXITER);
+}
+
+int
+cfilt_kalman_filter_solve_dare(cfilt_kalman_filter* filt, const double tol,
+                               const size_t max_iter)
+{
+    const size_t n = filt->F->size1;
+    gsl_matrix* A = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_matrix* G = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_matrix* X = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_matrix* W = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_matrix* W_inv = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_matrix* V1 = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_matrix* V2 = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_matrix* T = cfilt_matrix_alloc(filt->_allocator, n, n);
+    gsl_permutation* perm = cfilt_permutation_alloc(filt->_allocator, n);
+
+    if (!A || !G || !X || !W || !W_inv || !V1 || !V2 || !T || !perm)
+    {
+        cfilt_kalman_filter_dare_free(A, G, X, W, W_inv, V1, V2, T, perm);
+
+        return GSL_ENOMEM;
+    }
+
+    const int status = cfilt_kalman_filter_dare(
+      filt, A, G, X, W, W_inv, V1, V2, T, perm, tol, max_iter);
+    cfilt_kalman_filter_dare_free(A, G, X, W, W_inv, V1, V2, T, perm);
+
+    if (status != GSL_SUCCESS)
+    {
+        return status;
+    }
+
+    // Steady state gain and posterior covariance : P = P_ - K(P_H^T)^T
+    EXEC_ASSERT(cfilt_kalman_filter_gain, filt);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->P, filt->P_);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, -1.0, filt->K,
+                filt->_PH_T, 1.0, filt->P);
+
+    filt->steady_state = 1;
+    filt->_frozen = 0;
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_horizon_workspace_alloc(cfilt_kalman_horizon_workspace* w,
+                                     const size_t n, const size_t levels)
+{
+    return cfilt_kalman_horizon_workspace_alloc_from(w, NULL, n, levels);
+}
+
+int
+cfilt_kalman_horizon_workspace_alloc_from(cfilt_kalman_horizon_workspace* w,
+                                          cfilt_allocator* allocator,
+                                          const size_t n, const size_t levels)
+{
+    if (n * levels == 0)
+    {
+        GSL_ERROR("n and levels must be non zero positive integers",
+                  GSL_EINVAL);
+    }
+
+    memset(w, 0, sizeof(cfilt_kalman_horizon_workspace));
+    w->_allocator = allocator ? allocator : cfilt_allocator_get();
+    w->n = n;
+    w->levels = levels;
+
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->F, levels * n, n,
+                        cfilt_kalman_horizon_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->Q, levels * n, n,
+                        cfilt_kalman_horizon_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->b, levels, n,
+                        cfilt_kalman_horizon_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->P, n, n,
+                        cfilt_kalman_horizon_workspace_free, w);
+    M_ALLOC_ASSERT_FROM(w->_allocator, w->T, n, n,
+                        cfilt_kalman_horizon_workspace_free, w);
+    V_ALLOC_ASSERT_FROM(w->_allocator, w->x, n,
+                        cfilt_kalman_horizon_workspace_free, w);
+    V_ALLOC_ASSERT_FROM(w->_allocator, w->d, n,
+                        cfilt_kalman_horizon_workspace_free, w);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_kalman_horizon_workspace_free(cfilt_kalman_horizon_workspace* w)
+{
+    M_FREE_IF_NOT_NULL(w->F);
+    M_FREE_IF_NOT_NULL(w->Q);
+    M_FREE_IF_NOT_NULL(w->b);
+    M_FREE_IF_NOT_NULL(w->P);
+    M_FREE_IF_NOT_NULL(w->T);
+    V_FREE_IF_NOT_NULL(w->x);
+    V_FREE_IF_NOT_NULL(w->d);
+
+    memset(w, 0, sizeof(cfilt_kalman_horizon_workspace));
+}
+
+static gsl_matrix_view
+cfilt_kalman_horizon_block(gsl_matrix* levels, const size_t j)
+{
+    const size_t n = levels->size2;
+    return gsl_matrix_submatrix(levels, j * n, 0, n, n);
+}
+
+// Keeps the levels built so far when the model has not changed
+static int
+cfilt_kalman_horizon_sync(const cfilt_kalman_filter* filt,
+                          cfilt_kalman_horizon_workspace* w)
+{
+    gsl_matrix_view F = cfilt_kalman_horizon_block(w->F, 0);
+    gsl_matrix_view Q = cfilt_kalman_horizon_block(w->Q, 0);
+    gsl_vector_view b = gsl_matrix_row(w->b, 0);
+
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->B, filt->u, 0.0,
+                w->d);
+    if (w->valid > 0 &&
+        cfilt_matrix_cmp_tol(&F.matrix, filt->F, 0.0) == GSL_SUCCESS &&
+        cfilt_matrix_cmp_tol(&Q.matrix, filt->Q, 0.0) == GSL_SUCCESS &&
+        cfilt_vector_cmp_tol(&b.vector, w->d, 0.0) == GSL_SUCCESS)
+    {
+        return GSL_SUCCESS;
+    }
+
+    EXEC_ASSERT(gsl_matrix_memcpy, &F.matrix, filt->F);
+    EXEC_ASSERT(gsl_matrix_memcpy, &Q.matrix, filt->Q);
+    EXEC_ASSERT(gsl_vector_memcpy, &b.vector, w->d);
+    w->valid = 1;
+
+    return GSL_SUCCESS;
+}
+
+// Level j from level j - 1
+static int
+cfilt_kalman_horizon_double(cfilt_kalman_horizon_workspace* w, const size_t j)
+{
+    gsl_matrix_view F_prev = cfilt_kalman_horizon_block(w->F, j - 1);
+    gsl_matrix_view Q_prev = cfilt_kalman_horizon_block(w->Q, j - 1);
+    gsl_vector_view b_prev = gsl_matrix_row(w->b, j - 1);
+    gsl_matrix_view F = cfilt_kalman_horizon_block(w->F, j);
+    gsl_matrix_view Q = cfilt_kalman_horizon_block(w->Q, j);
+    gsl_vector_view b = gsl_matrix_row(w->b, j);
+
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0,
+                &F_prev.matrix, &F_prev.matrix, 0.0, &F.matrix);
+
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0,
+                &F_prev.matrix, &Q_prev.matrix, 0.0, w->T);
+    EXEC_ASSERT(gsl_matrix_memcpy, &Q.matrix, &Q_prev.matrix);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, w->T,
+                &F_prev.matrix, 1.0, &Q.matrix);
+
+    EXEC_ASSERT(gsl_vector_memcpy, &b.vector, &b_prev.vector);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, &F_prev.matrix,
+                &b_prev.vector, 1.0, &b.vector);
+
+    return GSL_SUCCESS;
+}
+
+// 2^j predictions of w->x and w->P
+static int
+cfilt_kalman_horizon_apply(cfilt_kalman_horizon_workspace* w, const size_t j,
+                           const int covariance)
+{
+    for (; w->valid <= j; ++w->valid)
+    {
+        EXEC_ASSERT(cfilt_kalman_horizon_double, w, w->valid);
+    }
+
+    gsl_matrix_view F = cfilt_kalman_horizon_block(w->F, j);
+    gsl_matrix_view Q = cfilt_kalman_horizon_block(w->Q, j);
+    gsl_vector_view b = gsl_matrix_row(w->b, j);
+
+    EXEC_ASSERT(gsl_vector_memcpy, w->d, w->x);
+    EXEC_ASSERT(gsl_vector_memcpy, w->x, &b.vector);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, &F.matrix, w->d, 1.0,
+                w->x);
+
+    if (covariance)
+    {
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0,
+                    &F.matrix, w->P, 0.0, w->T);
+        EXEC_ASSERT(gsl_matrix_memcpy, w->P, &Q.matrix);
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, w->T,
+                    &F.matrix, 1.0, w->P);
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_filter_predict_horizon(const cfilt_kalman_filter* filt,
+                                    const size_t* offsets, const size_t count,
+                                    gsl_matrix* X, gsl_matrix* Ps,
+                                    cfilt_kalman_horizon_workspace* w)
+{
+    const size_t n = filt->x->size;
+    if (w->n != n || X->size1 != count || X->size2 != n ||
+        (Ps && (Ps->size1 != count * n || Ps->size2 != n)))
+    {
+        GSL_ERROR("horizon and filter dimensions differ", GSL_EBADLEN);
+    }
+
+    EXEC_ASSERT(cfilt_kalman_horizon_sync, filt, w);
+
+    const gsl_vector* x;
+    const gsl_matrix* P;
+    cfilt_kalman_filter_posterior(filt, &x, &P);
+
+    EXEC_ASSERT(gsl_vector_memcpy, w->x, x);
+    if (Ps)
+    {
+        EXEC_ASSERT(gsl_matrix_memcpy, w->P, P);
+        EXEC_ASSERT(cfilt_matrix_symmetrize, w->P, 0);
+    }
+
+    const size_t top = w->levels - 1;
+    size_t prev = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (offsets[i] < prev)
+        {
+            GSL_ERROR("horizon offsets must be non decreasing", GSL_EINVAL);
+        }
+
+        // Powers of the same model commute, the bits can go in any order
+        size_t steps = offsets[i] - prev;
+        for (size_t j = 0; steps > 0; ++j, steps >>= 1)
+        {
+            if (j == top)
+            {
+                for (; steps > 0; --steps)
+                {
+                    EXEC_ASSERT(cfilt_kalman_horizon_apply, w, top, Ps != NULL);
+                }
+
+                break;
+            }
+
+            if (steps & 1)
+            {
+                EXEC_ASSERT(cfilt_kalman_horizon_apply, w, j, Ps != NULL);
+            }
+        }
+
+        gsl_vector_view x = gsl_matrix_row(X, i);
+        EXEC_ASSERT(gsl_vector_memcpy, &x.vector, w->x);
+        if (Ps)
+        {
+            gsl_matrix_view P = gsl_matrix_submatrix(Ps, i * n, 0, n, n);
+            EXEC_ASSERT(gsl_matrix_memcpy, &P.matrix, w->P);
+        }
+
+        prev = offsets[i];
+    }
+
+    return GSL_SUCCESS;
+}
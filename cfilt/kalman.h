@@ -20,6 +20,9 @@
 #ifndef KALMAN_H_
 #define KALMAN_H_
 
+#include "cfilt/allocator.h"
+#include "cfilt/kalman_fixed.h"
+
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_permutation.h>
 #include <gsl/gsl_vector.h>
@@ -50,8 +53,59 @@ extern "C" {
  * z (k x 1)    : Measurement vector
  * u (m x 1)    : Control input vector
  * y (k x 1)    : Residual vector
+ *
+ * With CFILT_KALMAN_COVARIANCE_LOWER, P and P_ are symmetric kernels inputs:
+ * only their lower triangles are referenced and computed, and their upper
+ * triangles are left undefined. See cfilt_matrix_symmetrize to recover a full
+ * matrix and cfilt_matrix_sym_pack for compact storage. They keep their n x n
+ * storage (GSL has no packed level-3 routines). Predict still forms the whole
+ * FP and only halves FPF^T, about 3/4 of the flops of the full mode. Update
+ * replaces the n^3 (I - KH)P_ product with an n^2k one.
+ *
+ * With CFILT_KALMAN_UPDATE_SEQUENTIAL, the k measurements are applied one
+ * scalar at a time (rank-1 covariance updates, no factorization). This is only
+ * valid for a diagonal R whose off diagonal terms are then ignored, and K is
+ * not computed. CFILT_KALMAN_UPDATE_AUTO picks it whenever R is diagonal. Both
+ * fall back on the joint update when a scalar innovation variance is not
+ * positive. CFILT_KALMAN_UPDATE_JOINT, the default, always forms K.
+ *
+ * When steady_state is set, P_, P and K are held constant and predict/update
+ * only propagate x_ and x. cfilt_kalman_filter_solve_dare fills them with the
+ * solution of the discrete algebraic riccati equation for constant F, Q, H
+ * and R, and sets the flag.
+ *
+ * With a non zero freeze_window, the filter switches to steady state on its
+ * own once the relative change of P has stayed under freeze_tol for that many
+ * consecutive updates. It switches back to full covariance propagation as soon
+ * as an update is skipped (two predictions in a row) or F, Q, H or R change.
+ *
+ * When innovation_stats is set, update also leaves the normalized innovation
+ * squared y^TS^-1y, log|S| and the measurement log likelihood
+ * log N(z; Hx_, S) for S = HP_H^T + R in nis, log_det_S and log_likelihood.
+ * They come from the factorization of S the update does anyway (or from the
+ * scalar innovation variances of the sequential update) for O(k^2) more
+ * work. In steady state, S is the one factored for the frozen gain. When S is
+ * not positive definite, log_det_S holds log|det S|.
+ *
+ * For n <= 8 (and m <= 4, k <= 8), kernels specialized for the exact
+ * dimensions are selected at allocation time (see kalman_fixed.h) and replace
+ * the GSL calls of the full covariance predict and joint update. In that case
+ * CFILT_KALMAN_UPDATE_AUTO always prefers the joint update.
  */
 
+typedef enum
+{
+    CFILT_KALMAN_COVARIANCE_FULL = 0,
+    CFILT_KALMAN_COVARIANCE_LOWER
+} cfilt_kalman_covariance_mode;
+
+typedef enum
+{
+    CFILT_KALMAN_UPDATE_JOINT = 0,
+    CFILT_KALMAN_UPDATE_AUTO,
+    CFILT_KALMAN_UPDATE_SEQUENTIAL
+} cfilt_kalman_update_mode;
+
 typedef struct
 {
     gsl_vector* x;
@@ -69,25 +123,151 @@ typedef struct
     gsl_matrix* R;
     gsl_matrix* K;
 
+    cfilt_kalman_covariance_mode cov_mode;
+    cfilt_kalman_update_mode update_mode;
+    int steady_state;
+    int innovation_stats;
+
+    double freeze_tol;
+    size_t freeze_window;
+
+    // Innovation statistics of the last update
+    double nis;
+    double log_det_S;
+    double log_likelihood;
+
     // Intermediary results
     gsl_matrix* _FP;
+    gsl_matrix* _HP;
     gsl_matrix* _PH_T;
     gsl_matrix* _PH_T_R;
-    gsl_matrix* _inv;
-    gsl_permutation* _perm;
+    gsl_permutation* _perm; // LU fallback when HP_H^T + R is not SPD
+    int _S_lu;              // _PH_T_R holds the LU factors instead of L
     gsl_matrix* _I;
 
+    // Kernels specialized for small dimensions, NULL when out of range
+    cfilt_kalman_fixed_predict _predict_fixed;
+    cfilt_kalman_fixed_update _update_fixed;
+
+    // Convergence tracking and model snapshot for the automatic steady state
+    int _frozen;
+    int _updated;   // An update since the last predict
+    int _predicted; // A predict since the last update
+    size_t _converged;
+    gsl_matrix* _P_prev;
+    gsl_matrix* _F_frozen;
+    gsl_matrix* _Q_frozen;
+    gsl_matrix* _H_frozen;
+    gsl_matrix* _R_frozen;
+
+    // Single 64 byte aligned block holding every matrix and vector above
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
 } cfilt_kalman_filter;
 
 int cfilt_kalman_filter_alloc(cfilt_kalman_filter* filt, const size_t n,
                               const size_t m, const size_t k);
 
+int cfilt_kalman_filter_alloc_from(cfilt_kalman_filter* filt,
+                                   cfilt_allocator* allocator, const size_t n,
+                                   const size_t m, const size_t k);
+
 void cfilt_kalman_filter_free(cfilt_kalman_filter* filt);
 
 int cfilt_kalman_filter_predict(cfilt_kalman_filter* filt);
 
 int cfilt_kalman_filter_update(cfilt_kalman_filter* filt);
 
+// Update with an innovation y (k x 1) combined from several measurements, C
+// (k x k) taking the place of S in the covariance update,
+//
+//   x = x_ + Ky
+//   P = P_ - KCK^T
+//
+// for K = P_H^TS^-1 as usual, for instance in probabilistic data association.
+// Steady state, freezing and innovation stats (of y) behave as in update, z
+// is not read.
+int cfilt_kalman_filter_update_combined(cfilt_kalman_filter* filt,
+                                        const gsl_vector* y,
+                                        const gsl_matrix* C);
+
+int cfilt_kalman_filter_solve_dare(cfilt_kalman_filter* filt, const double tol,
+                                   const size_t max_iter);
+
+// Current estimate of the filter: x_ and P_ when there was a predict since
+// the last update, x and P otherwise (after an update or before any predict,
+// as initialized). Returns 1 when it includes a measurement
+// (an update since the last predict) and 0 otherwise.
+int cfilt_kalman_filter_posterior(const cfilt_kalman_filter* filt,
+                                  const gsl_vector** x, const gsl_matrix** P);
+
+// Replaces the current estimate with x and P as an update would, for
+// measurements processed outside of the filter
+int cfilt_kalman_filter_set_posterior(cfilt_kalman_filter* filt,
+                                      const gsl_vector* x, const gsl_matrix* P);
+
+/**
+ * Powers of a filter's model for cfilt_kalman_filter_predict_horizon. Level j
+ * holds the model of 2^j predictions in a row,
+ *
+ *   F_j = F_j-1F_j-1
+ *   Q_j = F_j-1Q_j-1F_j-1^T + Q_j-1
+ *   b_j = F_j-1b_j-1 + b_j-1
+ *
+ * from F_0 = F, Q_0 = Q and b_0 = Bu, in blocks of F and Q and rows of b.
+ * Levels are built on demand and kept across calls until the filter's F, Q,
+ * B or u change. Offsets farther than 2^levels - 1 steps repeat the last
+ * level.
+ *
+ * level : Theta(n^3)
+ */
+typedef struct
+{
+    size_t n;
+    size_t levels;
+    size_t valid; // Levels built for the current model
+
+    gsl_matrix* F; // levels * n x n
+    gsl_matrix* Q; // levels * n x n
+    gsl_matrix* b; // levels x n
+
+    gsl_vector* x;
+    gsl_matrix* P;
+    gsl_matrix* T;
+    gsl_vector* d;
+
+    cfilt_allocator* _allocator;
+
+} cfilt_kalman_horizon_workspace;
+
+int cfilt_kalman_horizon_workspace_alloc(cfilt_kalman_horizon_workspace* w,
+                                         const size_t n, const size_t levels);
+
+int cfilt_kalman_horizon_workspace_alloc_from(
+  cfilt_kalman_horizon_workspace* w, cfilt_allocator* allocator,
+  const size_t n, const size_t levels);
+
+void cfilt_kalman_horizon_workspace_free(cfilt_kalman_horizon_workspace* w);
+
+/**
+ * Predictions of the current estimate (see cfilt_kalman_filter_posterior)
+ * count times, offsets[i] steps ahead for non decreasing offsets, into rows
+ * of X (count x n) and blocks of Ps (count * n x n). Ps may be NULL. Every
+ * step uses the filter's F, Q, B and u, and the filter is left untouched.
+ *
+ * Each offset is reached from the previous one with one level per bit of the
+ * difference, so a horizon of k steps takes O(log k) matrix products instead
+ * of k predictions.
+ *
+ * predict_horizon : O(count * log(k) * n^3)
+ */
+int cfilt_kalman_filter_predict_horizon(const cfilt_kalman_filter* filt,
+                                        const size_t* offsets,
+                                        const size_t count, gsl_matrix* X,
+                                        gsl_matrix* Ps,
+                                        cfilt_kalman_horizon_workspace* w);
+
 #ifdef __cplusplus
 }
 #endif
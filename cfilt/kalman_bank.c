@@ -0,0 +1,525 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/kalman_bank.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <math.h>
+#include <string.h>
+
+#define LANES CFILT_KALMAN_BANK_LANES
+
+// Address of element e (out of size per filter) of filter idx in array a
+static double*
+cfilt_kalman_bank_elem(cfilt_lane* a, const size_t size, const size_t idx,
+                       const size_t e)
+{
+    return (double*)&a[(idx / LANES) * size + e] + idx % LANES;
+}
+
+static void
+cfilt_kalman_bank_write_matrix(cfilt_lane* a, const size_t idx,
+                               const gsl_matrix* src)
+{
+    const size_t size = src->size1 * src->size2;
+    for (size_t i = 0; i < src->size1; ++i)
+    {
+        for (size_t j = 0; j < src->size2; ++j)
+        {
+            *cfilt_kalman_bank_elem(a, size, idx, i * src->size2 + j) =
+              gsl_matrix_get(src, i, j);
+        }
+    }
+}
+
+static void
+cfilt_kalman_bank_read_matrix(cfilt_lane* a, const size_t idx, gsl_matrix* dst)
+{
+    const size_t size = dst->size1 * dst->size2;
+    for (size_t i = 0; i < dst->size1; ++i)
+    {
+        for (size_t j = 0; j < dst->size2; ++j)
+        {
+            gsl_matrix_set(
+              dst, i, j,
+              *cfilt_kalman_bank_elem(a, size, idx, i * dst->size2 + j));
+        }
+    }
+}
+
+static void
+cfilt_kalman_bank_write_vector(cfilt_lane* a, const size_t idx,
+                               const gsl_vector* src)
+{
+    for (size_t i = 0; i < src->size; ++i)
+    {
+        *cfilt_kalman_bank_elem(a, src->size, idx, i) = gsl_vector_get(src, i);
+    }
+}
+
+static void
+cfilt_kalman_bank_read_vector(cfilt_lane* a, const size_t idx, gsl_vector* dst)
+{
+    for (size_t i = 0; i < dst->size; ++i)
+    {
+        gsl_vector_set(dst, i, *cfilt_kalman_bank_elem(a, dst->size, idx, i));
+    }
+}
+
+int
+cfilt_kalman_bank_alloc(cfilt_kalman_bank* bank, const size_t count,
+                        const size_t n, const size_t m, const size_t k)
+{
+    return cfilt_kalman_bank_alloc_from(bank, NULL, count, n, m, k);
+}
+
+int
+cfilt_kalman_bank_alloc_from(cfilt_kalman_bank* bank,
+                             cfilt_allocator* allocator, const size_t count,
+                             const size_t n, const size_t m, const size_t k)
+{
+    if (count * n * m * k == 0 || n == 1)
+    {
+        GSL_ERROR("count, n, m and k must be non zero positive integers and n "
+                  "must be greater than 1",
+                  GSL_EINVAL);
+    }
+
+    memset(bank, 0, sizeof(cfilt_kalman_bank));
+
+    bank->_allocator = allocator ? allocator : cfilt_allocator_get();
+    bank->n = n;
+    bank->m = m;
+    bank->k = k;
+    bank->count = count;
+    bank->blocks = (count + LANES - 1) / LANES;
+
+    // Per filter state followed by single block scratch space
+    const size_t per_filter =
+      4 * n * n + n * m + 2 * n * k + k * k + 2 * n + 2 * k + m;
+    const size_t scratch = n * n + n * k + k * k;
+    const size_t lanes = bank->blocks * per_filter + scratch;
+    const size_t size = lanes * sizeof(cfilt_lane) + count * sizeof(int);
+
+    bank->_ptr = cfilt_alloc(bank->_allocator, size, sizeof(cfilt_lane));
+    if (bank->_ptr == NULL)
+    {
+        GSL_ERROR("failed to allocate space for kalman bank", GSL_ENOMEM);
+    }
+
+    memset(bank->_ptr, 0, size);
+
+    cfilt_lane* ptr = bank->_ptr;
+    const size_t nb = bank->blocks;
+
+    bank->x = ptr, ptr += nb * n;
+    bank->x_ = ptr, ptr += nb * n;
+    bank->z = ptr, ptr += nb * k;
+    bank->u = ptr, ptr += nb * m;
+    bank->y = ptr, ptr += nb * k;
+
+    bank->F = ptr, ptr += nb * n * n;
+    bank->B = ptr, ptr += nb * n * m;
+    bank->Q = ptr, ptr += nb * n * n;
+    bank->P = ptr, ptr += nb * n * n;
+    bank->P_ = ptr, ptr += nb * n * n;
+    bank->H = ptr, ptr += nb * k * n;
+    bank->R = ptr, ptr += nb * k * k;
+    bank->K = ptr, ptr += nb * n * k;
+
+    bank->_FP = ptr, ptr += n * n;
+    bank->_PH_T = ptr, ptr += n * k;
+    bank->_S = ptr, ptr += k * k;
+    bank->status = (int*)ptr;
+
+    // Padding lanes never get loaded. A unit R keeps their innovation
+    // covariance positive definite so they cannot poison a block.
+    for (size_t b = 0; b < nb; ++b)
+    {
+        for (size_t i = 0; i < k; ++i)
+        {
+            for (size_t l = 0; l < LANES; ++l)
+            {
+                bank->R[b * k * k + i * k + i][l] = 1.0;
+            }
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_kalman_bank_free(cfilt_kalman_bank* bank)
+{
+    if (bank->_ptr)
+    {
+        cfilt_free(bank->_allocator, bank->_ptr);
+    }
+
+    memset(bank, 0, sizeof(cfilt_kalman_bank));
+}
+
+int
+cfilt_kalman_bank_load(cfilt_kalman_bank* bank, const size_t idx,
+                       const cfilt_kalman_filter* filt)
+{
+    if (idx >= bank->count)
+    {
+        GSL_ERROR("filter index is out of range", GSL_EINVAL);
+    }
+
+    if (filt->x->size != bank->n || filt->u->size != bank->m ||
+        filt->z->size != bank->k)
+    {
+        GSL_ERROR("filter dimensions do not match the bank's", GSL_EBADLEN);
+    }
+
+    cfilt_kalman_bank_write_vector(bank->x, idx, filt->x);
+    cfilt_kalman_bank_write_vector(bank->z, idx, filt->z);
+    cfilt_kalman_bank_write_vector(bank->u, idx, filt->u);
+
+    cfilt_kalman_bank_write_matrix(bank->F, idx, filt->F);
+    cfilt_kalman_bank_write_matrix(bank->B, idx, filt->B);
+    cfilt_kalman_bank_write_matrix(bank->Q, idx, filt->Q);
+    cfilt_kalman_bank_write_matrix(bank->P, idx, filt->P);
+    cfilt_kalman_bank_write_matrix(bank->H, idx, filt->H);
+    cfilt_kalman_bank_write_matrix(bank->R, idx, filt->R);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_bank_store(const cfilt_kalman_bank* bank, const size_t idx,
+                        cfilt_kalman_filter* filt)
+{
+    if (idx >= bank->count)
+    {
+        GSL_ERROR("filter index is out of range", GSL_EINVAL);
+    }
+
+    if (filt->x->size != bank->n || filt->u->size != bank->m ||
+        filt->z->size != bank->k)
+    {
+        GSL_ERROR("filter dimensions do not match the bank's", GSL_EBADLEN);
+    }
+
+    cfilt_kalman_bank_read_vector(bank->x, idx, filt->x);
+    cfilt_kalman_bank_read_vector(bank->x_, idx, filt->x_);
+    cfilt_kalman_bank_read_vector(bank->y, idx, filt->y);
+
+    cfilt_kalman_bank_read_matrix(bank->P, idx, filt->P);
+    cfilt_kalman_bank_read_matrix(bank->P_, idx, filt->P_);
+    cfilt_kalman_bank_read_matrix(bank->K, idx, filt->K);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_bank_write_z(cfilt_kalman_bank* bank, const size_t idx,
+                          const gsl_vector* z)
+{
+    if (idx >= bank->count || z->size != bank->k)
+    {
+        GSL_ERROR("invalid filter index or measurement size", GSL_EINVAL);
+    }
+
+    cfilt_kalman_bank_write_vector(bank->z, idx, z);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_bank_write_u(cfilt_kalman_bank* bank, const size_t idx,
+                          const gsl_vector* u)
+{
+    if (idx >= bank->count || u->size != bank->m)
+    {
+        GSL_ERROR("invalid filter index or control size", GSL_EINVAL);
+    }
+
+    cfilt_kalman_bank_write_vector(bank->u, idx, u);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_bank_read_x(const cfilt_kalman_bank* bank, const size_t idx,
+                         gsl_vector* x)
+{
+    if (idx >= bank->count || x->size != bank->n)
+    {
+        GSL_ERROR("invalid filter index or state size", GSL_EINVAL);
+    }
+
+    cfilt_kalman_bank_read_vector(bank->x, idx, x);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_bank_predict(cfilt_kalman_bank* bank)
+{
+    const size_t n = bank->n;
+    const size_t m = bank->m;
+    cfilt_lane* FP = bank->_FP;
+
+    for (size_t b = 0; b < bank->blocks; ++b)
+    {
+        const cfilt_lane* F = bank->F + b * n * n;
+        const cfilt_lane* B = bank->B + b * n * m;
+        const cfilt_lane* Q = bank->Q + b * n * n;
+        const cfilt_lane* P = bank->P + b * n * n;
+        const cfilt_lane* x = bank->x + b * n;
+        const cfilt_lane* u = bank->u + b * m;
+        cfilt_lane* x_ = bank->x_ + b * n;
+        cfilt_lane* P_ = bank->P_ + b * n * n;
+
+        // x_ = Fx + Bu
+        for (size_t i = 0; i < n; ++i)
+        {
+            cfilt_lane acc = F[i * n] * x[0];
+            for (size_t j = 1; j < n; ++j)
+            {
+                acc += F[i * n + j] * x[j];
+            }
+
+            for (size_t j = 0; j < m; ++j)
+            {
+                acc += B[i * m + j] * u[j];
+            }
+
+            x_[i] = acc;
+        }
+
+        // P_ = FPF^T + Q
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < n; ++j)
+            {
+                cfilt_lane acc = F[i * n] * P[j];
+                for (size_t l = 1; l < n; ++l)
+                {
+                    acc += F[i * n + l] * P[l * n + j];
+                }
+
+                FP[i * n + j] = acc;
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < n; ++j)
+            {
+                cfilt_lane acc = Q[i * n + j];
+                for (size_t l = 0; l < n; ++l)
+                {
+                    acc += FP[i * n + l] * F[j * n + l];
+                }
+
+                P_[i * n + j] = acc;
+            }
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_kalman_bank_update(cfilt_kalman_bank* bank)
+{
+    const size_t n = bank->n;
+    const size_t k = bank->k;
+    cfilt_lane* PH_T = bank->_PH_T;
+    cfilt_lane* S = bank->_S;
+    int status = GSL_SUCCESS;
+
+    for (size_t b = 0; b < bank->blocks; ++b)
+    {
+        int failed[LANES] = { 0 };
+
+        const cfilt_lane* H = bank->H + b * k * n;
+        const cfilt_lane* R = bank->R + b * k * k;
+        const cfilt_lane* P_ = bank->P_ + b * n * n;
+        const cfilt_lane* x_ = bank->x_ + b * n;
+        const cfilt_lane* z = bank->z + b * k;
+        cfilt_lane* K = bank->K + b * n * k;
+        cfilt_lane* x = bank->x + b * n;
+        cfilt_lane* y = bank->y + b * k;
+        cfilt_lane* P = bank->P + b * n * n;
+
+        // P_H^T
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t a = 0; a < k; ++a)
+            {
+                cfilt_lane acc = P_[i * n] * H[a * n];
+                for (size_t j = 1; j < n; ++j)
+                {
+                    acc += P_[i * n + j] * H[a * n + j];
+                }
+
+                PH_T[i * k + a] = acc;
+            }
+        }
+
+        // S = HP_H^T + R factored in place as LL^T (lower triangle).
+        // The diagonal of S holds the reciprocal of L's diagonal so that the
+        // solves below only multiply.
+        for (size_t a = 0; a < k; ++a)
+        {
+            for (size_t c = 0; c <= a; ++c)
+            {
+                cfilt_lane acc = R[a * k + c];
+                for (size_t j = 0; j < n; ++j)
+                {
+                    acc += H[a * n + j] * PH_T[j * k + c];
+                }
+
+                for (size_t d = 0; d < c; ++d)
+                {
+                    acc -= S[a * k + d] * S[c * k + d];
+                }
+
+                if (c < a)
+                {
+                    S[a * k + c] = acc * S[c * k + c];
+                    continue;
+                }
+
+                // A failing lane goes on with a unit pivot so that the block
+                // stays finite, its results are discarded below
+                for (size_t l = 0; l < LANES; ++l)
+                {
+                    if (!(acc[l] > 0.0))
+                    {
+                        failed[l] = 1;
+                        acc[l] = 1.0;
+                    }
+
+                    acc[l] = 1.0 / sqrt(acc[l]);
+                }
+
+                S[a * k + a] = acc;
+            }
+        }
+
+        // K = P_H^TS^-1 solved row by row through L and L^T
+        for (size_t i = 0; i < n; ++i)
+        {
+            cfilt_lane* Ki = K + i * k;
+            for (size_t a = 0; a < k; ++a)
+            {
+                cfilt_lane acc = PH_T[i * k + a];
+                for (size_t c = 0; c < a; ++c)
+                {
+                    acc -= S[a * k + c] * Ki[c];
+                }
+
+                Ki[a] = acc * S[a * k + a];
+            }
+
+            for (size_t a = k; a-- > 0;)
+            {
+                cfilt_lane acc = Ki[a];
+                for (size_t c = a + 1; c < k; ++c)
+                {
+                    acc -= S[c * k + a] * Ki[c];
+                }
+
+                Ki[a] = acc * S[a * k + a];
+            }
+        }
+
+        // y = z - Hx_
+        for (size_t a = 0; a < k; ++a)
+        {
+            cfilt_lane acc = z[a];
+            for (size_t j = 0; j < n; ++j)
+            {
+                acc -= H[a * n + j] * x_[j];
+            }
+
+            y[a] = acc;
+        }
+
+        // x = x_ + Ky
+        for (size_t i = 0; i < n; ++i)
+        {
+            cfilt_lane acc = x_[i];
+            for (size_t a = 0; a < k; ++a)
+            {
+                acc += K[i * k + a] * y[a];
+            }
+
+            x[i] = acc;
+        }
+
+        // P = (I - KH)P_ = P_ - K(P_H^T)^T
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < n; ++j)
+            {
+                cfilt_lane acc = P_[i * n + j];
+                for (size_t a = 0; a < k; ++a)
+                {
+                    acc -= K[i * k + a] * PH_T[j * k + a];
+                }
+
+                P[i * n + j] = acc;
+            }
+        }
+
+        // Failing filters keep their prediction, with a zero gain
+        for (size_t l = 0; l < LANES && b * LANES + l < bank->count; ++l)
+        {
+            bank->status[b * LANES + l] = failed[l] ? GSL_EDOM : GSL_SUCCESS;
+            if (!failed[l])
+            {
+                continue;
+            }
+
+            status = GSL_EDOM;
+            for (size_t i = 0; i < n; ++i)
+            {
+                x[i][l] = x_[i][l];
+                for (size_t j = 0; j < n; ++j)
+                {
+                    P[i * n + j][l] = P_[i * n + j][l];
+                }
+
+                for (size_t a = 0; a < k; ++a)
+                {
+                    K[i * k + a][l] = 0.0;
+                }
+            }
+        }
+    }
+
+    if (status != GSL_SUCCESS)
+    {
+        GSL_ERROR("innovation covariance is not positive definite",
+                  GSL_EDOM);
+    }
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef KALMAN_BANK_H_
+#define KALMAN_BANK_H_
+
+#include "cfilt/kalman.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A bank of linear Kalman filters sharing the same dimensions (n, m, k).
+ * Matrices and vectors have the same meaning as in kalman.h but each one is
+ * stored for all filters at once in an interleaved structure-of-arrays layout:
+ * filters are grouped in blocks of CFILT_KALMAN_BANK_LANES and, within a
+ * block, element e of every filter is contiguous. One filter maps to one SIMD
+ * lane so predict and update run on a whole block per instruction.
+ *
+ * Filters are written and read back with the load/store functions. The bank
+ * is stepped with cfilt_kalman_bank_predict and cfilt_kalman_bank_update
+ * which behave like their cfilt_kalman_filter counterparts.
+ *
+ * When the innovation covariance of a filter is not positive definite, the
+ * update leaves that filter at its prediction (x = x_, P = P_, K = 0),
+ * carries on with the others and returns GSL_EDOM. status[idx] tells which
+ * filters failed the last update (GSL_EDOM) and which did not (GSL_SUCCESS).
+ */
+
+#define CFILT_KALMAN_BANK_LANES 8
+
+typedef double cfilt_lane
+  __attribute__((vector_size(CFILT_KALMAN_BANK_LANES * sizeof(double))));
+
+typedef struct
+{
+    size_t n;
+    size_t m;
+    size_t k;
+    size_t count;
+    size_t blocks;
+
+    cfilt_lane* x;
+    cfilt_lane* x_;
+    cfilt_lane* z;
+    cfilt_lane* u;
+    cfilt_lane* y;
+
+    cfilt_lane* F;
+    cfilt_lane* B;
+    cfilt_lane* Q;
+    cfilt_lane* P;
+    cfilt_lane* P_;
+    cfilt_lane* H;
+    cfilt_lane* R;
+    cfilt_lane* K;
+
+    // Per filter outcome of the last update
+    int* status;
+
+    // Intermediary results (one block only)
+    cfilt_lane* _FP;
+    cfilt_lane* _PH_T;
+    cfilt_lane* _S;
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_kalman_bank;
+
+int cfilt_kalman_bank_alloc(cfilt_kalman_bank* bank, const size_t count,
+                            const size_t n, const size_t m, const size_t k);
+
+int cfilt_kalman_bank_alloc_from(cfilt_kalman_bank* bank,
+                                 cfilt_allocator* allocator, const size_t count,
+                                 const size_t n, const size_t m,
+                                 const size_t k);
+
+void cfilt_kalman_bank_free(cfilt_kalman_bank* bank);
+
+int cfilt_kalman_bank_load(cfilt_kalman_bank* bank, const size_t idx,
+                           const cfilt_kalman_filter* filt);
+
+int cfilt_kalman_bank_store(const cfilt_kalman_bank* bank, const size_t idx,
+                            cfilt_kalman_filter* filt);
+
+int cfilt_kalman_bank_write_z(cfilt_kalman_bank* bank, const size_t idx,
+                              const gsl_vector* z);
+
+int cfilt_kalman_bank_write_u(cfilt_kalman_bank* bank, const size_t idx,
+                              const gsl_vector* u);
+
+int cfilt_kalman_bank_read_x(const cfilt_kalman_bank* bank, const size_t idx,
+                             gsl_vector* x);
+
+int cfilt_kalman_bank_predict(cfilt_kalman_bank* bank);
+
+int cfilt_kalman_bank_update(cfilt_kalman_bank* bank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KALMAN_BANK_H_
@@ -0,0 +1,317 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/kalman_fixed.h"
+
+#include <gsl/gsl_errno.h>
+
+#include <math.h>
+
+#define UNROLL _Pragma("GCC unroll 8")
+#define INLINE static inline __attribute__((always_inline))
+
+// Generic bodies, only ever called with constant dimensions. The innermost
+// loops are fully unrolled, the outer ones are left to the optimizer to keep
+// the 84 instantiations reasonably small
+INLINE void
+cfilt_kalman_fixed_predict_(const size_t n, const size_t m,
+                            const double* restrict F, const double* restrict B,
+                            const double* restrict Q, const double* restrict P,
+                            const double* restrict x, const double* restrict u,
+                            double* restrict x_, double* restrict P_)
+{
+    double FP[n * n];
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        double acc = 0.0;
+        UNROLL for (size_t j = 0; j < n; ++j)
+        {
+            acc += F[i * n + j] * x[j];
+        }
+
+        UNROLL for (size_t j = 0; j < m; ++j)
+        {
+            acc += B[i * m + j] * u[j];
+        }
+
+        x_[i] = acc;
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < n; ++j)
+        {
+            double acc = 0.0;
+            UNROLL for (size_t l = 0; l < n; ++l)
+            {
+                acc += F[i * n + l] * P[l * n + j];
+            }
+
+            FP[i * n + j] = acc;
+        }
+    }
+
+    // P_ is symmetric, the upper triangle is mirrored
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j <= i; ++j)
+        {
+            double acc = 0.0;
+            UNROLL for (size_t l = 0; l < n; ++l)
+            {
+                acc += FP[i * n + l] * F[j * n + l];
+            }
+
+            P_[i * n + j] = acc + Q[i * n + j];
+            P_[j * n + i] = acc + Q[j * n + i];
+        }
+    }
+}
+
+INLINE int
+cfilt_kalman_fixed_update_(const size_t n, const size_t k,
+                           const double* restrict H, const double* restrict R,
+                           const double* restrict P_,
+                           const double* restrict x_, const double* restrict z,
+                           double* restrict K, double* restrict y,
+                           double* restrict x, double* restrict P,
+                           double* restrict nis, double* restrict log_det_S)
+{
+    double PH_T[n * k];
+    double L[k * k];
+    double D[k];
+    double w[k];
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t a = 0; a < k; ++a)
+        {
+            double acc = 0.0;
+            UNROLL for (size_t j = 0; j < n; ++j)
+            {
+                acc += P_[i * n + j] * H[a * n + j];
+            }
+
+            PH_T[i * k + a] = acc;
+        }
+    }
+
+    // HP_H^T + R = LL^T, D holds the reciprocal of L's diagonal
+    for (size_t a = 0; a < k; ++a)
+    {
+        for (size_t c = 0; c <= a; ++c)
+        {
+            double acc = R[a * k + c];
+            UNROLL for (size_t j = 0; j < n; ++j)
+            {
+                acc += H[a * n + j] * PH_T[j * k + c];
+            }
+
+            UNROLL for (size_t d = 0; d < c; ++d)
+            {
+                acc -= L[a * k + d] * L[c * k + d];
+            }
+
+            if (c < a)
+            {
+                L[a * k + c] = acc * D[c];
+            }
+            else if (acc > 0.0)
+            {
+                L[a * k + a] = sqrt(acc);
+                D[a] = 1.0 / L[a * k + a];
+            }
+            else
+            {
+                return GSL_EDOM;
+            }
+        }
+    }
+
+    // KLL^T = P_H^T
+    for (size_t i = 0; i < n; ++i)
+    {
+        double* Ki = K + i * k;
+        for (size_t a = 0; a < k; ++a)
+        {
+            double acc = PH_T[i * k + a];
+            UNROLL for (size_t c = 0; c < a; ++c)
+            {
+                acc -= L[a * k + c] * Ki[c];
+            }
+
+            Ki[a] = acc * D[a];
+        }
+
+        for (size_t a = k; a-- > 0;)
+        {
+            double acc = Ki[a];
+            UNROLL for (size_t c = a + 1; c < k; ++c)
+            {
+                acc -= L[c * k + a] * Ki[c];
+            }
+
+            Ki[a] = acc * D[a];
+        }
+    }
+
+    // y = z - Hx_
+    for (size_t a = 0; a < k; ++a)
+    {
+        double acc = z[a];
+        UNROLL for (size_t j = 0; j < n; ++j)
+        {
+            acc -= H[a * n + j] * x_[j];
+        }
+
+        y[a] = acc;
+    }
+
+    // y^T(LL^T)^-1y = |L^-1y|^2 and log|LL^T| = 2 sum log L_aa
+    if (nis)
+    {
+        double nis_ = 0.0;
+        double log_det = 0.0;
+        for (size_t a = 0; a < k; ++a)
+        {
+            double acc = y[a];
+            UNROLL for (size_t c = 0; c < a; ++c)
+            {
+                acc -= L[a * k + c] * w[c];
+            }
+
+            w[a] = acc * D[a];
+            nis_ += w[a] * w[a];
+            log_det += log(L[a * k + a]);
+        }
+
+        *nis = nis_;
+        *log_det_S = 2.0 * log_det;
+    }
+
+    // x = x_ + Ky
+    for (size_t i = 0; i < n; ++i)
+    {
+        double acc = x_[i];
+        UNROLL for (size_t a = 0; a < k; ++a)
+        {
+            acc += K[i * k + a] * y[a];
+        }
+
+        x[i] = acc;
+    }
+
+    // P = P_ - K(P_H^T)^T, symmetric
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j <= i; ++j)
+        {
+            double acc = P_[i * n + j];
+            UNROLL for (size_t a = 0; a < k; ++a)
+            {
+                acc -= K[i * k + a] * PH_T[j * k + a];
+            }
+
+            P[i * n + j] = acc;
+            P[j * n + i] = acc;
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+#define PREDICT(N, M)                                                          \
+    static void cfilt_kalman_fixed_predict_##N##_##M(                          \
+      const double* F, const double* B, const double* Q, const double* P,      \
+      const double* x, const double* u, double* x_, double* P_)                \
+    {                                                                          \
+        cfilt_kalman_fixed_predict_(N, M, F, B, Q, P, x, u, x_, P_);           \
+    }
+
+#define UPDATE(N, K)                                                           \
+    static int cfilt_kalman_fixed_update_##N##_##K(                            \
+      const double* H, const double* R, const double* P_, const double* x_,    \
+      const double* z, double* K_, double* y, double* x, double* P,            \
+      double* nis, double* log_det_S)                                          \
+    {                                                                          \
+        return cfilt_kalman_fixed_update_(N, K, H, R, P_, x_, z, K_, y, x, P,  \
+                                          nis, log_det_S);                     \
+    }
+
+#define PREDICT_N(N) PREDICT(N, 1) PREDICT(N, 2) PREDICT(N, 3) PREDICT(N, 4)
+#define UPDATE_N(N)                                                            \
+    UPDATE(N, 1)                                                               \
+    UPDATE(N, 2)                                                               \
+    UPDATE(N, 3)                                                               \
+    UPDATE(N, 4)                                                               \
+    UPDATE(N, 5) UPDATE(N, 6) UPDATE(N, 7) UPDATE(N, 8)
+#define FOR_EACH_N(X) X(2) X(3) X(4) X(5) X(6) X(7) X(8)
+
+FOR_EACH_N(PREDICT_N)
+FOR_EACH_N(UPDATE_N)
+
+#define PREDICT_ROW(N)                                                         \
+    {                                                                          \
+        cfilt_kalman_fixed_predict_##N##_1,                                    \
+        cfilt_kalman_fixed_predict_##N##_2,                                    \
+        cfilt_kalman_fixed_predict_##N##_3,                                    \
+        cfilt_kalman_fixed_predict_##N##_4,                                    \
+    },
+#define UPDATE_ROW(N)                                                          \
+    {                                                                          \
+        cfilt_kalman_fixed_update_##N##_1, cfilt_kalman_fixed_update_##N##_2,  \
+        cfilt_kalman_fixed_update_##N##_3, cfilt_kalman_fixed_update_##N##_4,  \
+        cfilt_kalman_fixed_update_##N##_5, cfilt_kalman_fixed_update_##N##_6,  \
+        cfilt_kalman_fixed_update_##N##_7, cfilt_kalman_fixed_update_##N##_8,  \
+    },
+
+static const cfilt_kalman_fixed_predict
+  predict_kernels[CFILT_KALMAN_FIXED_MAX_N - 1][CFILT_KALMAN_FIXED_MAX_M] = {
+      FOR_EACH_N(PREDICT_ROW)
+  };
+
+static const cfilt_kalman_fixed_update
+  update_kernels[CFILT_KALMAN_FIXED_MAX_N - 1][CFILT_KALMAN_FIXED_MAX_K] = {
+      FOR_EACH_N(UPDATE_ROW)
+  };
+
+cfilt_kalman_fixed_predict
+cfilt_kalman_fixed_predict_select(const size_t n, const size_t m)
+{
+    if (n < 2 || n > CFILT_KALMAN_FIXED_MAX_N || m < 1 ||
+        m > CFILT_KALMAN_FIXED_MAX_M)
+    {
+        return NULL;
+    }
+
+    return predict_kernels[n - 2][m - 1];
+}
+
+cfilt_kalman_fixed_update
+cfilt_kalman_fixed_update_select(const size_t n, const size_t k)
+{
+    if (n < 2 || n > CFILT_KALMAN_FIXED_MAX_N || k < 1 ||
+        k > CFILT_KALMAN_FIXED_MAX_K)
+    {
+        return NULL;
+    }
+
+    return update_kernels[n - 2][k - 1];
+}
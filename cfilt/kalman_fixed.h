@@ -0,0 +1,66 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef KALMAN_FIXED_H_
+#define KALMAN_FIXED_H_
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Kalman filter kernels specialized at compile time for small dimensions.
+ * Every matrix is a contiguous row major array with the same meaning as in
+ * kalman.h. Predict kernels exist for every (n, m) and update kernels for
+ * every (n, k) up to the limits below.
+ */
+
+#define CFILT_KALMAN_FIXED_MAX_N 8
+#define CFILT_KALMAN_FIXED_MAX_M 4
+#define CFILT_KALMAN_FIXED_MAX_K 8
+
+// x_ = Fx + Bu, P_ = FPF^T + Q
+typedef void (*cfilt_kalman_fixed_predict)(const double* F, const double* B,
+                                           const double* Q, const double* P,
+                                           const double* x, const double* u,
+                                           double* x_, double* P_);
+
+// Joint update through a cholesky factorization of HP_H^T + R, also giving
+// the normalized innovation squared and log|HP_H^T + R| unless nis is NULL.
+// Returns GSL_EDOM without touching the outputs if it is not positive
+// definite.
+typedef int (*cfilt_kalman_fixed_update)(const double* H, const double* R,
+                                         const double* P_, const double* x_,
+                                         const double* z, double* K,
+                                         double* y, double* x, double* P,
+                                         double* nis, double* log_det_S);
+
+cfilt_kalman_fixed_predict cfilt_kalman_fixed_predict_select(const size_t n,
+                                                             const size_t m);
+
+cfilt_kalman_fixed_update cfilt_kalman_fixed_update_select(const size_t n,
+                                                           const size_t k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KALMAN_FIXED_H_
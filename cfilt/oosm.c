@@ -0,0 +1,505 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/oosm.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+#include <string.h>
+
+// Offsets of a record's fields in doubles, x being first
+#define OOSM_TRI(n) ((n) * ((n) + 1) / 2)
+#define OOSM_P(n) (n)
+#define OOSM_X_(n) ((n) + OOSM_TRI(n))
+#define OOSM_P_(n) (2 * (n) + OOSM_TRI(n))
+#define OOSM_Z(n) (2 * (n) + 2 * OOSM_TRI(n))
+#define OOSM_COUNT(n, k) (OOSM_Z(n) + (k))
+#define OOSM_STALE(n, k) (OOSM_Z(n) + (k) + 1)
+#define OOSM_F(n, k) (OOSM_Z(n) + (k) + 2)
+#define OOSM_Q(n, k) (OOSM_F(n, k) + (n) * (n))
+#define OOSM_U(n, k) (OOSM_Q(n, k) + OOSM_TRI(n))
+
+int
+cfilt_oosm_alloc(cfilt_oosm* oosm, const size_t n, const size_t m,
+                 const size_t k, const size_t depth, const int varying)
+{
+    return cfilt_oosm_alloc_from(oosm, NULL, n, m, k, depth, varying);
+}
+
+int
+cfilt_oosm_alloc_from(cfilt_oosm* oosm, cfilt_allocator* allocator,
+                      const size_t n, const size_t m, const size_t k,
+                      const size_t depth, const int varying)
+{
+    if (n * m * k * depth == 0)
+    {
+        GSL_ERROR("n, m, k and depth must be non zero positive integers",
+                  GSL_EINVAL);
+    }
+
+    memset(oosm, 0, sizeof(cfilt_oosm));
+    oosm->_allocator = allocator ? allocator : cfilt_allocator_get();
+    oosm->n = n;
+    oosm->m = m;
+    oosm->k = k;
+    oosm->depth = depth;
+    oosm->varying = varying;
+    oosm->_record = varying ? OOSM_U(n, k) + m : OOSM_F(n, k);
+
+    oosm->_data = cfilt_alloc(oosm->_allocator,
+                              depth * oosm->_record * sizeof(double),
+                              CFILT_ALIGN);
+    if (oosm->_data == NULL)
+    {
+        GSL_ERROR("failed to allocate space for measurement history",
+                  GSL_ENOMEM);
+    }
+
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_P, n, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_P_, n, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_Fi, n, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_Q, n, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_Pxv, n, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_T, n, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_U, n, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_G, k, n, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_Pxz, n, k, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_S, k, k, cfilt_oosm_free,
+                        oosm);
+    M_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_R, k, k, cfilt_oosm_free,
+                        oosm);
+    V_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_x, n, cfilt_oosm_free, oosm);
+    V_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_a, n, cfilt_oosm_free, oosm);
+    V_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_d, n, cfilt_oosm_free, oosm);
+    V_ALLOC_ASSERT_FROM(oosm->_allocator, oosm->_e, k, cfilt_oosm_free, oosm);
+
+    oosm->_perm = cfilt_permutation_alloc(oosm->_allocator, n);
+    if (oosm->_perm == NULL)
+    {
+        cfilt_oosm_free(oosm);
+        GSL_ERROR("failed to allocate space for permutation", GSL_ENOMEM);
+    }
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_oosm_free(cfilt_oosm* oosm)
+{
+    if (oosm->_data)
+    {
+        cfilt_free(oosm->_allocator, oosm->_data);
+    }
+
+    M_FREE_IF_NOT_NULL(oosm->_P);
+    M_FREE_IF_NOT_NULL(oosm->_P_);
+    M_FREE_IF_NOT_NULL(oosm->_Fi);
+    M_FREE_IF_NOT_NULL(oosm->_Q);
+    M_FREE_IF_NOT_NULL(oosm->_Pxv);
+    M_FREE_IF_NOT_NULL(oosm->_T);
+    M_FREE_IF_NOT_NULL(oosm->_U);
+    M_FREE_IF_NOT_NULL(oosm->_G);
+    M_FREE_IF_NOT_NULL(oosm->_Pxz);
+    M_FREE_IF_NOT_NULL(oosm->_S);
+    M_FREE_IF_NOT_NULL(oosm->_R);
+    V_FREE_IF_NOT_NULL(oosm->_x);
+    V_FREE_IF_NOT_NULL(oosm->_a);
+    V_FREE_IF_NOT_NULL(oosm->_d);
+    V_FREE_IF_NOT_NULL(oosm->_e);
+    P_FREE_IF_NOT_NULL(oosm->_perm);
+
+    memset(oosm, 0, sizeof(cfilt_oosm));
+}
+
+void
+cfilt_oosm_reset(cfilt_oosm* oosm)
+{
+    oosm->count = 0;
+}
+
+static double*
+cfilt_oosm_record(const cfilt_oosm* oosm, const size_t t)
+{
+    return oosm->_data + (t % oosm->depth) * oosm->_record;
+}
+
+// Writes the filter's posterior, and prior if asked, over the record of t
+static int
+cfilt_oosm_store(cfilt_oosm* oosm, const cfilt_kalman_filter* filt,
+                 const size_t t, const int prior)
+{
+    const size_t n = oosm->n;
+    double* rec = cfilt_oosm_record(oosm, t);
+
+    const gsl_vector* x;
+    const gsl_matrix* P;
+    cfilt_kalman_filter_posterior(filt, &x, &P);
+
+    memcpy(rec, x->data, n * sizeof(double));
+    EXEC_ASSERT(cfilt_matrix_sym_pack, P, rec + OOSM_P(n));
+
+    if (prior)
+    {
+        memcpy(rec + OOSM_X_(n), filt->x_->data, n * sizeof(double));
+        EXEC_ASSERT(cfilt_matrix_sym_pack, filt->P_, rec + OOSM_P_(n));
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_oosm_push(cfilt_oosm* oosm, const cfilt_kalman_filter* filt)
+{
+    const size_t n = oosm->n;
+    const size_t k = oosm->k;
+    if (filt->x->size != n || filt->u->size != oosm->m || filt->z->size != k)
+    {
+        GSL_ERROR("filter and history dimensions differ", GSL_EBADLEN);
+    }
+
+    const size_t t = oosm->count;
+    double* rec = cfilt_oosm_record(oosm, t);
+    EXEC_ASSERT(cfilt_oosm_store, oosm, filt, t, 1);
+
+    const gsl_vector* x;
+    const gsl_matrix* P;
+    const int updated = cfilt_kalman_filter_posterior(filt, &x, &P);
+    if (updated)
+    {
+        memcpy(rec + OOSM_Z(n), filt->z->data, k * sizeof(double));
+    }
+    else
+    {
+        memset(rec + OOSM_Z(n), 0, k * sizeof(double));
+    }
+
+    rec[OOSM_COUNT(n, k)] = updated ? 1.0 : 0.0;
+    rec[OOSM_STALE(n, k)] = 0.0;
+
+    if (oosm->varying)
+    {
+        gsl_matrix_view F = gsl_matrix_view_array(rec + OOSM_F(n, k), n, n);
+        EXEC_ASSERT(gsl_matrix_memcpy, &F.matrix, filt->F);
+        EXEC_ASSERT(cfilt_matrix_sym_pack, filt->Q, rec + OOSM_Q(n, k));
+        memcpy(rec + OOSM_U(n, k), filt->u->data, oosm->m * sizeof(double));
+    }
+
+    ++oosm->count;
+
+    return GSL_SUCCESS;
+}
+
+// Updates the filter with the measurements of the record, their mean with
+// R / count
+static int
+cfilt_oosm_replay_update(cfilt_oosm* oosm, cfilt_kalman_filter* filt,
+                         const double* rec)
+{
+    const size_t n = oosm->n;
+    const double count = rec[OOSM_COUNT(n, oosm->k)];
+
+    gsl_vector_const_view z = gsl_vector_const_view_array(rec + OOSM_Z(n),
+                                                          oosm->k);
+    EXEC_ASSERT(gsl_vector_memcpy, filt->z, &z.vector);
+    EXEC_ASSERT(gsl_vector_scale, filt->z, 1.0 / count);
+
+    if (count == 1.0)
+    {
+        return cfilt_kalman_filter_update(filt);
+    }
+
+    EXEC_ASSERT(gsl_matrix_memcpy, oosm->_R, filt->R);
+    EXEC_ASSERT(gsl_matrix_scale, filt->R, 1.0 / count);
+    const int status = cfilt_kalman_filter_update(filt);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->R, oosm->_R);
+
+    return status;
+}
+
+static int
+cfilt_oosm_replay_step(cfilt_oosm* oosm, cfilt_kalman_filter* filt,
+                       const size_t t)
+{
+    const size_t n = oosm->n;
+    const size_t k = oosm->k;
+    double* rec = cfilt_oosm_record(oosm, t);
+
+    if (oosm->varying)
+    {
+        gsl_matrix_view F = gsl_matrix_view_array(rec + OOSM_F(n, k), n, n);
+        EXEC_ASSERT(gsl_matrix_memcpy, filt->F, &F.matrix);
+        EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_Q(n, k), filt->Q);
+        memcpy(filt->u->data, rec + OOSM_U(n, k), oosm->m * sizeof(double));
+    }
+
+    EXEC_ASSERT(cfilt_kalman_filter_predict, filt);
+    if (rec[OOSM_COUNT(n, k)] > 0.0)
+    {
+        EXEC_ASSERT(cfilt_oosm_replay_update, oosm, filt, rec);
+    }
+
+    EXEC_ASSERT(cfilt_oosm_store, oosm, filt, t, 1);
+    rec[OOSM_STALE(n, k)] = 0.0;
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_oosm_replay(cfilt_oosm* oosm, cfilt_kalman_filter* filt, const size_t s,
+                  const gsl_vector* z)
+{
+    const size_t n = oosm->n;
+    const size_t k = oosm->k;
+    const size_t t = oosm->count - 1;
+    const size_t oldest = oosm->count - min(oosm->count, oosm->depth);
+
+    // A retrodicted step misses its late measurements, the replay starts
+    // from the last posterior that has them all
+    size_t r = s;
+    while (cfilt_oosm_record(oosm, r)[OOSM_STALE(n, k)] != 0.0)
+    {
+        if (r == oldest)
+        {
+            GSL_ERROR("no step left to rewind to", GSL_EINVAL);
+        }
+
+        --r;
+    }
+
+    // The history only changes once the replay is certain to proceed
+    double* rec = cfilt_oosm_record(oosm, s);
+    gsl_vector_view zsum = gsl_vector_view_array(rec + OOSM_Z(n), k);
+    EXEC_ASSERT(gsl_vector_add, &zsum.vector, z);
+    rec[OOSM_COUNT(n, k)] += 1.0;
+
+    rec = cfilt_oosm_record(oosm, r);
+    gsl_vector_view x = gsl_vector_view_array(rec, n);
+    if (r == s)
+    {
+        // The posterior of s is the prior of its late measurement
+        EXEC_ASSERT(gsl_vector_memcpy, filt->x_, &x.vector);
+        EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_P(n), filt->P_);
+        EXEC_ASSERT(gsl_vector_memcpy, filt->z, z);
+        EXEC_ASSERT(cfilt_kalman_filter_update, filt);
+        EXEC_ASSERT(cfilt_oosm_store, oosm, filt, s, 0);
+
+        gsl_vector_view x_ = gsl_vector_view_array(rec + OOSM_X_(n), n);
+        EXEC_ASSERT(gsl_vector_memcpy, filt->x_, &x_.vector);
+        EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_P_(n), filt->P_);
+    }
+    else
+    {
+        EXEC_ASSERT(gsl_vector_memcpy, filt->x, &x.vector);
+        EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_P(n), filt->P);
+    }
+
+    for (size_t j = r + 1; j <= t; ++j)
+    {
+        EXEC_ASSERT(cfilt_oosm_replay_step, oosm, filt, j);
+    }
+
+    return GSL_SUCCESS;
+}
+
+// Solves SX = B in place of B, S being overwritten by its cholesky factor
+static int
+cfilt_oosm_solve(gsl_matrix* S, gsl_matrix* B)
+{
+    if (cfilt_matrix_cholesky(S) != GSL_SUCCESS)
+    {
+        GSL_ERROR("innovation covariance is not positive definite", GSL_EDOM);
+    }
+
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasLeft, CblasLower, CblasNoTrans,
+                CblasNonUnit, 1.0, S, B);
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasLeft, CblasLower, CblasTrans,
+                CblasNonUnit, 1.0, S, B);
+
+    return GSL_SUCCESS;
+}
+
+// Bar-Shalom's algorithm A1 for a measurement of the previous step
+static int
+cfilt_oosm_retrodict(cfilt_oosm* oosm, cfilt_kalman_filter* filt,
+                     const gsl_vector* z)
+{
+    const size_t n = oosm->n;
+    const size_t k = oosm->k;
+    const size_t t = oosm->count - 1;
+    double* rec = cfilt_oosm_record(oosm, t);
+    const double count = rec[OOSM_COUNT(n, k)];
+
+    gsl_vector_view x = gsl_vector_view_array(rec, n);
+    gsl_vector_view x_ = gsl_vector_view_array(rec + OOSM_X_(n), n);
+    gsl_matrix_view F_rec = gsl_matrix_view_array(rec + OOSM_F(n, k), n, n);
+    const gsl_matrix* F = oosm->varying ? &F_rec.matrix : filt->F;
+    gsl_vector_view u_rec = gsl_vector_view_array(rec + OOSM_U(n, k), oosm->m);
+    const gsl_vector* u = oosm->varying ? &u_rec.vector : filt->u;
+    EXEC_ASSERT(gsl_vector_memcpy, oosm->_x, &x.vector);
+    EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_P(n), oosm->_P);
+    EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_P_(n), oosm->_P_);
+    if (oosm->varying)
+    {
+        EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_Q(n, k), oosm->_Q);
+    }
+    else
+    {
+        EXEC_ASSERT(gsl_matrix_memcpy, oosm->_Q, filt->Q);
+    }
+
+    EXEC_ASSERT(gsl_matrix_memcpy, oosm->_T, F);
+    EXEC_ASSERT(cfilt_matrix_invert, oosm->_T, oosm->_Fi, oosm->_perm);
+
+    gsl_vector_set_zero(oosm->_a);
+    EXEC_ASSERT(gsl_matrix_memcpy, oosm->_U, oosm->_Q);
+    EXEC_ASSERT(gsl_matrix_memcpy, oosm->_Pxv, oosm->_Q);
+    if (count > 0.0)
+    {
+        // S = HP_H^T + R / count and e = z - Hx_ of the step's own update
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, oosm->_P_,
+                    filt->H, 0.0, oosm->_Pxz);
+        EXEC_ASSERT(gsl_matrix_memcpy, oosm->_S, filt->R);
+        EXEC_ASSERT(gsl_matrix_scale, oosm->_S, 1.0 / count);
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->H,
+                    oosm->_Pxz, 1.0, oosm->_S);
+
+        gsl_vector_view zsum = gsl_vector_view_array(rec + OOSM_Z(n), k);
+        EXEC_ASSERT(gsl_vector_memcpy, oosm->_e, &zsum.vector);
+        EXEC_ASSERT(gsl_vector_scale, oosm->_e, 1.0 / count);
+        EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, -1.0, filt->H, &x_.vector,
+                    1.0, oosm->_e);
+
+        // _G = S^-1H and a = QH^TS^-1e
+        EXEC_ASSERT(gsl_matrix_memcpy, oosm->_G, filt->H);
+        EXEC_ASSERT(cfilt_oosm_solve, oosm->_S, oosm->_G);
+        EXEC_ASSERT(gsl_blas_dgemv, CblasTrans, 1.0, oosm->_G, oosm->_e, 0.0,
+                    oosm->_d);
+        EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, oosm->_Q, oosm->_d,
+                    0.0, oosm->_a);
+
+        // Pvv = Q - QH^TS^-1HQ and Pxv = Q - P_H^TS^-1HQ
+        EXEC_ASSERT(gsl_blas_dgemm, CblasTrans, CblasNoTrans, 1.0, filt->H,
+                    oosm->_G, 0.0, oosm->_T);
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, oosm->_T,
+                    oosm->_Q, 0.0, oosm->_P_);
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, -1.0, oosm->_Q,
+                    oosm->_P_, 1.0, oosm->_U);
+        EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + OOSM_P_(n), oosm->_T);
+        EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, -1.0, oosm->_T,
+                    oosm->_P_, 1.0, oosm->_Pxv);
+    }
+
+    // xd = F^-1(x - Bu - a)
+    EXEC_ASSERT(gsl_vector_memcpy, oosm->_d, oosm->_x);
+    EXEC_ASSERT(gsl_vector_sub, oosm->_d, oosm->_a);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, -1.0, filt->B, u, 1.0, oosm->_d);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, oosm->_Fi, oosm->_d, 0.0,
+                oosm->_a);
+
+    // Pd = F^-1(P + Pvv - Pxv - Pxv^T)F^-T
+    EXEC_ASSERT(gsl_matrix_add, oosm->_U, oosm->_P);
+    EXEC_ASSERT(gsl_matrix_sub, oosm->_U, oosm->_Pxv);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, oosm->_T, oosm->_Pxv);
+    EXEC_ASSERT(gsl_matrix_sub, oosm->_U, oosm->_T);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, oosm->_Fi,
+                oosm->_U, 0.0, oosm->_T);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, oosm->_T,
+                oosm->_Fi, 0.0, oosm->_U);
+
+    // Pxz = (P - Pxv)F^-TH^T
+    EXEC_ASSERT(gsl_matrix_memcpy, oosm->_T, oosm->_P);
+    EXEC_ASSERT(gsl_matrix_sub, oosm->_T, oosm->_Pxv);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, oosm->_T,
+                oosm->_Fi, 0.0, oosm->_Pxv);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, oosm->_Pxv,
+                filt->H, 0.0, oosm->_Pxz);
+
+    // Sd = HPdH^T + R and e = z - Hxd
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, filt->H,
+                oosm->_U, 0.0, oosm->_G);
+    EXEC_ASSERT(gsl_matrix_memcpy, oosm->_S, filt->R);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, oosm->_G,
+                filt->H, 1.0, oosm->_S);
+    EXEC_ASSERT(gsl_vector_memcpy, oosm->_e, z);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, -1.0, filt->H, oosm->_a, 1.0,
+                oosm->_e);
+
+    // x += PxzSd^-1e and P -= PxzSd^-1Pxz^T
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, oosm->_G, oosm->_Pxz);
+    EXEC_ASSERT(cfilt_oosm_solve, oosm->_S, oosm->_G);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasTrans, 1.0, oosm->_G, oosm->_e, 1.0,
+                oosm->_x);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, -1.0, oosm->_Pxz,
+                oosm->_G, 1.0, oosm->_P);
+    EXEC_ASSERT(cfilt_matrix_symmetrize, oosm->_P, 0);
+
+    EXEC_ASSERT(cfilt_kalman_filter_set_posterior, filt, oosm->_x, oosm->_P);
+    EXEC_ASSERT(gsl_vector_memcpy, &x.vector, oosm->_x);
+    EXEC_ASSERT(cfilt_matrix_sym_pack, oosm->_P, rec + OOSM_P(n));
+
+    // The previous step keeps the measurement for later replays
+    rec = cfilt_oosm_record(oosm, t - 1);
+    gsl_vector_view zsum = gsl_vector_view_array(rec + OOSM_Z(n), k);
+    EXEC_ASSERT(gsl_vector_add, &zsum.vector, z);
+    rec[OOSM_COUNT(n, k)] += 1.0;
+    rec[OOSM_STALE(n, k)] = 1.0;
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_oosm_update(cfilt_oosm* oosm, cfilt_kalman_filter* filt,
+                  const size_t lag, const gsl_vector* z)
+{
+    if (z->size != oosm->k)
+    {
+        GSL_ERROR("measurement and history dimensions differ", GSL_EBADLEN);
+    }
+
+    if (lag >= min(oosm->count, oosm->depth))
+    {
+        GSL_ERROR("measurement is older than the history", GSL_EINVAL);
+    }
+
+    if (filt->steady_state || filt->freeze_window > 0)
+    {
+        GSL_ERROR("filter gain must not be frozen", GSL_EINVAL);
+    }
+
+    const size_t t = oosm->count - 1;
+    const size_t n = oosm->n;
+    if (oosm->mode == CFILT_OOSM_RETRODICT && lag == 1 &&
+        cfilt_oosm_record(oosm, t - 1)[OOSM_STALE(n, oosm->k)] == 0.0)
+    {
+        return cfilt_oosm_retrodict(oosm, filt, z);
+    }
+
+    return cfilt_oosm_replay(oosm, filt, t - lag, z);
+}
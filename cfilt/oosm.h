@@ -0,0 +1,135 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_OOSM_H_
+#define CFILT_OOSM_H_
+
+#include "cfilt/allocator.h"
+#include "cfilt/kalman.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_permutation.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Out of sequence measurements for a cfilt_kalman_filter.
+ *
+ * cfilt_oosm_push is called after each predict (and update, when there is a
+ * measurement) and keeps the last depth steps in a ring of records of
+ *
+ *   x, P, x_, P_, the sum and count of the step's measurements and, with
+ *   varying, the F, Q and u that predicted the step
+ *
+ * with P, P_ and Q packed (see cfilt_matrix_sym_pack). H and R are the
+ * filter's and are the same for every step. Several measurements of a step
+ * are replayed as their mean with R / count, which is the same update.
+ *
+ * cfilt_oosm_update applies z, measured lag steps ago, to the filter:
+ *
+ *   - REPLAY rewinds to the step, updates its posterior with z and replays
+ *     the following steps, predicting only when a step had no measurement.
+ *     The filter and the records of the replayed steps end up as if z had
+ *     arrived in sequence.
+ *   - RETRODICT, for lag = 1, updates the current posterior directly with
+ *     z against the estimate retrodicted from it (Bar-Shalom's algorithm
+ *     A1), using the step's F and Q. F must be invertible. The posterior of
+ *     the previous step is left behind, a later replay through it starts
+ *     one step earlier. Other lags are replayed.
+ *
+ * During a replay, the filter's z is used as scratch space and, without
+ * varying, its F, Q and u are assumed to be those of every step. The filter
+ * must not be in steady state nor freeze its gain. Nothing is allocated by
+ * push and update.
+ *
+ * push   : O(n^2)
+ * update : O(lag * kalman step) replayed, O(n^3 + n^2k + k^3) retrodicted
+ */
+
+typedef enum
+{
+    CFILT_OOSM_REPLAY = 0,
+    CFILT_OOSM_RETRODICT
+} cfilt_oosm_mode;
+
+typedef struct
+{
+    size_t n;
+    size_t m;
+    size_t k;
+    size_t depth;
+    size_t count; // Steps pushed
+    int varying;
+    cfilt_oosm_mode mode;
+
+    // Ring of depth records, _record doubles each
+    double* _data;
+    size_t _record;
+
+    // Replay and retrodiction scratch space
+    gsl_matrix* _P;
+    gsl_matrix* _P_;
+    gsl_matrix* _Fi;
+    gsl_matrix* _Q;
+    gsl_matrix* _Pxv;
+    gsl_matrix* _T;
+    gsl_matrix* _U;
+    gsl_matrix* _G;
+    gsl_matrix* _Pxz;
+    gsl_matrix* _S;
+    gsl_matrix* _R;
+    gsl_vector* _x;
+    gsl_vector* _a;
+    gsl_vector* _d;
+    gsl_vector* _e;
+    gsl_permutation* _perm;
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_oosm;
+
+int cfilt_oosm_alloc(cfilt_oosm* oosm, const size_t n, const size_t m,
+                     const size_t k, const size_t depth, const int varying);
+
+int cfilt_oosm_alloc_from(cfilt_oosm* oosm, cfilt_allocator* allocator,
+                          const size_t n, const size_t m, const size_t k,
+                          const size_t depth, const int varying);
+
+void cfilt_oosm_free(cfilt_oosm* oosm);
+
+// Forgets every step
+void cfilt_oosm_reset(cfilt_oosm* oosm);
+
+int cfilt_oosm_push(cfilt_oosm* oosm, const cfilt_kalman_filter* filt);
+
+// Fails with GSL_EINVAL when lag reaches past the oldest step held
+int cfilt_oosm_update(cfilt_oosm* oosm, cfilt_kalman_filter* filt,
+                      const size_t lag, const gsl_vector* z);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_OOSM_H_
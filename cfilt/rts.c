@@ -0,0 +1,314 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/rts.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Offsets of a record's fields in doubles, x being first
+#define RTS_P(n) (n)
+#define RTS_X_(n) ((n) + (n) * ((n) + 1) / 2)
+#define RTS_P_(n) (2 * (n) + (n) * ((n) + 1) / 2)
+#define RTS_F(n) (2 * (n) + (n) * ((n) + 1))
+
+int
+cfilt_rts_alloc(cfilt_rts* rts, const size_t n, const size_t capacity,
+                const int varying_F, const char* path)
+{
+    return cfilt_rts_alloc_from(rts, NULL, n, capacity, varying_F, path);
+}
+
+static int
+cfilt_rts_map(cfilt_rts* rts, const char* path)
+{
+    rts->_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (rts->_fd < 0)
+    {
+        GSL_ERROR("failed to open the smoother history", GSL_EFAILED);
+    }
+
+    if (ftruncate(rts->_fd, rts->_size) != 0)
+    {
+        GSL_ERROR("failed to size the smoother history", GSL_EFAILED);
+    }
+
+    void* data = mmap(NULL, rts->_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      rts->_fd, 0);
+    if (data == MAP_FAILED)
+    {
+        GSL_ERROR("failed to map the smoother history", GSL_EFAILED);
+    }
+
+    // The filter pass appends in order, see cfilt_rts_smooth for the other
+    madvise(data, rts->_size, MADV_SEQUENTIAL);
+    rts->_data = data;
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_rts_alloc_from(cfilt_rts* rts, cfilt_allocator* allocator,
+                     const size_t n, const size_t capacity,
+                     const int varying_F, const char* path)
+{
+    if (n * capacity == 0)
+    {
+        GSL_ERROR("n and capacity must be non zero positive integers",
+                  GSL_EINVAL);
+    }
+
+    memset(rts, 0, sizeof(cfilt_rts));
+    rts->_allocator = allocator ? allocator : cfilt_allocator_get();
+    rts->_fd = -1;
+    rts->n = n;
+    rts->capacity = capacity;
+    rts->varying_F = varying_F;
+    rts->_record = RTS_F(n) + (varying_F ? n * n : 0);
+    rts->_size = capacity * rts->_record * sizeof(double);
+
+    if (path)
+    {
+        const int status = cfilt_rts_map(rts, path);
+        if (status != GSL_SUCCESS)
+        {
+            cfilt_rts_free(rts);
+            return status;
+        }
+    }
+    else
+    {
+        rts->_data = cfilt_alloc(rts->_allocator, rts->_size, CFILT_ALIGN);
+        if (rts->_data == NULL)
+        {
+            GSL_ERROR("failed to allocate space for smoother history",
+                      GSL_ENOMEM);
+        }
+    }
+
+    M_ALLOC_ASSERT_FROM(rts->_allocator, rts->F, n, n, cfilt_rts_free, rts);
+    M_ALLOC_ASSERT_FROM(rts->_allocator, rts->_P, n, n, cfilt_rts_free, rts);
+    M_ALLOC_ASSERT_FROM(rts->_allocator, rts->_P_next, n, n, cfilt_rts_free,
+                        rts);
+    M_ALLOC_ASSERT_FROM(rts->_allocator, rts->_Ps, n, n, cfilt_rts_free, rts);
+    M_ALLOC_ASSERT_FROM(rts->_allocator, rts->_C, n, n, cfilt_rts_free, rts);
+    M_ALLOC_ASSERT_FROM(rts->_allocator, rts->_FP, n, n, cfilt_rts_free, rts);
+    V_ALLOC_ASSERT_FROM(rts->_allocator, rts->_xs, n, cfilt_rts_free, rts);
+    V_ALLOC_ASSERT_FROM(rts->_allocator, rts->_d, n, cfilt_rts_free, rts);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_rts_free(cfilt_rts* rts)
+{
+    if (rts->_fd >= 0)
+    {
+        if (rts->_data)
+        {
+            munmap(rts->_data, rts->_size);
+        }
+
+        close(rts->_fd);
+    }
+    else if (rts->_data)
+    {
+        cfilt_free(rts->_allocator, rts->_data);
+    }
+
+    M_FREE_IF_NOT_NULL(rts->F);
+    M_FREE_IF_NOT_NULL(rts->_P);
+    M_FREE_IF_NOT_NULL(rts->_P_next);
+    M_FREE_IF_NOT_NULL(rts->_Ps);
+    M_FREE_IF_NOT_NULL(rts->_C);
+    M_FREE_IF_NOT_NULL(rts->_FP);
+    V_FREE_IF_NOT_NULL(rts->_xs);
+    V_FREE_IF_NOT_NULL(rts->_d);
+
+    memset(rts, 0, sizeof(cfilt_rts));
+    rts->_fd = -1;
+}
+
+void
+cfilt_rts_reset(cfilt_rts* rts)
+{
+    if (rts->_fd >= 0)
+    {
+        madvise(rts->_data, rts->_size, MADV_SEQUENTIAL);
+    }
+
+    rts->count = 0;
+    rts->smoothed = 0;
+}
+
+int
+cfilt_rts_record(cfilt_rts* rts, const cfilt_kalman_filter* filt)
+{
+    const size_t n = rts->n;
+    if (filt->x->size != n)
+    {
+        GSL_ERROR("filter and smoother dimensions differ", GSL_EBADLEN);
+    }
+
+    if (rts->count == rts->capacity)
+    {
+        GSL_ERROR("smoother history is full", GSL_EBADLEN);
+    }
+
+    double* rec = rts->_data + rts->count * rts->_record;
+
+    const gsl_vector* x;
+    const gsl_matrix* P;
+    cfilt_kalman_filter_posterior(filt, &x, &P);
+
+    memcpy(rec, x->data, n * sizeof(double));
+    memcpy(rec + RTS_X_(n), filt->x_->data, n * sizeof(double));
+    EXEC_ASSERT(cfilt_matrix_sym_pack, P, rec + RTS_P(n));
+    EXEC_ASSERT(cfilt_matrix_sym_pack, filt->P_, rec + RTS_P_(n));
+
+    if (rts->varying_F)
+    {
+        memcpy(rec + RTS_F(n), filt->F->data, n * n * sizeof(double));
+    }
+    else if (rts->count == 0)
+    {
+        EXEC_ASSERT(gsl_matrix_memcpy, rts->F, filt->F);
+    }
+
+    ++rts->count;
+    rts->smoothed = 0;
+
+    return GSL_SUCCESS;
+}
+
+// One backward step from the smoothed estimate of step t + 1 in _xs and _Ps
+// to the one of step t, written over its record
+static int
+cfilt_rts_smooth_step(cfilt_rts* rts, const size_t t)
+{
+    const size_t n = rts->n;
+    double* rec = rts->_data + t * rts->_record;
+    double* next = rec + rts->_record;
+
+    gsl_vector_view x = gsl_vector_view_array(rec, n);
+    gsl_vector_view x_next = gsl_vector_view_array(next + RTS_X_(n), n);
+    gsl_matrix_const_view F_next =
+      gsl_matrix_const_view_array(next + RTS_F(n), n, n);
+    const gsl_matrix* F = rts->varying_F ? &F_next.matrix : rts->F;
+
+    EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + RTS_P(n), rts->_P);
+    EXEC_ASSERT(cfilt_matrix_sym_unpack, next + RTS_P_(n), rts->_P_next);
+
+    // C^T solves P_t+1_ C^T = FP_t
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, F, rts->_P,
+                0.0, rts->_FP);
+
+    // _Ps = Ps_t+1 - P_t+1_ before P_t+1_ is factored
+    EXEC_ASSERT(gsl_matrix_sub, rts->_Ps, rts->_P_next);
+
+    if (cfilt_matrix_cholesky(rts->_P_next) != GSL_SUCCESS)
+    {
+        GSL_ERROR("predicted covariance is not positive definite", GSL_EDOM);
+    }
+
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasLeft, CblasLower, CblasNoTrans,
+                CblasNonUnit, 1.0, rts->_P_next, rts->_FP);
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasLeft, CblasLower, CblasTrans,
+                CblasNonUnit, 1.0, rts->_P_next, rts->_FP);
+
+    // xs_t = x_t + C(xs_t+1 - x_t+1_)
+    EXEC_ASSERT(gsl_vector_memcpy, rts->_d, rts->_xs);
+    EXEC_ASSERT(gsl_vector_sub, rts->_d, &x_next.vector);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasTrans, 1.0, rts->_FP, rts->_d, 1.0,
+                &x.vector);
+
+    // Ps_t = P_t + C(Ps_t+1 - P_t+1_)C^T
+    EXEC_ASSERT(gsl_blas_dgemm, CblasTrans, CblasNoTrans, 1.0, rts->_FP,
+                rts->_Ps, 0.0, rts->_C);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasNoTrans, 1.0, rts->_C,
+                rts->_FP, 1.0, rts->_P);
+
+    EXEC_ASSERT(cfilt_matrix_sym_pack, rts->_P, rec + RTS_P(n));
+    EXEC_ASSERT(gsl_vector_memcpy, rts->_xs, &x.vector);
+    EXEC_ASSERT(cfilt_matrix_symmetrize, rts->_P, 0);
+    EXEC_ASSERT(gsl_matrix_memcpy, rts->_Ps, rts->_P);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_rts_smooth(cfilt_rts* rts)
+{
+    if (rts->smoothed || rts->count == 0)
+    {
+        return GSL_SUCCESS;
+    }
+
+    // Sequential read ahead goes forward and drops the pages behind, the
+    // backward pass needs neither
+    if (rts->_fd >= 0)
+    {
+        madvise(rts->_data, rts->_size, MADV_RANDOM);
+    }
+
+    // The last filtered estimate is already smoothed
+    const size_t last = rts->count - 1;
+    EXEC_ASSERT(cfilt_rts_get, rts, last, rts->_xs, rts->_Ps);
+
+    for (size_t t = last; t-- > 0;)
+    {
+        EXEC_ASSERT(cfilt_rts_smooth_step, rts, t);
+    }
+
+    rts->smoothed = 1;
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_rts_get(const cfilt_rts* rts, const size_t t, gsl_vector* x,
+              gsl_matrix* P)
+{
+    const size_t n = rts->n;
+    if (t >= rts->count)
+    {
+        GSL_ERROR("no such step in the smoother history", GSL_EINVAL);
+    }
+
+    const double* rec = rts->_data + t * rts->_record;
+    if (x)
+    {
+        gsl_vector_const_view x_view =
+          gsl_vector_const_view_array(rec, n);
+        EXEC_ASSERT(gsl_vector_memcpy, x, &x_view.vector);
+    }
+
+    if (P)
+    {
+        EXEC_ASSERT(cfilt_matrix_sym_unpack, rec + RTS_P(n), P);
+    }
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_RTS_H_
+#define CFILT_RTS_H_
+
+#include "cfilt/allocator.h"
+#include "cfilt/kalman.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Rauch-Tung-Striebel fixed interval smoother over a cfilt_kalman_filter run.
+ *
+ * The forward pass is the filter itself. cfilt_rts_record is called after
+ * each predict (and update, when there is a measurement) and appends the step
+ * to a history of at most capacity records of
+ *
+ *   x, P, x_, P_ and, with varying_F, the F that predicted the step
+ *
+ * P and P_ are packed lower triangles (see cfilt_matrix_sym_pack) so a record
+ * holds 2n + n(n + 1) doubles, n^2 more with varying_F. Without varying_F,
+ * every step shares F, copied from the filter by the first record. A step
+ * without update records x_ and P_ as its posterior.
+ *
+ * cfilt_rts_smooth then runs backward from the last record,
+ *
+ *   C_t  = P_tF^T(P_t+1_)^-1
+ *   xs_t = x_t + C_t(xs_t+1 - x_t+1_)
+ *   Ps_t = P_t + C_t(Ps_t+1 - P_t+1_)C_t^T
+ *
+ * with a cholesky solve instead of the inverse, overwriting each record's x
+ * and P with the smoothed ones. cfilt_rts_get reads a record back.
+ *
+ * With a path, the history is a file mapped in memory instead of an
+ * allocation, so that runs larger than memory are paged in and out by the
+ * system. Both passes walk it sequentially. The file is kept on free.
+ * Nothing is allocated by record and smooth.
+ *
+ * record : O(n^2)
+ * smooth : O(count * n^3)
+ */
+
+typedef struct
+{
+    size_t n;
+    size_t capacity;
+    size_t count;
+    int varying_F;
+    int smoothed;
+
+    gsl_matrix* F;
+
+    // History, _record doubles per step
+    double* _data;
+    size_t _record;
+    size_t _size;
+    int _fd; // -1 unless the history is mapped
+
+    // Backward pass scratch space
+    gsl_matrix* _P;
+    gsl_matrix* _P_next;
+    gsl_matrix* _Ps;
+    gsl_matrix* _C;
+    gsl_matrix* _FP;
+    gsl_vector* _xs;
+    gsl_vector* _d;
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_rts;
+
+// path may be NULL for a history in memory
+int cfilt_rts_alloc(cfilt_rts* rts, const size_t n, const size_t capacity,
+                    const int varying_F, const char* path);
+
+int cfilt_rts_alloc_from(cfilt_rts* rts, cfilt_allocator* allocator,
+                         const size_t n, const size_t capacity,
+                         const int varying_F, const char* path);
+
+void cfilt_rts_free(cfilt_rts* rts);
+
+// Forgets every record
+void cfilt_rts_reset(cfilt_rts* rts);
+
+// Fails with GSL_EBADLEN once capacity records are held
+int cfilt_rts_record(cfilt_rts* rts, const cfilt_kalman_filter* filt);
+
+int cfilt_rts_smooth(cfilt_rts* rts);
+
+// x and P of step t, smoothed after cfilt_rts_smooth. Either may be NULL.
+int cfilt_rts_get(const cfilt_rts* rts, const size_t t, gsl_vector* x,
+                  gsl_matrix* P);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_RTS_H_
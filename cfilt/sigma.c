@@ -59,13 +59,16 @@ cfilt_sigma_generator_van_der_merwe_alloc(
   cfilt_sigma_generator_van_der_merwe** gen, const size_t n, const double alpha,
   const double beta, const double kappa)
 {
-    *gen = malloc(sizeof(cfilt_sigma_generator_van_der_merwe));
+    cfilt_allocator* allocator = cfilt_allocator_get();
+    *gen = cfilt_alloc(allocator, sizeof(cfilt_sigma_generator_van_der_merwe),
+                       CFILT_ALIGN);
     if (*gen == NULL)
     {
         return GSL_ENOMEM;
     }
 
     cfilt_sigma_generator_van_der_merwe vdm;
+    vdm._common._allocator = allocator;
     vdm._common.type = CFILT_SIGMA_VAN_DER_MERWE;
     vdm._common.n = n;
 
@@ -192,7 +195,7 @@ cfilt_sigma_generator_free(cfilt_sigma_generator* gen)
             break;
     }
 
-    free(gen);
+    cfilt_free(gen->_allocator, gen);
 }
 
 int
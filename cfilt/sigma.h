@@ -22,6 +22,8 @@
 
 #include <sys/types.h>
 
+#include "cfilt/allocator.h"
+
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_vector.h>
 
@@ -39,6 +41,8 @@ typedef struct
     gsl_matrix* points;
     gsl_vector* mu_weights;
     gsl_vector* sigma_weights;
+
+    cfilt_allocator* _allocator;
 } cfilt_sigma_generator_common_;
 
 typedef cfilt_sigma_generator_common_ cfilt_sigma_generator;
@@ -0,0 +1,203 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/srkf.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <string.h>
+
+#define V_ALLOC_ASSERT_(p, n)                                                  \
+    V_ALLOC_ASSERT_FROM(filt->_allocator, p, n, cfilt_srkf_free, filt)
+#define M_ALLOC_ASSERT_(p, n, m)                                               \
+    M_ALLOC_ASSERT_FROM(filt->_allocator, p, n, m, cfilt_srkf_free, filt)
+
+int
+cfilt_srkf_alloc(cfilt_srkf* filt, const size_t n, const size_t m,
+                 const size_t k)
+{
+    return cfilt_srkf_alloc_from(filt, NULL, n, m, k);
+}
+
+int
+cfilt_srkf_alloc_from(cfilt_srkf* filt, cfilt_allocator* allocator,
+                      const size_t n, const size_t m, const size_t k)
+{
+    if (n * m * k == 0 || n == 1)
+    {
+        GSL_ERROR("n m and k must be non zero positive integers and n must be "
+                  "greater than 1",
+                  GSL_EINVAL);
+    }
+
+    memset(filt, 0, sizeof(cfilt_srkf));
+    filt->_allocator = allocator ? allocator : cfilt_allocator_get();
+
+    M_ALLOC_ASSERT_(filt->F, n, n);
+    M_ALLOC_ASSERT_(filt->B, n, m);
+    M_ALLOC_ASSERT_(filt->Q, n, n);
+    M_ALLOC_ASSERT_(filt->S, n, n);
+    M_ALLOC_ASSERT_(filt->S_, n, n);
+    M_ALLOC_ASSERT_(filt->H, k, n);
+    M_ALLOC_ASSERT_(filt->R, k, k);
+    M_ALLOC_ASSERT_(filt->K, n, k);
+
+    V_ALLOC_ASSERT_(filt->x, n);
+    V_ALLOC_ASSERT_(filt->x_, n);
+    V_ALLOC_ASSERT_(filt->z, k);
+    V_ALLOC_ASSERT_(filt->u, m);
+    V_ALLOC_ASSERT_(filt->y, k);
+
+    M_ALLOC_ASSERT_(filt->_FS, n, n);
+    M_ALLOC_ASSERT_(filt->_HS, k, n);
+    M_ALLOC_ASSERT_(filt->_pre_predict, 2 * n, n);
+    M_ALLOC_ASSERT_(filt->_pre_update, k + n, k + n);
+    V_ALLOC_ASSERT_(filt->_tau_predict, n);
+    V_ALLOC_ASSERT_(filt->_tau_update, k + n);
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_srkf_free(cfilt_srkf* filt)
+{
+    M_FREE_IF_NOT_NULL(filt->F);
+    M_FREE_IF_NOT_NULL(filt->B);
+    M_FREE_IF_NOT_NULL(filt->Q);
+    M_FREE_IF_NOT_NULL(filt->S);
+    M_FREE_IF_NOT_NULL(filt->S_);
+    M_FREE_IF_NOT_NULL(filt->H);
+    M_FREE_IF_NOT_NULL(filt->R);
+    M_FREE_IF_NOT_NULL(filt->K);
+
+    V_FREE_IF_NOT_NULL(filt->x);
+    V_FREE_IF_NOT_NULL(filt->x_);
+    V_FREE_IF_NOT_NULL(filt->z);
+    V_FREE_IF_NOT_NULL(filt->u);
+    V_FREE_IF_NOT_NULL(filt->y);
+
+    M_FREE_IF_NOT_NULL(filt->_FS);
+    M_FREE_IF_NOT_NULL(filt->_HS);
+    M_FREE_IF_NOT_NULL(filt->_pre_predict);
+    M_FREE_IF_NOT_NULL(filt->_pre_update);
+    V_FREE_IF_NOT_NULL(filt->_tau_predict);
+    V_FREE_IF_NOT_NULL(filt->_tau_update);
+}
+
+// Copies the transpose of R (upper triangle of a QR decomposition) into the
+// lower triangular factor dst. Columns are negated where needed so that the
+// factor has a positive diagonal, which leaves dst * dst^T unchanged.
+static int
+cfilt_srkf_factor_from_qr(const gsl_matrix* qr, gsl_matrix* dst)
+{
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, dst, qr);
+    EXEC_ASSERT(cfilt_matrix_tri_zero, dst, 1);
+
+    for (size_t j = 0; j < dst->size2; ++j)
+    {
+        if (gsl_matrix_get(dst, j, j) < 0.0)
+        {
+            gsl_vector_view col = gsl_matrix_column(dst, j);
+            EXEC_ASSERT(gsl_vector_scale, &col.vector, -1.0);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_srkf_predict(cfilt_srkf* filt)
+{
+    const size_t n = filt->S->size1;
+
+    // x_ = Fx + Bu
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->F, filt->x, 0.0,
+                filt->x_);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->B, filt->u, 1.0,
+                filt->x_);
+
+    // P_ = FSS^TF^T + QQ^T is the gram matrix of the pre-array [FS Q]^T so
+    // S_ is the transpose of its R factor
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_FS, filt->F);
+    EXEC_ASSERT(gsl_blas_dtrmm, CblasRight, CblasLower, CblasNoTrans,
+                CblasNonUnit, 1.0, filt->S, filt->_FS);
+
+    gsl_matrix_view top = gsl_matrix_submatrix(filt->_pre_predict, 0, 0, n, n);
+    gsl_matrix_view bottom =
+      gsl_matrix_submatrix(filt->_pre_predict, n, 0, n, n);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, &top.matrix, filt->_FS);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, &bottom.matrix, filt->Q);
+
+    EXEC_ASSERT(gsl_linalg_QR_decomp, filt->_pre_predict, filt->_tau_predict);
+    EXEC_ASSERT(cfilt_srkf_factor_from_qr, &top.matrix, filt->S_);
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_srkf_update(cfilt_srkf* filt)
+{
+    const size_t n = filt->S->size1;
+    const size_t k = filt->R->size1;
+
+    // Pre-array     QR       Post-array
+    // | R^T      0   |  ->  | X  Y |
+    // | (HS_)^T  S_^T|      | 0  Z |
+    // where X^TX = HP_H^T + R, Y = X^-T HP_ and Z^TZ = P_ - Y^TY = P
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->_HS, filt->H);
+    EXEC_ASSERT(gsl_blas_dtrmm, CblasRight, CblasLower, CblasNoTrans,
+                CblasNonUnit, 1.0, filt->S_, filt->_HS);
+
+    gsl_matrix_view X = gsl_matrix_submatrix(filt->_pre_update, 0, 0, k, k);
+    gsl_matrix_view Y = gsl_matrix_submatrix(filt->_pre_update, 0, k, k, n);
+    gsl_matrix_view HS_T = gsl_matrix_submatrix(filt->_pre_update, k, 0, n, k);
+    gsl_matrix_view Z = gsl_matrix_submatrix(filt->_pre_update, k, k, n, n);
+
+    gsl_matrix_set_zero(&Y.matrix);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, &X.matrix, filt->R);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, &HS_T.matrix, filt->_HS);
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, &Z.matrix, filt->S_);
+
+    EXEC_ASSERT(gsl_linalg_QR_decomp, filt->_pre_update, filt->_tau_update);
+
+    // K = P_H^T(X^TX)^-1 = Y^TX^-T
+    EXEC_ASSERT(gsl_matrix_transpose_memcpy, filt->K, &Y.matrix);
+    EXEC_ASSERT(gsl_blas_dtrsm, CblasRight, CblasUpper, CblasTrans,
+                CblasNonUnit, 1.0, &X.matrix, filt->K);
+
+    // y = z - Hx_
+    EXEC_ASSERT(gsl_vector_memcpy, filt->y, filt->z);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, -1.0, filt->H, filt->x_, 1.0,
+                filt->y);
+
+    // x = x_ + Ky
+    EXEC_ASSERT(gsl_vector_memcpy, filt->x, filt->x_);
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->K, filt->y, 1.0,
+                filt->x);
+
+    // S = Z^T
+    EXEC_ASSERT(cfilt_srkf_factor_from_qr, &Z.matrix, filt->S);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRKF_H_
+#define SRKF_H_
+
+#include "cfilt/allocator.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Square root form of the linear Kalman filter. Covariances are never formed,
+ * their lower triangular cholesky factors are propagated instead with QR
+ * decompositions, which keeps them positive definite by construction.
+ *
+ * n            : Number of variables tracked
+ * m            : Number of control inputs
+ * k            : Number of measurement variables
+ *
+ * F (n x n)    : State transition matrix
+ * B (n x m)    : Control matrix
+ * Q (n x n)    : Lower cholesky factor of the process covariance (noise)
+ * S (n x n)    : Lower cholesky factor of the state covariance (P = SS^T)
+ * S_(n x n)    : Lower cholesky factor of the state estimate covariance
+ * K (n x k)    : Kalman gain matrix
+ *
+ * H (k x n)    : Measurement matrix
+ * R (k x k)    : Lower cholesky factor of the measurement covariance (noise)
+ *
+ * x (n x 1)    : State vector
+ * x_(n x 1)    : State estimate vector
+ * z (k x 1)    : Measurement vector
+ * u (m x 1)    : Control input vector
+ * y (k x 1)    : Residual vector
+ */
+
+typedef struct
+{
+    gsl_vector* x;
+    gsl_vector* x_;
+    gsl_vector* z;
+    gsl_vector* u;
+    gsl_vector* y;
+
+    gsl_matrix* F;
+    gsl_matrix* B;
+    gsl_matrix* Q;
+    gsl_matrix* S;
+    gsl_matrix* S_;
+    gsl_matrix* H;
+    gsl_matrix* R;
+    gsl_matrix* K;
+
+    // Intermediary results
+    gsl_matrix* _FS;
+    gsl_matrix* _HS;
+    gsl_matrix* _pre_predict;
+    gsl_matrix* _pre_update;
+    gsl_vector* _tau_predict;
+    gsl_vector* _tau_update;
+
+    cfilt_allocator* _allocator;
+
+} cfilt_srkf;
+
+int cfilt_srkf_alloc(cfilt_srkf* filt, const size_t n, const size_t m,
+                     const size_t k);
+
+int cfilt_srkf_alloc_from(cfilt_srkf* filt, cfilt_allocator* allocator,
+                          const size_t n, const size_t m, const size_t k);
+
+void cfilt_srkf_free(cfilt_srkf* filt);
+
+int cfilt_srkf_predict(cfilt_srkf* filt);
+
+int cfilt_srkf_update(cfilt_srkf* filt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SRKF_H_
@@ -0,0 +1,814 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/tracker.h"
+#include "cfilt/util.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+
+#include <string.h>
+
+int
+cfilt_tracker_alloc(cfilt_tracker* tr, const size_t n, const size_t m,
+                    const size_t k, const size_t capacity,
+                    const size_t max_detections)
+{
+    return cfilt_tracker_alloc_from(tr, NULL, n, m, k, capacity,
+                                    max_detections);
+}
+
+int
+cfilt_tracker_alloc_from(cfilt_tracker* tr, cfilt_allocator* allocator,
+                         const size_t n, const size_t m, const size_t k,
+                         const size_t capacity, const size_t max_detections)
+{
+    if (capacity * max_detections == 0)
+    {
+        GSL_ERROR("capacity and max_detections must be non zero positive "
+                  "integers",
+                  GSL_EINVAL);
+    }
+
+    memset(tr, 0, sizeof(cfilt_tracker));
+    tr->_allocator = allocator ? allocator : cfilt_allocator_get();
+    tr->capacity = capacity;
+    tr->max_detections = max_detections;
+    tr->gate = 9.21;
+    tr->max_misses = 3;
+    tr->pd = 0.9;
+    tr->clutter = 1e-3;
+    tr->prune = 1e-4;
+    tr->max_events = 4096;
+
+    EXEC_ASSERT(cfilt_kalman_filter_alloc_from, &tr->model, tr->_allocator, n,
+                m, k);
+
+    // Hungarian scratch is indexed from 1 on the largest side
+    const size_t dim = max(capacity, max_detections) + 1;
+    const size_t stride = max_detections + 1;
+    const size_t sizes[] = {
+        CFILT_ALIGN_UP(capacity * sizeof(cfilt_track)),
+        CFILT_ALIGN_UP(capacity * sizeof(size_t)),
+        CFILT_ALIGN_UP(capacity * sizeof(size_t)),
+        CFILT_ALIGN_UP(capacity * sizeof(gsl_vector*)),
+        CFILT_ALIGN_UP(capacity * sizeof(gsl_matrix*)),
+        CFILT_ALIGN_UP(max_detections * sizeof(size_t)),
+        CFILT_ALIGN_UP(3 * dim * sizeof(double)),
+        CFILT_ALIGN_UP(2 * dim * sizeof(size_t)),
+        CFILT_ALIGN_UP(dim),
+        CFILT_ALIGN_UP((capacity + max_detections) * sizeof(size_t)),
+        CFILT_ALIGN_UP((5 * capacity + 1) * sizeof(size_t)),
+        CFILT_ALIGN_UP(capacity * stride * sizeof(size_t)),
+        CFILT_ALIGN_UP(2 * capacity * stride * sizeof(double)),
+        CFILT_ALIGN_UP(max_detections),
+    };
+
+    size_t size = 0;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        size += sizes[i];
+    }
+
+    tr->_ptr = cfilt_alloc(tr->_allocator, size, CFILT_ALIGN);
+    if (tr->_ptr == NULL)
+    {
+        cfilt_tracker_free(tr);
+        GSL_ERROR("failed to allocate space for tracker", GSL_ENOMEM);
+    }
+
+    memset(tr->_ptr, 0, size);
+
+    char* ptr = tr->_ptr;
+    tr->tracks = (cfilt_track*)ptr, ptr += sizes[0];
+    tr->active = (size_t*)ptr, ptr += sizes[1];
+    tr->_free = (size_t*)ptr, ptr += sizes[2];
+    tr->_z_ = (const gsl_vector**)ptr, ptr += sizes[3];
+    tr->_S = (const gsl_matrix**)ptr, ptr += sizes[4];
+    tr->_assigned = (size_t*)ptr, ptr += sizes[5];
+    tr->_u = (double*)ptr;
+    tr->_v = tr->_u + dim;
+    tr->_minv = tr->_v + dim;
+    ptr += sizes[6];
+    tr->_p = (size_t*)ptr;
+    tr->_way = tr->_p + dim;
+    ptr += sizes[7];
+    tr->_used = (unsigned char*)ptr, ptr += sizes[8];
+    tr->_parent = (size_t*)ptr, ptr += sizes[9];
+    tr->_cluster = (size_t*)ptr;
+    tr->_order = tr->_cluster + capacity;
+    tr->_ncand = tr->_order + capacity;
+    tr->_slot = tr->_ncand + capacity;
+    tr->_start = tr->_slot + capacity;
+    ptr += sizes[10];
+    tr->_cand = (size_t*)ptr, ptr += sizes[11];
+    tr->_weight = (double*)ptr;
+    tr->_beta = tr->_weight + capacity * stride;
+    ptr += sizes[12];
+    tr->_taken = (unsigned char*)ptr;
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        cfilt_track* track = &tr->tracks[i];
+        if (cfilt_kalman_filter_alloc_from(&track->filt, tr->_allocator, n, m,
+                                           k) != GSL_SUCCESS)
+        {
+            cfilt_tracker_free(tr);
+            return GSL_ENOMEM;
+        }
+
+        V_ALLOC_ASSERT_FROM(tr->_allocator, track->z_, k, cfilt_tracker_free,
+                            tr);
+        M_ALLOC_ASSERT_FROM(tr->_allocator, track->S, k, k, cfilt_tracker_free,
+                            tr);
+
+        // Popped from the end, tracks are handed out in order
+        tr->_free[i] = capacity - 1 - i;
+    }
+
+    tr->_free_count = capacity;
+
+    M_ALLOC_ASSERT_FROM(tr->_allocator, tr->_cost, capacity, max_detections,
+                        cfilt_tracker_free, tr);
+    M_ALLOC_ASSERT_FROM(tr->_allocator, tr->_C, k, k, cfilt_tracker_free, tr);
+    if (cfilt_cost_workspace_alloc_from(&tr->_cost_ws, tr->_allocator, k,
+                                        capacity) != GSL_SUCCESS)
+    {
+        cfilt_tracker_free(tr);
+        return GSL_ENOMEM;
+    }
+
+    return GSL_SUCCESS;
+}
+
+void
+cfilt_tracker_free(cfilt_tracker* tr)
+{
+    if (tr->tracks)
+    {
+        for (size_t i = 0; i < tr->capacity; ++i)
+        {
+            cfilt_kalman_filter_free(&tr->tracks[i].filt);
+            V_FREE_IF_NOT_NULL(tr->tracks[i].z_);
+            M_FREE_IF_NOT_NULL(tr->tracks[i].S);
+        }
+    }
+
+    cfilt_kalman_filter_free(&tr->model);
+    cfilt_cost_workspace_free(&tr->_cost_ws);
+    M_FREE_IF_NOT_NULL(tr->_cost);
+    M_FREE_IF_NOT_NULL(tr->_C);
+
+    if (tr->_ptr)
+    {
+        cfilt_free(tr->_allocator, tr->_ptr);
+    }
+
+    memset(tr, 0, sizeof(cfilt_tracker));
+}
+
+static int
+cfilt_tracker_predict(cfilt_track* track)
+{
+    cfilt_kalman_filter* filt = &track->filt;
+
+    EXEC_ASSERT(cfilt_kalman_filter_predict, filt);
+
+    // z_ = Hx_, S = HP_H^T + R. P_ may only hold its lower triangle.
+    EXEC_ASSERT(gsl_blas_dgemv, CblasNoTrans, 1.0, filt->H, filt->x_, 0.0,
+                track->z_);
+    EXEC_ASSERT(gsl_blas_dsymm, CblasRight, CblasLower, 1.0, filt->P_,
+                filt->H, 0.0, filt->_HP);
+    EXEC_ASSERT(gsl_matrix_memcpy, track->S, filt->R);
+    EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, filt->_HP,
+                filt->H, 1.0, track->S);
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_tracker_miss(cfilt_track* track)
+{
+    cfilt_kalman_filter* filt = &track->filt;
+
+    // The prediction becomes the estimate, a frozen gain is released by the
+    // next predict which then starts from P_
+    EXEC_ASSERT(gsl_vector_memcpy, filt->x, filt->x_);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->P, filt->P_);
+
+    track->detection = CFILT_TRACKER_NONE;
+    ++track->misses;
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_tracker_birth(cfilt_tracker* tr, const gsl_vector* z, const size_t det)
+{
+    const size_t idx = tr->_free[--tr->_free_count];
+    cfilt_track* track = &tr->tracks[idx];
+    cfilt_kalman_filter* filt = &track->filt;
+    const cfilt_kalman_filter* model = &tr->model;
+
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->F, model->F);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->B, model->B);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->Q, model->Q);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->P, model->P);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->P_, model->P_);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->H, model->H);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->R, model->R);
+    EXEC_ASSERT(gsl_matrix_memcpy, filt->K, model->K);
+    EXEC_ASSERT(gsl_vector_memcpy, filt->u, model->u);
+
+    filt->cov_mode = model->cov_mode;
+    filt->update_mode = model->update_mode;
+    filt->steady_state = model->steady_state;
+    filt->freeze_tol = model->freeze_tol;
+    filt->freeze_window = model->freeze_window;
+    filt->innovation_stats = model->innovation_stats;
+    filt->_frozen = 0;
+    filt->_converged = 0;
+
+    if (tr->birth)
+    {
+        EXEC_ASSERT(tr->birth, filt, z, tr->birth_ptr);
+    }
+    else
+    {
+        EXEC_ASSERT(gsl_blas_dgemv, CblasTrans, 1.0, filt->H, z, 0.0,
+                    filt->x);
+    }
+
+    track->id = tr->_next_id++;
+    track->age = 1;
+    track->hits = 1;
+    track->misses = 0;
+    track->detection = det;
+
+    tr->active[tr->count++] = idx;
+
+    return GSL_SUCCESS;
+}
+
+static inline double
+cfilt_tracker_cell(const gsl_matrix* cost, const size_t i, const size_t j,
+                   const int transposed, const double forbidden)
+{
+    const double c =
+      transposed ? gsl_matrix_get(cost, j, i) : gsl_matrix_get(cost, i, j);
+
+    return c == GSL_POSINF ? forbidden : c;
+}
+
+int
+cfilt_tracker_assign(cfilt_tracker* tr, const gsl_matrix* cost,
+                     const size_t rows, const size_t cols, size_t* row_of)
+{
+    for (size_t j = 0; j < cols; ++j)
+    {
+        row_of[j] = CFILT_TRACKER_NONE;
+    }
+
+    if (rows == 0 || cols == 0)
+    {
+        return GSL_SUCCESS;
+    }
+
+    // The hungarian algorithm below needs no more rows than columns
+    const int transposed = rows > cols;
+    const size_t n = transposed ? cols : rows;
+    const size_t m = transposed ? rows : cols;
+
+    // A forbidden cell costs more than any assignment of allowed cells so
+    // that they are only ever used to complete the matching
+    double highest = 0.0;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            const double c = gsl_matrix_get(cost, i, j);
+            if (c != GSL_POSINF && c > highest)
+            {
+                highest = c;
+            }
+        }
+    }
+
+    const double forbidden = (n + 1) * (highest + 1.0);
+
+    double* u = tr->_u;
+    double* v = tr->_v;
+    double* minv = tr->_minv;
+    size_t* p = tr->_p;
+    size_t* way = tr->_way;
+    unsigned char* used = tr->_used;
+
+    memset(u, 0, (n + 1) * sizeof(double));
+    memset(v, 0, (m + 1) * sizeof(double));
+    memset(p, 0, (m + 1) * sizeof(size_t));
+
+    // Shortest augmenting paths with potentials, indices start at 1 and
+    // column 0 is a sentinel
+    for (size_t i = 1; i <= n; ++i)
+    {
+        p[0] = i;
+        size_t j0 = 0;
+        for (size_t j = 0; j <= m; ++j)
+        {
+            minv[j] = GSL_POSINF;
+            used[j] = 0;
+        }
+
+        do
+        {
+            used[j0] = 1;
+            const size_t i0 = p[j0];
+            double delta = GSL_POSINF;
+            size_t j1 = 0;
+
+            for (size_t j = 1; j <= m; ++j)
+            {
+                if (used[j])
+                {
+                    continue;
+                }
+
+                const double cur =
+                  cfilt_tracker_cell(cost, i0 - 1, j - 1, transposed,
+                                     forbidden) -
+                  u[i0] - v[j];
+                if (cur < minv[j])
+                {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+
+                if (minv[j] < delta)
+                {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+
+            for (size_t j = 0; j <= m; ++j)
+            {
+                if (used[j])
+                {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                }
+                else
+                {
+                    minv[j] -= delta;
+                }
+            }
+
+            j0 = j1;
+        } while (p[j0] != 0);
+
+        do
+        {
+            const size_t j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+
+    for (size_t j = 1; j <= m; ++j)
+    {
+        if (p[j] == 0)
+        {
+            continue;
+        }
+
+        const size_t row = transposed ? j - 1 : p[j] - 1;
+        const size_t col = transposed ? p[j] - 1 : j - 1;
+        if (gsl_matrix_get(cost, row, col) != GSL_POSINF)
+        {
+            row_of[col] = row;
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+static size_t
+cfilt_tracker_find(size_t* parent, size_t i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+
+    return i;
+}
+
+// The smallest index becomes the root, a track whenever the set has one
+static void
+cfilt_tracker_union(size_t* parent, const size_t a, const size_t b)
+{
+    const size_t ra = cfilt_tracker_find(parent, a);
+    const size_t rb = cfilt_tracker_find(parent, b);
+    if (ra < rb)
+    {
+        parent[rb] = ra;
+    }
+    else
+    {
+        parent[ra] = rb;
+    }
+}
+
+// Candidates of every track sorted by decreasing weight, scaled so that the
+// largest is 1 (this scales every joint event of a cluster alike), and the
+// union of the tracks and detections sharing a gate
+static void
+cfilt_tracker_jpda_candidates(cfilt_tracker* tr, const size_t T,
+                              const size_t D)
+{
+    const size_t stride = tr->max_detections + 1;
+    const size_t k = tr->_cost_ws.n;
+    const double log_miss = log(1.0 - tr->pd);
+    const double log_hit =
+      log(tr->pd) - log(tr->clutter) - 0.5 * k * log(2.0 * M_PI);
+
+    for (size_t i = 0; i < T + D; ++i)
+    {
+        tr->_parent[i] = i;
+    }
+
+    for (size_t i = 0; i < T; ++i)
+    {
+        size_t* cand = tr->_cand + i * stride;
+        double* weight = tr->_weight + i * stride;
+        const double* L = tr->_cost_ws.L + i * k * k;
+
+        // log N(z; z_, S) = -(d2 + k log(2pi)) / 2 - sum log L_ll
+        double log_norm = log_hit;
+        for (size_t l = 0; l < k; ++l)
+        {
+            log_norm -= log(L[l * k + l]);
+        }
+
+        size_t count = 1;
+        double highest = log_miss;
+        cand[0] = CFILT_TRACKER_NONE;
+        weight[0] = log_miss;
+
+        for (size_t j = 0; j < D; ++j)
+        {
+            const double d2 = gsl_matrix_get(tr->_cost, i, j);
+            if (d2 == GSL_POSINF)
+            {
+                continue;
+            }
+
+            cand[count] = j;
+            weight[count] = log_norm - 0.5 * d2;
+            highest = max(highest, weight[count]);
+            ++count;
+
+            cfilt_tracker_union(tr->_parent, i, T + j);
+            tr->_assigned[j] = i;
+        }
+
+        // Insertion sort, gates rarely hold more than a few detections
+        for (size_t s = 0; s < count; ++s)
+        {
+            const size_t c = cand[s];
+            const double w = exp(weight[s] - highest);
+
+            size_t t = s;
+            for (; t > 0 && weight[t - 1] < w; --t)
+            {
+                cand[t] = cand[t - 1];
+                weight[t] = weight[t - 1];
+            }
+
+            cand[t] = c;
+            weight[t] = w;
+        }
+
+        tr->_ncand[i] = count;
+    }
+}
+
+// Groups the tracks by cluster, those of cluster c being
+// order[start[c]..start[c + 1]). Returns the number of clusters.
+static size_t
+cfilt_tracker_jpda_clusters(cfilt_tracker* tr, const size_t T)
+{
+    size_t clusters = 0;
+    for (size_t i = 0; i < T; ++i)
+    {
+        const size_t root = cfilt_tracker_find(tr->_parent, i);
+        tr->_cluster[i] = root == i ? clusters++ : tr->_cluster[root];
+    }
+
+    memset(tr->_start, 0, (clusters + 1) * sizeof(size_t));
+    for (size_t i = 0; i < T; ++i)
+    {
+        ++tr->_start[tr->_cluster[i] + 1];
+    }
+
+    for (size_t c = 0; c < clusters; ++c)
+    {
+        tr->_start[c + 1] += tr->_start[c];
+    }
+
+    // _slot is free until the enumeration, it serves as the insertion cursor
+    memcpy(tr->_slot, tr->_start, clusters * sizeof(size_t));
+    for (size_t i = 0; i < T; ++i)
+    {
+        tr->_order[tr->_slot[tr->_cluster[i]]++] = i;
+    }
+
+    return clusters;
+}
+
+typedef struct
+{
+    cfilt_tracker* tr;
+    const size_t* order;
+    size_t size;
+    size_t events;
+    double best;
+
+} cfilt_tracker_jpda_cluster;
+
+// Clusters share no track nor detection, so that they can be enumerated
+// concurrently over the same scratch space
+static void
+cfilt_tracker_jpda_enumerate(cfilt_tracker_jpda_cluster* cluster,
+                             const size_t depth, const double w)
+{
+    cfilt_tracker* tr = cluster->tr;
+    const size_t stride = tr->max_detections + 1;
+
+    if (cluster->events >= tr->max_events)
+    {
+        return;
+    }
+
+    if (depth == cluster->size)
+    {
+        ++cluster->events;
+        cluster->best = max(cluster->best, w);
+        for (size_t d = 0; d < cluster->size; ++d)
+        {
+            const size_t i = cluster->order[d];
+            tr->_beta[i * stride + tr->_slot[i]] += w;
+        }
+
+        return;
+    }
+
+    const size_t i = cluster->order[depth];
+    const size_t* cand = tr->_cand + i * stride;
+    const double* weight = tr->_weight + i * stride;
+
+    for (size_t s = 0; s < tr->_ncand[i]; ++s)
+    {
+        // Weights are at most 1 and sorted, nothing further can do better
+        const double next = w * weight[s];
+        if (next < tr->prune * cluster->best)
+        {
+            break;
+        }
+
+        const size_t j = cand[s];
+        if (j != CFILT_TRACKER_NONE)
+        {
+            if (tr->_taken[j])
+            {
+                continue;
+            }
+
+            tr->_taken[j] = 1;
+        }
+
+        tr->_slot[i] = s;
+        cfilt_tracker_jpda_enumerate(cluster, depth + 1, next);
+
+        if (j != CFILT_TRACKER_NONE)
+        {
+            tr->_taken[j] = 0;
+        }
+    }
+}
+
+// Combined innovation update of the track at position i
+static int
+cfilt_tracker_jpda_update(cfilt_tracker* tr, const size_t i,
+                          const gsl_matrix* Z)
+{
+    const size_t stride = tr->max_detections + 1;
+    const size_t* cand = tr->_cand + i * stride;
+    double* beta = tr->_beta + i * stride;
+
+    cfilt_track* track = &tr->tracks[tr->active[i]];
+    cfilt_kalman_filter* filt = &track->filt;
+
+    double total = 0.0;
+    double beta_0 = 0.0;
+    for (size_t s = 0; s < tr->_ncand[i]; ++s)
+    {
+        total += beta[s];
+        if (cand[s] == CFILT_TRACKER_NONE)
+        {
+            beta_0 = beta[s];
+        }
+    }
+
+    // Every enumerated event vanished, left to the miss handling
+    if (total == 0.0)
+    {
+        return GSL_SUCCESS;
+    }
+
+    beta_0 /= total;
+
+    // y = sum beta_j y_j, C = (1 - beta_0)S - sum beta_j y_j y_j^T + yy^T
+    double most = -1.0;
+    gsl_matrix* C = tr->_C;
+    gsl_vector_set_zero(filt->y);
+    EXEC_ASSERT(gsl_matrix_memcpy, C, track->S);
+    EXEC_ASSERT(gsl_matrix_scale, C, 1.0 - beta_0);
+
+    for (size_t s = 0; s < tr->_ncand[i]; ++s)
+    {
+        const double b = beta[s] / total;
+        if (cand[s] == CFILT_TRACKER_NONE)
+        {
+            continue;
+        }
+
+        if (b > most)
+        {
+            most = b;
+            track->detection = cand[s];
+        }
+
+        gsl_vector_const_view z = gsl_matrix_const_row(Z, cand[s]);
+        EXEC_ASSERT(gsl_vector_memcpy, filt->z, &z.vector);
+        EXEC_ASSERT(gsl_vector_sub, filt->z, track->z_);
+        EXEC_ASSERT(gsl_blas_daxpy, b, filt->z, filt->y);
+        EXEC_ASSERT(gsl_blas_dger, -b, filt->z, filt->z, C);
+    }
+
+    EXEC_ASSERT(gsl_blas_dger, 1.0, filt->y, filt->y, C);
+    EXEC_ASSERT(cfilt_kalman_filter_update_combined, filt, filt->y, C);
+
+    track->misses = 0;
+    ++track->hits;
+
+    return GSL_SUCCESS;
+}
+
+static int
+cfilt_tracker_jpda(cfilt_tracker* tr, const gsl_matrix* Z, const size_t T)
+{
+    const size_t D = Z->size1;
+    if (T == 0 || D == 0)
+    {
+        return GSL_SUCCESS;
+    }
+
+    cfilt_tracker_jpda_candidates(tr, T, D);
+    const size_t clusters = cfilt_tracker_jpda_clusters(tr, T);
+
+    memset(tr->_beta, 0, T * (tr->max_detections + 1) * sizeof(double));
+    memset(tr->_taken, 0, D);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t c = 0; c < clusters; ++c)
+    {
+        cfilt_tracker_jpda_cluster cluster = {
+            .tr = tr,
+            .order = tr->_order + tr->_start[c],
+            .size = tr->_start[c + 1] - tr->_start[c],
+            .events = 0,
+            .best = 0.0,
+        };
+        cfilt_tracker_jpda_enumerate(&cluster, 0, 1.0);
+    }
+
+    for (size_t i = 0; i < T; ++i)
+    {
+        if (tr->_ncand[i] > 1)
+        {
+            EXEC_ASSERT(cfilt_tracker_jpda_update, tr, i, Z);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_tracker_step(cfilt_tracker* tr, const gsl_matrix* Z)
+{
+    const size_t D = Z->size1;
+    if (D > tr->max_detections || Z->size2 != tr->model.H->size1)
+    {
+        GSL_ERROR("Z must have k columns and at most max_detections rows",
+                  GSL_EBADLEN);
+    }
+
+    const size_t T = tr->count;
+    for (size_t i = 0; i < T; ++i)
+    {
+        cfilt_track* track = &tr->tracks[tr->active[i]];
+        EXEC_ASSERT(cfilt_tracker_predict, track);
+
+        tr->_z_[i] = track->z_;
+        tr->_S[i] = track->S;
+        track->detection = CFILT_TRACKER_NONE;
+        ++track->age;
+    }
+
+    if (T > 0 && D > 0)
+    {
+        EXEC_ASSERT(cfilt_cost_matrix, &tr->_cost_ws, tr->_z_, tr->_S, T, Z,
+                    tr->gate, tr->_cost);
+    }
+
+    if (tr->mode == CFILT_TRACKER_JPDA)
+    {
+        for (size_t j = 0; j < D; ++j)
+        {
+            tr->_assigned[j] = CFILT_TRACKER_NONE;
+        }
+
+        EXEC_ASSERT(cfilt_tracker_jpda, tr, Z, T);
+    }
+    else
+    {
+        EXEC_ASSERT(cfilt_tracker_assign, tr, tr->_cost, T, D, tr->_assigned);
+    }
+
+    for (size_t j = 0; j < D && tr->mode == CFILT_TRACKER_GNN; ++j)
+    {
+        const size_t i = tr->_assigned[j];
+        if (i == CFILT_TRACKER_NONE)
+        {
+            continue;
+        }
+
+        cfilt_track* track = &tr->tracks[tr->active[i]];
+        gsl_vector_const_view z = gsl_matrix_const_row(Z, j);
+        EXEC_ASSERT(gsl_vector_memcpy, track->filt.z, &z.vector);
+        EXEC_ASSERT(cfilt_kalman_filter_update, &track->filt);
+
+        track->detection = j;
+        track->misses = 0;
+        ++track->hits;
+    }
+
+    // Misses and deletions, only over the tracks that were predicted
+    for (size_t i = T; i-- > 0;)
+    {
+        cfilt_track* track = &tr->tracks[tr->active[i]];
+        if (track->detection != CFILT_TRACKER_NONE)
+        {
+            continue;
+        }
+
+        EXEC_ASSERT(cfilt_tracker_miss, track);
+        if (track->misses > tr->max_misses)
+        {
+            tr->_free[tr->_free_count++] = tr->active[i];
+            tr->active[i] = tr->active[--tr->count];
+        }
+    }
+
+    for (size_t j = 0; j < D && tr->_free_count > 0; ++j)
+    {
+        if (tr->_assigned[j] == CFILT_TRACKER_NONE)
+        {
+            gsl_vector_const_view z = gsl_matrix_const_row(Z, j);
+            EXEC_ASSERT(cfilt_tracker_birth, tr, &z.vector, j);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
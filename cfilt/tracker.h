@@ -0,0 +1,184 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CFILT_TRACKER_H_
+#define CFILT_TRACKER_H_
+
+#include "cfilt/allocator.h"
+#include "cfilt/cost.h"
+#include "cfilt/kalman.h"
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Global nearest neighbour multi target tracker over linear Kalman filters.
+ *
+ * Each step predicts every live track, scores the detections (rows of Z,
+ * D x k) against each track's predicted measurement with the squared
+ * mahalanobis distance (see cost.h), and solves the track to detection
+ * assignment of minimal total cost with the hungarian algorithm. Pairs beyond
+ * the gate are never assigned, nor are tracks whose innovation covariance is
+ * not positive definite. Assigned tracks are updated with their detection.
+ * Unassigned tracks keep their prediction and are deleted after more than
+ * max_misses consecutive misses. Unassigned detections give birth to new
+ * tracks while the pool has room.
+ *
+ * model holds F, B, Q, H, R, u and the initial P (and the filter settings)
+ * copied into every new track. A new track's state is given by birth when
+ * set, and by H^Tz otherwise (correct when H selects state variables).
+ *
+ * Tracks live in a pool of capacity filters allocated once. tracks[active[i]]
+ * for i < count are the live ones, in no particular order. Nothing is
+ * allocated by cfilt_tracker_step.
+ *
+ * With CFILT_TRACKER_JPDA, detections are softly shared between the tracks
+ * gating them (joint probabilistic data association). Tracks and detections
+ * linked by a gate form clusters processed independently (in parallel when
+ * built with OpenMP). The joint events of a cluster, assignments of at most
+ * one detection per track and one track per detection, are enumerated depth
+ * first from the most likely choices on, skipping every branch less likely
+ * than prune times the best event so far and stopping after max_events. A
+ * track's association probabilities beta_j (beta_0 for none) come from the
+ * event weights, a product of pd N(z_j; z_, S) / clutter for each associated
+ * track and 1 - pd for each other one (the gate probability is taken as 1).
+ * The track is then updated with the combined innovation y = sum beta_j y_j,
+ *
+ *   x = x_ + Ky
+ *   P = P_ - K((1 - beta_0)S - sum beta_j y_j y_j^T + yy^T)K^T
+ *
+ * A track without any detection in its gate is a miss and detection holds its
+ * most likely detection otherwise. Only detections outside of every gate give
+ * birth to new tracks.
+ *
+ * step : O(T(n^3 + k^3) + TDk^2 + min(T, D)^2 max(T, D))
+ * jpda : O(T(n^3 + k^3) + TDk^2 + max_events * sum of cluster sizes)
+ */
+
+#define CFILT_TRACKER_NONE ((size_t)-1)
+
+typedef enum
+{
+    CFILT_TRACKER_GNN = 0,
+    CFILT_TRACKER_JPDA
+} cfilt_tracker_mode;
+
+typedef struct
+{
+    cfilt_kalman_filter filt;
+    gsl_vector* z_; // Predicted measurement Hx_
+    gsl_matrix* S;  // Innovation covariance HP_H^T + R
+
+    size_t id;
+    size_t age;
+    size_t hits;
+    size_t misses;    // Consecutive
+    size_t detection; // Row of Z used in the last step or CFILT_TRACKER_NONE
+
+} cfilt_track;
+
+typedef struct
+{
+    cfilt_kalman_filter model;
+    cfilt_tracker_mode mode;
+    double gate;
+    size_t max_misses;
+
+    // JPDA parameters
+    double pd;         // Probability of detection
+    double clutter;    // Clutter density in measurement space
+    double prune;      // Relative weight under which events are skipped
+    size_t max_events; // Per cluster
+
+    int (*birth)(cfilt_kalman_filter* filt, const gsl_vector* z, void* ptr);
+    void* birth_ptr;
+
+    size_t capacity;
+    size_t max_detections;
+    cfilt_track* tracks;
+    size_t* active;
+    size_t count;
+
+    // Pool and association scratch space
+    size_t _next_id;
+    size_t* _free;
+    size_t _free_count;
+    const gsl_vector** _z_;
+    const gsl_matrix** _S;
+    size_t* _assigned; // Track of each detection or CFILT_TRACKER_NONE
+    cfilt_cost_workspace _cost_ws;
+    gsl_matrix* _cost;
+
+    double* _u;
+    double* _v;
+    double* _minv;
+    size_t* _p;
+    size_t* _way;
+    unsigned char* _used;
+
+    // JPDA scratch, candidates of track i at i * (max_detections + 1) sorted
+    // by decreasing weight with the miss among them
+    size_t* _parent;
+    size_t* _cluster;
+    size_t* _order;
+    size_t* _start;
+    size_t* _ncand;
+    size_t* _slot;
+    size_t* _cand;
+    double* _weight;
+    double* _beta;
+    unsigned char* _taken;
+    gsl_matrix* _C; // Spread of the combined innovation
+
+    void* _ptr;
+    cfilt_allocator* _allocator;
+
+} cfilt_tracker;
+
+int cfilt_tracker_alloc(cfilt_tracker* tr, const size_t n, const size_t m,
+                        const size_t k, const size_t capacity,
+                        const size_t max_detections);
+
+int cfilt_tracker_alloc_from(cfilt_tracker* tr, cfilt_allocator* allocator,
+                             const size_t n, const size_t m, const size_t k,
+                             const size_t capacity,
+                             const size_t max_detections);
+
+void cfilt_tracker_free(cfilt_tracker* tr);
+
+int cfilt_tracker_step(cfilt_tracker* tr, const gsl_matrix* Z);
+
+// Assignment of minimal total cost between the first rows x cols cells of
+// cost, GSL_POSINF cells being forbidden. row_of[j] receives the row assigned
+// to column j or CFILT_TRACKER_NONE. Uses the tracker's scratch space.
+int cfilt_tracker_assign(cfilt_tracker* tr, const gsl_matrix* cost,
+                         const size_t rows, const size_t cols,
+                         size_t* row_of);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CFILT_TRACKER_H_
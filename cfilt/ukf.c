@@ -143,7 +143,7 @@ cfilt_ukf_realloc(cfilt_ukf* filt, const size_t n, const size_t m, const size_t
 
     if (!filt->allocated_once)
     {
-        filt->_perm = gsl_permutation_alloc(k);
+        filt->_perm = cfilt_permutation_alloc(NULL, k);
         if (filt->_perm == NULL)
         {
             cfilt_ukf_free(filt);
@@ -185,10 +185,7 @@ cfilt_ukf_free(cfilt_ukf* filt)
     M_FREE_IF_NOT_NULL(filt->_K_P_z);
     M_FREE_IF_NOT_NULL(filt->_Y_x_Z_u);
 
-    if (filt->_perm != NULL)
-    {
-        gsl_permutation_free(filt->_perm);
-    }
+    P_FREE_IF_NOT_NULL(filt->_perm);
 }
 
 int
@@ -44,6 +44,53 @@ cfilt_matrix_invert(gsl_matrix* src, gsl_matrix* dst, gsl_permutation* perm)
     return GSL_SUCCESS;
 }
 
+int
+cfilt_matrix_cholesky(gsl_matrix* src)
+{
+    // In place LL^T decomposition. Only the lower triangle is referenced and
+    // overwritten. Unlike gsl_linalg_cholesky_decomp1, a matrix that is not
+    // positive definite is reported without calling the gsl error handler so
+    // that callers can fall back on another factorization.
+    const size_t n = src->size1;
+    if (n != src->size2)
+    {
+        GSL_ERROR("cholesky decomposition requires a square matrix",
+                  GSL_ENOTSQR);
+    }
+
+    for (size_t j = 0; j < n; ++j)
+    {
+        double* row_j = gsl_matrix_ptr(src, j, 0);
+        double d = row_j[j];
+        for (size_t l = 0; l < j; ++l)
+        {
+            d -= row_j[l] * row_j[l];
+        }
+
+        if (!(d > 0.0))
+        {
+            return GSL_EDOM;
+        }
+
+        d = sqrt(d);
+        row_j[j] = d;
+
+        for (size_t i = j + 1; i < n; ++i)
+        {
+            double* row_i = gsl_matrix_ptr(src, i, 0);
+            double s = row_i[j];
+            for (size_t l = 0; l < j; ++l)
+            {
+                s -= row_i[l] * row_j[l];
+            }
+
+            row_i[j] = s / d;
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
 int
 cfilt_matrix_tri_zero(gsl_matrix* src, int upper)
 {
@@ -71,6 +118,69 @@ cfilt_matrix_tri_zero(gsl_matrix* src, int upper)
     return GSL_SUCCESS;
 }
 
+int
+cfilt_matrix_symmetrize(gsl_matrix* src, int upper)
+{
+    // Mirrors the given triangle onto the other one
+    if (src->size1 != src->size2)
+    {
+        GSL_ERROR("only a square matrix can be symmetrized", GSL_ENOTSQR);
+    }
+
+    for (size_t i = 1; i < src->size1; ++i)
+    {
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (upper)
+            {
+                gsl_matrix_set(src, i, j, gsl_matrix_get(src, j, i));
+            }
+            else
+            {
+                gsl_matrix_set(src, j, i, gsl_matrix_get(src, i, j));
+            }
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_matrix_sym_pack(const gsl_matrix* src, double* dst)
+{
+    // Lower triangle, row major: element (i, j <= i) lands at i(i + 1)/2 + j.
+    // dst must hold n(n + 1)/2 values.
+    if (src->size1 != src->size2)
+    {
+        GSL_ERROR("only a square matrix can be packed", GSL_ENOTSQR);
+    }
+
+    for (size_t i = 0; i < src->size1; ++i)
+    {
+        memcpy(dst, gsl_matrix_const_ptr(src, i, 0), (i + 1) * sizeof(double));
+        dst += i + 1;
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+cfilt_matrix_sym_unpack(const double* src, gsl_matrix* dst)
+{
+    if (dst->size1 != dst->size2)
+    {
+        GSL_ERROR("only a square matrix can be unpacked", GSL_ENOTSQR);
+    }
+
+    for (size_t i = 0; i < dst->size1; ++i)
+    {
+        memcpy(gsl_matrix_ptr(dst, i, 0), src, (i + 1) * sizeof(double));
+        src += i + 1;
+    }
+
+    return cfilt_matrix_symmetrize(dst, 0);
+}
+
 int
 cfilt_matrix_cmp(gsl_matrix* a, gsl_matrix* b)
 {
@@ -80,7 +190,7 @@ cfilt_matrix_cmp(gsl_matrix* a, gsl_matrix* b)
 int
 cfilt_matrix_cmp_tol(const gsl_matrix* a, const gsl_matrix* b, const double tol)
 {
-    if (a->size1 != b->size2 || a->size2 != b->size2 || a->tda != b->tda)
+    if (a->size1 != b->size1 || a->size2 != b->size2 || a->tda != b->tda)
     {
         return GSL_EBADLEN;
     }
@@ -126,7 +236,7 @@ cfilt_matrix_realloc(gsl_matrix** a, const size_t n, const size_t m, const int k
         return GSL_SUCCESS;
     }
 
-    gsl_matrix* b = gsl_matrix_alloc(n, m);
+    gsl_matrix* b = cfilt_matrix_alloc(NULL, n, m);
     if (b == NULL)
     {
         return GSL_ENOMEM;
@@ -137,7 +247,7 @@ cfilt_matrix_realloc(gsl_matrix** a, const size_t n, const size_t m, const int k
         EXEC_ASSERT(gsl_matrix_memcpy, a_, b);
     }
 
-    gsl_matrix_free(a_);
+    cfilt_matrix_free(a_);
     *a = b;
 
     return GSL_SUCCESS;
@@ -149,13 +259,13 @@ cfilt_permutation_realloc(gsl_permutation** p, const size_t n)
     gsl_permutation* p_ = *p;
     if (p_->size != n)
     {
-        gsl_permutation* q = gsl_permutation_alloc(n);
+        gsl_permutation* q = cfilt_permutation_alloc(NULL, n);
         if (q == NULL)
         {
             return GSL_ENOMEM;
         }
 
-        gsl_permutation_free(p_);
+        cfilt_permutation_free(p_);
         *p = q;
     }
 
@@ -213,7 +323,7 @@ cfilt_vector_realloc(gsl_vector** a, const size_t n, const int keep_values)
         return GSL_SUCCESS;
     }
 
-    gsl_vector* b = gsl_vector_alloc(n);
+    gsl_vector* b = cfilt_vector_alloc(NULL, n);
     if (b == NULL)
     {
         return GSL_ENOMEM;
@@ -224,7 +334,7 @@ cfilt_vector_realloc(gsl_vector** a, const size_t n, const int keep_values)
         EXEC_ASSERT(cfilt_vector_var_memcpy, a_, b);
     }
 
-    gsl_vector_free(a_);
+    cfilt_vector_free(a_);
     *a = b;
 
     return GSL_SUCCESS;
@@ -20,6 +20,8 @@
 #ifndef CFILT_UTIL_H_
 #define CFILT_UTIL_H_
 
+#include "cfilt/allocator.h"
+
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_permutation.h>
@@ -37,15 +39,17 @@
         func(p);                                                               \
         p = NULL;                                                              \
     }
-#define V_FREE_IF_NOT_NULL(v) FREE_IF_NOT_NULL(v, gsl_vector_free)
-#define M_FREE_IF_NOT_NULL(m) FREE_IF_NOT_NULL(m, gsl_matrix_free)
+#define V_FREE_IF_NOT_NULL(v) FREE_IF_NOT_NULL(v, cfilt_vector_free)
+#define M_FREE_IF_NOT_NULL(m) FREE_IF_NOT_NULL(m, cfilt_matrix_free)
+#define P_FREE_IF_NOT_NULL(p) FREE_IF_NOT_NULL(p, cfilt_permutation_free)
 
-#define IS_EQ_TOL(x, y, tol) (abs(x - y) <= tol)
+#define IS_EQ_TOL(x, y, tol) (fabs((x) - (y)) <= (tol))
 
-#define M_ALLOC_ASSERT(p, n, m, func, ...)                                     \
+// Allocations from the given allocator, NULL being the global one
+#define M_ALLOC_ASSERT_FROM(a, p, n, m, func, ...)                             \
     do                                                                         \
     {                                                                          \
-        p = gsl_matrix_alloc((n), (m));                                        \
+        p = cfilt_matrix_alloc((a), (n), (m));                                 \
         if (p == NULL)                                                         \
         {                                                                      \
             func(__VA_ARGS__);                                                 \
@@ -53,10 +57,10 @@
         }                                                                      \
     } while (0);
 
-#define V_ALLOC_ASSERT(p, n, func, ...)                                        \
+#define V_ALLOC_ASSERT_FROM(a, p, n, func, ...)                                \
     do                                                                         \
     {                                                                          \
-        p = gsl_vector_alloc(n);                                               \
+        p = cfilt_vector_alloc((a), (n));                                      \
         if (p == NULL)                                                         \
         {                                                                      \
             func(__VA_ARGS__);                                                 \
@@ -64,6 +68,11 @@
         }                                                                      \
     } while (0);
 
+#define M_ALLOC_ASSERT(p, n, m, func, ...)                                     \
+    M_ALLOC_ASSERT_FROM(NULL, p, n, m, func, __VA_ARGS__)
+#define V_ALLOC_ASSERT(p, n, func, ...)                                        \
+    V_ALLOC_ASSERT_FROM(NULL, p, n, func, __VA_ARGS__)
+
 #define EXEC_ASSERT(func, ...)                                                 \
     do                                                                         \
     {                                                                          \
@@ -79,8 +88,16 @@
 int cfilt_matrix_invert(gsl_matrix* src, gsl_matrix* dst,
                         gsl_permutation* perm);
 
+int cfilt_matrix_cholesky(gsl_matrix* src);
+
 int cfilt_matrix_tri_zero(gsl_matrix* src, int upper);
 
+int cfilt_matrix_symmetrize(gsl_matrix* src, int upper);
+
+int cfilt_matrix_sym_pack(const gsl_matrix* src, double* dst);
+
+int cfilt_matrix_sym_unpack(const double* src, gsl_matrix* dst);
+
 int cfilt_matrix_cmp(gsl_matrix* a, gsl_matrix* b);
 
 int cfilt_matrix_cmp_tol(const gsl_matrix* a, const gsl_matrix* b,
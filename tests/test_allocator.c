@@ -0,0 +1,183 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/allocator.h"
+#include "cfilt/gh.h"
+#include "cfilt/kalman.h"
+#include "cfilt/sigma.h"
+#include "cfilt/srkf.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Counts the bytes it hands out on top of the allocator's own counters
+static void*
+test_alloc(void* ctx, size_t size, size_t align)
+{
+    void* ptr;
+    if (posix_memalign(&ptr, align, size))
+    {
+        return NULL;
+    }
+
+    *(size_t*)ctx += size;
+
+    return ptr;
+}
+
+static void
+test_free(void* ctx, void* ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+static void*
+test_alloc_fail(void* ctx, size_t size, size_t align)
+{
+    (void)ctx;
+    (void)size;
+    (void)align;
+
+    return NULL;
+}
+
+int
+test_cfilt_allocator_matrix(void)
+{
+    size_t bytes = 0;
+    cfilt_allocator allocator = { test_alloc, test_free, &bytes, 0, 0 };
+
+    gsl_matrix* mat = cfilt_matrix_alloc(&allocator, 3, 5);
+    gsl_vector* vec = cfilt_vector_alloc(&allocator, 7);
+    gsl_permutation* perm = cfilt_permutation_alloc(&allocator, 4);
+    UTEST_ASSERT(mat && vec && perm, "Allocation failed");
+    UTEST_ASSERT(allocator.allocs == 3 && bytes > 0, "Allocations not counted");
+
+    UTEST_ASSERT(mat->size1 == 3 && mat->size2 == 5 && mat->tda == 5,
+                 "Wrong matrix shape");
+    UTEST_ASSERT((uintptr_t)mat->data % CFILT_ALIGN == 0,
+                 "Matrix data misaligned");
+    gsl_matrix_set_all(mat, 1.0);
+    gsl_vector_set_all(vec, 1.0);
+    UTEST_ASSERT(gsl_permutation_get(perm, 3) == 3,
+                 "Permutation not initialized");
+
+    cfilt_matrix_free(mat);
+    cfilt_vector_free(vec);
+    cfilt_permutation_free(perm);
+    UTEST_ASSERT(allocator.frees == 3, "Frees not counted");
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_allocator_per_object(void)
+{
+    size_t bytes = 0;
+    cfilt_allocator allocator = { test_alloc, test_free, &bytes, 0, 0 };
+    const size_t global_allocs = cfilt_allocator_get()->allocs;
+
+    cfilt_kalman_filter kf;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc_from, &kf, &allocator, 3, 1, 2);
+    UTEST_ASSERT(allocator.allocs == 1, "Kalman filter is not a single block");
+
+    cfilt_srkf srkf;
+    UTEST_EXEC_ASSERT(cfilt_srkf_alloc_from, &srkf, &allocator, 3, 1, 2);
+
+    cfilt_gh_filter gh;
+    UTEST_EXEC_ASSERT(cfilt_gh_alloc_from, &gh, &allocator, 3);
+
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == global_allocs,
+                 "Global allocator used");
+
+    // The steady state step loop never allocates
+    const size_t allocs = allocator.allocs;
+    gsl_matrix_set_identity(kf.F);
+    gsl_matrix_set_identity(kf.Q);
+    gsl_matrix_set_identity(kf.P);
+    gsl_matrix_set_identity(kf.R);
+    gsl_matrix_set(kf.H, 0, 0, 1.0);
+    gsl_matrix_set(kf.H, 1, 1, 1.0);
+    for (int i = 0; i < 10; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &kf);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &kf);
+        cfilt_gh_predict(&gh, 0.1);
+        cfilt_gh_update(&gh, 0.1);
+    }
+
+    UTEST_ASSERT(allocator.allocs == allocs, "Step loop allocated");
+
+    cfilt_kalman_filter_free(&kf);
+    cfilt_srkf_free(&srkf);
+    cfilt_gh_free(&gh);
+    UTEST_ASSERT(allocator.frees == allocator.allocs, "Leaked %zu blocks",
+                 allocator.allocs - allocator.frees);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_allocator_global(void)
+{
+    size_t bytes = 0;
+    cfilt_allocator allocator = { test_alloc, test_free, &bytes, 0, 0 };
+
+    cfilt_allocator_set(&allocator);
+
+    cfilt_sigma_generator* gen;
+    UTEST_EXEC_ASSERT(cfilt_sigma_generator_alloc, CFILT_SIGMA_VAN_DER_MERWE,
+                      &gen, 3, 0.1, 2.0, 0.0);
+
+    cfilt_kalman_filter kf;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &kf, 3, 1, 2);
+
+    // Objects give their memory back to the allocator they came from
+    cfilt_allocator_set(NULL);
+    UTEST_ASSERT(cfilt_allocator_get() == cfilt_allocator_default(),
+                 "Default allocator not restored");
+
+    cfilt_sigma_generator_free(gen);
+    cfilt_kalman_filter_free(&kf);
+    UTEST_ASSERT(allocator.allocs > 1 && allocator.frees == allocator.allocs,
+                 "Leaked %zu blocks", allocator.allocs - allocator.frees);
+
+    // Out of memory
+    allocator.alloc = test_alloc_fail;
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_kalman_filter_alloc_from, &kf, &allocator, 3, 1,
+                       2);
+    gsl_set_error_handler(hdl);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_allocator_matrix);
+    RUN_TEST(test_cfilt_allocator_per_object);
+    RUN_TEST(test_cfilt_allocator_global);
+
+    return GSL_SUCCESS;
+}
@@ -103,12 +103,132 @@ test_norm_estimated_error_squared(void)
     return GSL_SUCCESS;
 }
 
+int
+test_mahalanobis_ws(void)
+{
+    // cov = [4 2; 2 3], x - mu = (1, 2), cov^-1 = [3 -2; -2 4] / 8
+    const double expected = (3.0 * 1.0 - 4.0 * 2.0 + 4.0 * 4.0) / 8.0;
+
+    cfilt_mahalanobis_workspace w;
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_workspace_alloc, &w, 2);
+
+    gsl_vector* x = gsl_vector_alloc(2);
+    gsl_vector* mu = gsl_vector_alloc(2);
+    gsl_matrix* cov = gsl_matrix_alloc(2, 2);
+
+    gsl_vector_set(x, 0, 2.0);
+    gsl_vector_set(x, 1, 1.0);
+    gsl_vector_set(mu, 0, 1.0);
+    gsl_vector_set(mu, 1, -1.0);
+    gsl_matrix_set(cov, 0, 0, 4.0);
+    gsl_matrix_set(cov, 0, 1, 2.0);
+    gsl_matrix_set(cov, 1, 0, 2.0);
+    gsl_matrix_set(cov, 1, 1, 3.0);
+
+    const size_t allocs = cfilt_allocator_get()->allocs;
+
+    double distance;
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_ws, x, mu, cov, &w, &distance);
+    UTEST_ASSERT(IS_EQ_TOL(distance * distance, expected, 1e-12),
+                 "Expected %f, got %f", expected, distance * distance);
+
+    // The factor stays in the workspace
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_chol, x, mu, w.L, w.d, &distance);
+    UTEST_ASSERT(IS_EQ_TOL(distance * distance, expected, 1e-12),
+                 "Expected %f, got %f", expected, distance * distance);
+
+    double nees;
+    UTEST_EXEC_ASSERT(gsl_vector_sub, x, mu);
+    UTEST_EXEC_ASSERT(cfilt_norm_estimated_error_squared_ws, x, cov, &w,
+                      &nees);
+    UTEST_ASSERT(IS_EQ_TOL(nees, expected, 1e-12), "Expected %f, got %f",
+                 expected, nees);
+
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs,
+                 "Workspace functions allocated");
+
+    gsl_matrix_set(cov, 1, 1, -1.0);
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_mahalanobis_ws, x, mu, cov, &w, &distance);
+    gsl_set_error_handler(hdl);
+
+    gsl_vector_free(x);
+    gsl_vector_free(mu);
+    gsl_matrix_free(cov);
+    cfilt_mahalanobis_workspace_free(&w);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_mahalanobis_batch(void)
+{
+    const size_t p = 9;
+
+    cfilt_mahalanobis_workspace w;
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_workspace_alloc, &w, 2);
+
+    gsl_matrix* X = gsl_matrix_alloc(p, 2);
+    gsl_matrix* work = gsl_matrix_alloc(p, 2);
+    gsl_vector* res = gsl_vector_alloc(p);
+    gsl_vector* mu = gsl_vector_alloc(2);
+    gsl_matrix* cov = gsl_matrix_alloc(2, 2);
+
+    gsl_vector_set(mu, 0, 1.0);
+    gsl_vector_set(mu, 1, -1.0);
+    gsl_matrix_set(cov, 0, 0, 4.0);
+    gsl_matrix_set(cov, 0, 1, 2.0);
+    gsl_matrix_set(cov, 1, 0, 2.0);
+    gsl_matrix_set(cov, 1, 1, 3.0);
+    for (size_t i = 0; i < p; ++i)
+    {
+        gsl_matrix_set(X, i, 0, 0.5 * i);
+        gsl_matrix_set(X, i, 1, 2.0 - 0.75 * i);
+    }
+
+    const double gate = 2.0;
+    unsigned char mask[9];
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_factor, cov, &w);
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_batch, X, mu, w.L, work, res, gate,
+                      mask);
+
+    // Must match the distances computed one point at a time
+    size_t passed = 0;
+    for (size_t i = 0; i < p; ++i)
+    {
+        gsl_vector_view x = gsl_matrix_row(X, i);
+
+        double distance;
+        UTEST_EXEC_ASSERT(cfilt_mahalanobis_chol, &x.vector, mu, w.L, w.d,
+                          &distance);
+        UTEST_ASSERT(IS_EQ_TOL(gsl_vector_get(res, i), distance, 1e-12),
+                     "Point %zu : expected %f, got %f", i, distance,
+                     gsl_vector_get(res, i));
+        UTEST_ASSERT(mask[i] == (distance * distance <= gate),
+                     "Point %zu wrongly gated", i);
+        passed += mask[i];
+    }
+
+    UTEST_ASSERT(passed > 0 && passed < p, "Gate does not split the points");
+
+    gsl_matrix_free(X);
+    gsl_matrix_free(work);
+    gsl_vector_free(res);
+    gsl_vector_free(mu);
+    gsl_matrix_free(cov);
+    cfilt_mahalanobis_workspace_free(&w);
+
+    return GSL_SUCCESS;
+}
+
 int
 main(void)
 {
     RUN_TEST(test_discrete_white_noise);
     RUN_TEST(test_mahalanobis);
     RUN_TEST(test_norm_estimated_error_squared);
+    RUN_TEST(test_mahalanobis_ws);
+    RUN_TEST(test_mahalanobis_batch);
 
     return GSL_SUCCESS;
 }
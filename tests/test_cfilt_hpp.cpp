@@ -0,0 +1,297 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/cfilt.hpp"
+#include "cfilt/gh.h"
+#include "cfilt/kalman.h"
+#include "cfilt/sigma.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+
+#include <cmath>
+
+// The templates against their C counterparts over a few steps
+
+// Row major arrays against matrices of the same shape
+template <std::size_t size>
+static void
+to_gsl(const std::array<double, size>& src, gsl_matrix* dst)
+{
+    for (std::size_t i = 0; i < dst->size1; ++i)
+    {
+        for (std::size_t j = 0; j < dst->size2; ++j)
+        {
+            gsl_matrix_set(dst, i, j, src[i * dst->size2 + j]);
+        }
+    }
+}
+
+template <std::size_t size>
+static int
+cmp(const std::array<double, size>& a, const gsl_matrix* b, const double tol)
+{
+    UTEST_ASSERT(size == b->size1 * b->size2, "Shapes differ");
+    for (std::size_t i = 0; i < b->size1; ++i)
+    {
+        for (std::size_t j = 0; j < b->size2; ++j)
+        {
+            const double d = a[i * b->size2 + j] - gsl_matrix_get(b, i, j);
+            UTEST_ASSERT(std::fabs(d) <= tol, "(%zu, %zu) off by %g", i, j, d);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+template <std::size_t size>
+static int
+cmp(const std::array<double, size>& a, const gsl_vector* b, const double tol)
+{
+    UTEST_ASSERT(size == b->size, "Sizes differ");
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const double d = a[i] - gsl_vector_get(b, i);
+        UTEST_ASSERT(std::fabs(d) <= tol, "(%zu) off by %g", i, d);
+    }
+
+    return GSL_SUCCESS;
+}
+
+// Constant acceleration with position and velocity sensors
+static void
+init_model(cfilt::KalmanFilter<3, 1, 2>& filt)
+{
+    const double dt = 0.1;
+    filt.F = { 1.0, dt, 0.5 * dt * dt, 0.0, 1.0, dt, 0.0, 0.0, 1.0 };
+    filt.B = { 0.0, 0.0, 0.5 };
+    filt.Q = { 0.01, 0.0, 0.0, 0.0, 0.01, 0.0, 0.0, 0.0, 0.01 };
+    filt.P = { 2.0, 0.5, 0.0, 0.5, 1.0, 0.0, 0.0, 0.0, 1.0 };
+    filt.H = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.5 };
+    filt.R = { 1.0, 0.3, 0.3, 2.0 };
+    filt.x = { 0.0, 1.0, 0.0 };
+    filt.u = { 1.0 };
+}
+
+static void
+measure(const int step, cfilt::Vector<2>& z)
+{
+    z = { 0.1 * step + 0.05 * std::sin(step), 1.0 + 0.1 * std::cos(step) };
+}
+
+int
+test_cfilt_hpp_kalman_filter(void)
+{
+    cfilt::KalmanFilter<3, 1, 2> filt;
+    init_model(filt);
+
+    cfilt_kalman_filter ref;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &ref, 3, 1, 2);
+    to_gsl(filt.F, ref.F);
+    to_gsl(filt.B, ref.B);
+    to_gsl(filt.Q, ref.Q);
+    to_gsl(filt.P, ref.P);
+    to_gsl(filt.H, ref.H);
+    to_gsl(filt.R, ref.R);
+    gsl_vector_set(ref.x, 1, 1.0);
+    gsl_vector_set(ref.u, 0, 1.0);
+
+    for (int step = 0; step < 5; ++step)
+    {
+        measure(step, filt.z);
+        for (std::size_t i = 0; i < 2; ++i)
+        {
+            gsl_vector_set(ref.z, i, filt.z[i]);
+        }
+
+        filt.predict();
+        UTEST_ASSERT(filt.update() == GSL_SUCCESS, "Update failed");
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &ref);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &ref);
+
+        UTEST_EXEC_ASSERT(cmp, filt.x, ref.x, 1e-12);
+        UTEST_EXEC_ASSERT(cmp, filt.P, ref.P, 1e-12);
+        UTEST_EXEC_ASSERT(cmp, filt.K, ref.K, 1e-12);
+    }
+
+    // Not positive definite, the filter is left untouched
+    const cfilt::Vector<3> x = filt.x;
+    filt.R = { -10.0, 0.0, 0.0, -10.0 };
+    filt.predict();
+    UTEST_ASSERT(filt.update() == GSL_EDOM, "Indefinite S went unnoticed");
+    UTEST_ASSERT(filt.x == x, "Failed update changed x");
+
+    cfilt_kalman_filter_free(&ref);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_hpp_gh_filter(void)
+{
+    cfilt::GHFilter<3> filt;
+    filt.gh = { 0.5, 0.4, 0.1 };
+
+    cfilt_gh_filter ref;
+    UTEST_EXEC_ASSERT(cfilt_gh_alloc, &ref, 3);
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        ref.gh[i] = filt.gh[i];
+    }
+
+    // Position every step, velocity every other step
+    const double dt = 0.5;
+    for (int step = 0; step < 6; ++step)
+    {
+        const double t = dt * step;
+        filt.write(t * t, 0);
+        cfilt_gh_write(&ref, t * t, 0);
+        if (step % 2)
+        {
+            filt.write(2.0 * t, 1);
+            cfilt_gh_write(&ref, 2.0 * t, 1);
+        }
+
+        filt.predict(dt);
+        filt.update(dt);
+        cfilt_gh_predict(&ref, dt);
+        cfilt_gh_update(&ref, dt);
+
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            UTEST_ASSERT(filt.x[i] == ref.x[i], "x[%zu] differs at step %d", i,
+                         step);
+            UTEST_ASSERT(filt.x_pred[i] == ref.x_pred[i],
+                         "x_pred[%zu] differs at step %d", i, step);
+        }
+    }
+
+    cfilt_gh_free(&ref);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_hpp_sigma(void)
+{
+    // The C generator offsets mu by the rows of the factor rather than its
+    // columns, both agree for a diagonal covariance
+    const double alpha = 0.5, beta = 2.0, kappa = 0.0;
+    cfilt::VanDerMerweSigma<3> gen(alpha, beta, kappa);
+    const cfilt::Vector<3> mu = { 1.0, -2.0, 0.5 };
+    const cfilt::Matrix<3, 3> cov = { 2.0, 0.0, 0.0, 0.0, 1.0,
+                                      0.0, 0.0, 0.0, 0.5 };
+    UTEST_EXEC_ASSERT(gen.generate, mu, cov);
+
+    cfilt_sigma_generator* ref;
+    gsl_vector* mu_ = gsl_vector_alloc(3);
+    gsl_matrix* cov_ = gsl_matrix_alloc(3, 3);
+    UTEST_EXEC_ASSERT(cfilt_sigma_generator_alloc, CFILT_SIGMA_VAN_DER_MERWE,
+                      &ref, 3, alpha, beta, kappa);
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        gsl_vector_set(mu_, i, mu[i]);
+    }
+
+    to_gsl(cov, cov_);
+    UTEST_EXEC_ASSERT(cfilt_sigma_generator_generate, ref, mu_, cov_);
+
+    UTEST_EXEC_ASSERT(cmp, gen.points, ref->points, 1e-12);
+    UTEST_EXEC_ASSERT(cmp, gen.mu_weights, ref->mu_weights, 1e-12);
+    UTEST_EXEC_ASSERT(cmp, gen.sigma_weights, ref->sigma_weights, 1e-12);
+
+    gsl_vector_free(mu_);
+    gsl_matrix_free(cov_);
+    cfilt_sigma_generator_free(ref);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_hpp_ukf(void)
+{
+    // The unscented transform is exact for linear f and h, so the UKF must
+    // follow the linear Kalman filter of the same model
+    cfilt::KalmanFilter<3, 1, 2> ref;
+    init_model(ref);
+
+    typedef cfilt::VanDerMerweSigma<3> Sigma;
+    cfilt::UKF<3, 2, Sigma> filt(Sigma(0.5, 2.0, 0.0));
+    filt.x = ref.x;
+    filt.P = ref.P;
+    filt.Q = ref.Q;
+    filt.R = ref.R;
+
+    const auto f = [&ref](const cfilt::Vector<3>& x, cfilt::Vector<3>& out) {
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            out[i] = ref.B[i] * ref.u[0];
+            for (std::size_t j = 0; j < 3; ++j)
+            {
+                out[i] += ref.F[i * 3 + j] * x[j];
+            }
+        }
+    };
+    const auto h = [&ref](const cfilt::Vector<3>& x, cfilt::Vector<2>& out) {
+        for (std::size_t i = 0; i < 2; ++i)
+        {
+            out[i] = 0.0;
+            for (std::size_t j = 0; j < 3; ++j)
+            {
+                out[i] += ref.H[i * 3 + j] * x[j];
+            }
+        }
+    };
+
+    for (int step = 0; step < 5; ++step)
+    {
+        measure(step, filt.z);
+        ref.z = filt.z;
+
+        ref.predict();
+        UTEST_ASSERT(ref.update() == GSL_SUCCESS, "Update failed");
+        UTEST_EXEC_ASSERT(filt.predict, f);
+        UTEST_EXEC_ASSERT(filt.update, h);
+
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            UTEST_ASSERT(std::fabs(filt.x[i] - ref.x[i]) < 1e-9,
+                         "x[%zu] differs at step %d", i, step);
+            for (std::size_t j = 0; j < 3; ++j)
+            {
+                UTEST_ASSERT(std::fabs(filt.P[i * 3 + j] - ref.P[i * 3 + j]) <
+                               1e-9,
+                             "P(%zu, %zu) differs at step %d", i, j, step);
+            }
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_hpp_kalman_filter);
+    RUN_TEST(test_cfilt_hpp_gh_filter);
+    RUN_TEST(test_cfilt_hpp_sigma);
+    RUN_TEST(test_cfilt_hpp_ukf);
+
+    return GSL_SUCCESS;
+}
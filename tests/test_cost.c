@@ -0,0 +1,150 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/cfilt.h"
+#include "cfilt/cost.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+
+#define T 37
+#define D 300
+
+int
+test_cfilt_cost_matrix(void)
+{
+    const double gate = 9.21; // 99% for 2 degrees of freedom
+
+    cfilt_cost_workspace w;
+    UTEST_EXEC_ASSERT(cfilt_cost_workspace_alloc, &w, 2, T);
+
+    cfilt_mahalanobis_workspace mw;
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_workspace_alloc, &mw, 2);
+
+    gsl_vector* mu[T];
+    gsl_matrix* S[T];
+    for (size_t i = 0; i < T; ++i)
+    {
+        mu[i] = gsl_vector_alloc(2);
+        S[i] = gsl_matrix_alloc(2, 2);
+
+        gsl_vector_set(mu[i], 0, 3.0 * (i % 7));
+        gsl_vector_set(mu[i], 1, 2.0 * (i / 7));
+        gsl_matrix_set(S[i], 0, 0, 0.5 + 0.1 * (i % 3));
+        gsl_matrix_set(S[i], 1, 1, 0.4 + 0.2 * (i % 4));
+        gsl_matrix_set(S[i], 0, 1, 0.1 * (i % 2));
+        gsl_matrix_set(S[i], 1, 0, 0.1 * (i % 2));
+    }
+
+    gsl_matrix* Z = gsl_matrix_alloc(D, 2);
+    for (size_t j = 0; j < D; ++j)
+    {
+        gsl_matrix_set(Z, j, 0, 0.07 * j);
+        gsl_matrix_set(Z, j, 1, 0.9 * ((j * 7) % 13));
+    }
+
+    gsl_matrix* cost = gsl_matrix_alloc(T, D);
+    UTEST_EXEC_ASSERT(cfilt_cost_matrix, &w, (const gsl_vector* const*)mu,
+                      (const gsl_matrix* const*)S, T, Z, gate, cost);
+
+    // Must match the pairwise distances, gated cells included
+    size_t gated = 0;
+    for (size_t i = 0; i < T; ++i)
+    {
+        for (size_t j = 0; j < D; ++j)
+        {
+            gsl_vector_view z = gsl_matrix_row(Z, j);
+
+            double distance;
+            UTEST_EXEC_ASSERT(cfilt_mahalanobis_ws, &z.vector, mu[i], S[i],
+                              &mw, &distance);
+
+            const double d2 = distance * distance;
+            const double c = gsl_matrix_get(cost, i, j);
+            if (d2 > gate)
+            {
+                UTEST_ASSERT(c == GSL_POSINF, "Cell (%zu, %zu) not gated", i,
+                             j);
+                ++gated;
+            }
+            else
+            {
+                UTEST_ASSERT(IS_EQ_TOL(c, d2, 1e-9),
+                             "Cell (%zu, %zu) : expected %f, got %f", i, j, d2,
+                             c);
+            }
+        }
+    }
+
+    UTEST_ASSERT(gated > 0 && gated < T * D, "Gate does not split the cells");
+
+    // Not positive definite, only its row is gated out
+    gsl_matrix* expected = gsl_matrix_alloc(T, D);
+    gsl_matrix_memcpy(expected, cost);
+    gsl_matrix_set(S[3], 1, 1, -1.0);
+    UTEST_EXEC_ASSERT(cfilt_cost_matrix, &w, (const gsl_vector* const*)mu,
+                      (const gsl_matrix* const*)S, T, Z, gate, cost);
+    for (size_t i = 0; i < T; ++i)
+    {
+        UTEST_ASSERT(w.status[i] == (i == 3 ? GSL_EDOM : GSL_SUCCESS),
+                     "Wrong status for track %zu", i);
+        for (size_t j = 0; j < D; ++j)
+        {
+            const double c = gsl_matrix_get(cost, i, j);
+            UTEST_ASSERT(i == 3 ? c == GSL_POSINF
+                                : c == gsl_matrix_get(expected, i, j),
+                         "Cell (%zu, %zu) changed", i, j);
+        }
+    }
+
+    // Pairs of tracks that were not factored
+    const size_t pairs[] = { 0, 0, T - 1, 0 };
+    double d2[2];
+    UTEST_EXEC_ASSERT(cfilt_cost_factor, &w, (const gsl_vector* const*)mu,
+                      (const gsl_matrix* const*)S, T - 1, gate);
+    UTEST_EXEC_ASSERT(cfilt_cost_pairs, &w, Z, pairs, 1, gate, d2);
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_cost_pairs, &w, Z, pairs, 2, gate, d2);
+    UTEST_EXEC_ASSERT_(cfilt_cost_fill, &w, T, Z, gate, cost);
+    gsl_set_error_handler(hdl);
+    gsl_matrix_free(expected);
+
+    for (size_t i = 0; i < T; ++i)
+    {
+        gsl_vector_free(mu[i]);
+        gsl_matrix_free(S[i]);
+    }
+
+    gsl_matrix_free(Z);
+    gsl_matrix_free(cost);
+    cfilt_mahalanobis_workspace_free(&mw);
+    cfilt_cost_workspace_free(&w);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_cost_matrix);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/discretize.h"
+#include "cfilt/dt_cache.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+
+#include <math.h>
+
+// Continuous model of a chain of n integrators with a maneuver rate on the
+// last one, noise on the last one
+static void
+chain(gsl_matrix* A, gsl_matrix* G, gsl_matrix* Qc, const double alpha,
+      const double q)
+{
+    const size_t n = A->size1;
+    gsl_matrix_set_zero(A);
+    for (size_t i = 0; i + 1 < n; ++i)
+    {
+        gsl_matrix_set(A, i, i + 1, 1.0);
+    }
+
+    gsl_matrix_set(A, n - 1, n - 1, -alpha);
+    gsl_matrix_set_zero(G);
+    gsl_matrix_set(G, n - 1, 0, 1.0);
+    gsl_matrix_set(Qc, 0, 0, q);
+}
+
+// Largest entry of a
+static double
+max_abs(const gsl_matrix* a)
+{
+    double m = 0.0;
+    for (size_t i = 0; i < a->size1; ++i)
+    {
+        for (size_t j = 0; j < a->size2; ++j)
+        {
+            m = fmax(m, fabs(gsl_matrix_get(a, i, j)));
+        }
+    }
+
+    return m;
+}
+
+// Closed form against Van Loan
+static int
+check_closed_form(const size_t n, const double alpha, const double q,
+                  const double dt, const double tol)
+{
+    cfilt_discretize_workspace w;
+    UTEST_EXEC_ASSERT(cfilt_discretize_workspace_alloc, &w, n, 1);
+
+    gsl_matrix* A = gsl_matrix_alloc(n, n);
+    gsl_matrix* G = gsl_matrix_alloc(n, 1);
+    gsl_matrix* Qc = gsl_matrix_alloc(1, 1);
+    gsl_matrix* F = gsl_matrix_alloc(n, n);
+    gsl_matrix* Q = gsl_matrix_alloc(n, n);
+    gsl_matrix* F_ = gsl_matrix_alloc(n, n);
+    gsl_matrix* Q_ = gsl_matrix_alloc(n, n);
+
+    chain(A, G, Qc, alpha, q);
+    UTEST_EXEC_ASSERT(cfilt_discretize_van_loan, A, G, Qc, dt, F_, Q_, &w);
+    if (alpha == 0.0 && n != 3)
+    {
+        UTEST_EXEC_ASSERT(cfilt_discretize_integrator, q, dt, F, Q);
+    }
+    else
+    {
+        UTEST_EXEC_ASSERT(cfilt_discretize_singer, alpha, q, dt, F, Q);
+    }
+
+    // Relative to the largest term
+    const double tol_F = tol * max_abs(F_);
+    const double tol_Q = tol * max_abs(Q_);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < n; ++j)
+        {
+            const double dF =
+              gsl_matrix_get(F, i, j) - gsl_matrix_get(F_, i, j);
+            const double dQ =
+              gsl_matrix_get(Q, i, j) - gsl_matrix_get(Q_, i, j);
+            UTEST_ASSERT(fabs(dF) <= tol_F, "F(%zu, %zu) off by %g", i, j, dF);
+            UTEST_ASSERT(fabs(dQ) <= tol_Q, "Q(%zu, %zu) off by %g", i, j, dQ);
+        }
+    }
+
+    gsl_matrix_free(A);
+    gsl_matrix_free(G);
+    gsl_matrix_free(Qc);
+    gsl_matrix_free(F);
+    gsl_matrix_free(Q);
+    gsl_matrix_free(F_);
+    gsl_matrix_free(Q_);
+    cfilt_discretize_workspace_free(&w);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_discretize_closed_forms(void)
+{
+    // Random walk, constant velocity and acceleration
+    UTEST_EXEC_ASSERT(check_closed_form, 1, 0.0, 0.3, 0.1, 1e-12);
+    UTEST_EXEC_ASSERT(check_closed_form, 2, 0.0, 0.3, 0.1, 1e-12);
+    UTEST_EXEC_ASSERT(check_closed_form, 2, 0.0, 2.0, 7.5, 1e-12);
+    UTEST_EXEC_ASSERT(check_closed_form, 4, 0.0, 2.0, 1.5, 1e-12);
+
+    // Singer through its series, its exponentials and as constant
+    // acceleration
+    UTEST_EXEC_ASSERT(check_closed_form, 3, 1e-4, 0.5, 0.2, 1e-12);
+    UTEST_EXEC_ASSERT(check_closed_form, 3, 0.5, 0.5, 1.0, 1e-12);
+    UTEST_EXEC_ASSERT(check_closed_form, 3, 0.9, 0.5, 1.1, 1e-12);
+    UTEST_EXEC_ASSERT(check_closed_form, 3, 2.0, 0.5, 1.5, 1e-12);
+    UTEST_EXEC_ASSERT(check_closed_form, 3, 0.0, 0.5, 1.5, 1e-12);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_discretize_van_loan(void)
+{
+    // Harmonic oscillator over many periods, F is a rotation
+    cfilt_discretize_workspace w;
+    UTEST_EXEC_ASSERT(cfilt_discretize_workspace_alloc, &w, 2, 1);
+
+    gsl_matrix* A = gsl_matrix_alloc(2, 2);
+    gsl_matrix* G = gsl_matrix_alloc(2, 1);
+    gsl_matrix* Qc = gsl_matrix_alloc(1, 1);
+    gsl_matrix* F = gsl_matrix_alloc(2, 2);
+    gsl_matrix* Q = gsl_matrix_alloc(2, 2);
+
+    gsl_matrix_set_zero(A);
+    gsl_matrix_set(A, 0, 1, 1.0);
+    gsl_matrix_set(A, 1, 0, -1.0);
+    gsl_matrix_set_zero(G);
+    gsl_matrix_set(G, 1, 0, 1.0);
+    gsl_matrix_set(Qc, 0, 0, 1.0);
+
+    const size_t allocs = cfilt_allocator_get()->allocs;
+    const double dt = 20.0;
+    UTEST_EXEC_ASSERT(cfilt_discretize_van_loan, A, G, Qc, dt, F, Q, &w);
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs, "Van Loan allocated");
+
+    const double c = cos(dt), s = sin(dt);
+    UTEST_ASSERT(fabs(gsl_matrix_get(F, 0, 0) - c) < 1e-12, "F(0, 0)");
+    UTEST_ASSERT(fabs(gsl_matrix_get(F, 0, 1) - s) < 1e-12, "F(0, 1)");
+    UTEST_ASSERT(fabs(gsl_matrix_get(F, 1, 0) + s) < 1e-12, "F(1, 0)");
+    UTEST_ASSERT(fabs(gsl_matrix_get(F, 1, 1) - c) < 1e-12, "F(1, 1)");
+
+    // Q = int_0^dt [sin^2 s, sin s cos s; sin s cos s, cos^2 s] ds
+    UTEST_ASSERT(fabs(gsl_matrix_get(Q, 0, 0) - (dt - s * c) / 2) < 1e-11,
+                 "Q(0, 0)");
+    UTEST_ASSERT(fabs(gsl_matrix_get(Q, 0, 1) - s * s / 2) < 1e-11, "Q(0, 1)");
+    UTEST_ASSERT(fabs(gsl_matrix_get(Q, 1, 0) - s * s / 2) < 1e-11, "Q(1, 0)");
+    UTEST_ASSERT(fabs(gsl_matrix_get(Q, 1, 1) - (dt + s * c) / 2) < 1e-11,
+                 "Q(1, 1)");
+
+    // Through the cache
+    cfilt_discretize_model model = { A, G, Qc, &w };
+    cfilt_dt_cache cache;
+    gsl_matrix* F_ = gsl_matrix_alloc(2, 2);
+    UTEST_EXEC_ASSERT(cfilt_dt_cache_alloc, &cache, 2, 2, 0.0,
+                      cfilt_discretize_build, &model);
+    UTEST_EXEC_ASSERT(cfilt_dt_cache_get, &cache, dt, F_, NULL);
+    UTEST_EXEC_ASSERT(cfilt_dt_cache_get, &cache, dt, F_, NULL);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, F_, F, 0.0);
+    UTEST_ASSERT(cache.misses == 1, "Discretized twice");
+
+    gsl_matrix_free(F_);
+    cfilt_dt_cache_free(&cache);
+    gsl_matrix_free(A);
+    gsl_matrix_free(G);
+    gsl_matrix_free(Qc);
+    gsl_matrix_free(F);
+    gsl_matrix_free(Q);
+    cfilt_discretize_workspace_free(&w);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_discretize_closed_forms);
+    RUN_TEST(test_cfilt_discretize_van_loan);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,174 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/dt_cache.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+
+typedef struct
+{
+    double q;
+    size_t builds;
+} cv_model;
+
+// Constant velocity with white noise acceleration, negative time steps fail
+static int
+cv_build(const double dt, gsl_matrix* F, gsl_matrix* Q, void* ctx)
+{
+    cv_model* model = ctx;
+    ++model->builds;
+    if (dt < 0.0)
+    {
+        return GSL_EDOM;
+    }
+
+    gsl_matrix_set_identity(F);
+    gsl_matrix_set(F, 0, 1, dt);
+
+    gsl_matrix_set(Q, 0, 0, model->q * dt * dt * dt / 3.0);
+    gsl_matrix_set(Q, 0, 1, model->q * dt * dt / 2.0);
+    gsl_matrix_set(Q, 1, 0, model->q * dt * dt / 2.0);
+    gsl_matrix_set(Q, 1, 1, model->q * dt);
+
+    return GSL_SUCCESS;
+}
+
+static int
+check(cfilt_dt_cache* cache, cv_model* model, const double dt,
+      const double dt_model, const size_t builds)
+{
+    gsl_matrix* F = gsl_matrix_alloc(2, 2);
+    gsl_matrix* Q = gsl_matrix_alloc(2, 2);
+    gsl_matrix* F_ = gsl_matrix_alloc(2, 2);
+    gsl_matrix* Q_ = gsl_matrix_alloc(2, 2);
+
+    UTEST_EXEC_ASSERT(cfilt_dt_cache_get, cache, dt, F, Q);
+    UTEST_ASSERT(model->builds == builds, "%zu builds instead of %zu",
+                 model->builds, builds);
+
+    cv_model expected = *model;
+    UTEST_EXEC_ASSERT(cv_build, dt_model, F_, Q_, &expected);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, F, F_, 0.0);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, Q, Q_, 0.0);
+
+    gsl_matrix_free(F);
+    gsl_matrix_free(Q);
+    gsl_matrix_free(F_);
+    gsl_matrix_free(Q_);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_dt_cache_lru(void)
+{
+    cv_model model = { 0.5, 0 };
+    cfilt_dt_cache cache;
+    UTEST_EXEC_ASSERT(cfilt_dt_cache_alloc, &cache, 2, 2, 0.0, cv_build,
+                      &model);
+
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.1, 0.1, 1);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.1, 0.1, 1);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.2, 0.2, 2);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.1, 0.1, 2);
+
+    // 0.2 is the least recently used
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.3, 0.3, 3);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.1, 0.1, 3);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.2, 0.2, 4);
+    UTEST_ASSERT(cache.hits == 3 && cache.misses == 4,
+                 "%zu hits and %zu misses", cache.hits, cache.misses);
+
+    // A failed build evicts without taking the entry
+    gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_dt_cache_get, &cache, -1.0, NULL, NULL);
+    UTEST_EXEC_ASSERT_(cfilt_dt_cache_get, &cache, -1.0, NULL, NULL);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.2, 0.2, 6);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.3, 0.3, 7);
+
+    cfilt_dt_cache_clear(&cache);
+    UTEST_EXEC_ASSERT(check, &cache, &model, 0.2, 0.2, 8);
+
+    cfilt_dt_cache_free(&cache);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_dt_cache_predict(void)
+{
+    cv_model model = { 0.5, 0 };
+    cfilt_dt_cache cache;
+    cfilt_kalman_filter filt, ref;
+    UTEST_EXEC_ASSERT(cfilt_dt_cache_alloc, &cache, 2, 4, 1e-3, cv_build,
+                      &model);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 2, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &ref, 2, 1, 1);
+
+    gsl_matrix_set_zero(filt.B);
+    gsl_matrix_set_identity(filt.P);
+    gsl_vector_set(filt.x, 0, 1.0);
+    gsl_vector_set(filt.x, 1, 2.0);
+    gsl_vector_set_zero(filt.u);
+    gsl_matrix_memcpy(ref.B, filt.B);
+    gsl_matrix_memcpy(ref.P, filt.P);
+    gsl_vector_memcpy(ref.x, filt.x);
+    gsl_vector_memcpy(ref.u, filt.u);
+
+    // Jitter under half a quantum shares the entry of the rounded time step
+    const double dts[] = { 0.1, 0.1002, 0.0996, 0.05, 0.1004, 0.0501 };
+    const double rounded[] = { 0.1, 0.1, 0.1, 0.05, 0.1, 0.05 };
+    const size_t allocs = cfilt_allocator_get()->allocs;
+    for (size_t i = 0; i < sizeof(dts) / sizeof(dts[0]); ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_dt_cache_predict, &cache, &filt, dts[i]);
+        gsl_vector_memcpy(filt.x, filt.x_);
+        gsl_matrix_memcpy(filt.P, filt.P_);
+
+        cv_model expected = model;
+        UTEST_EXEC_ASSERT(cv_build, 1e-3 * (size_t)(rounded[i] * 1e3 + 0.5),
+                          ref.F, ref.Q, &expected);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &ref);
+        gsl_vector_memcpy(ref.x, ref.x_);
+        gsl_matrix_memcpy(ref.P, ref.P_);
+
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, filt.x, ref.x, 0.0);
+        UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.P, ref.P, 0.0);
+    }
+
+    UTEST_ASSERT(model.builds == 2, "%zu builds instead of 2", model.builds);
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs, "Cache allocated");
+
+    cfilt_kalman_filter_free(&filt);
+    cfilt_kalman_filter_free(&ref);
+    cfilt_dt_cache_free(&cache);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_dt_cache_lru);
+    RUN_TEST(test_cfilt_dt_cache_predict);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/fixed_lag.h"
+#include "cfilt/rts.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+
+#define STEPS 30
+#define LAG 4
+
+static void
+init_filter(cfilt_kalman_filter* filt)
+{
+    gsl_matrix_set_identity(filt->F);
+    gsl_matrix_set_zero(filt->B);
+    gsl_matrix_set_identity(filt->Q);
+    gsl_matrix_scale(filt->Q, 0.01);
+    gsl_matrix_set_identity(filt->P);
+    gsl_matrix_set_zero(filt->H);
+    gsl_matrix_set(filt->H, 0, 0, 1.0);
+    gsl_matrix_set_identity(filt->R);
+    gsl_vector_set_zero(filt->x);
+    gsl_vector_set_zero(filt->u);
+}
+
+// Step t of the run, the time step changes every 10 steps and there is no
+// measurement at t = 12
+static int
+step(cfilt_kalman_filter* filt, const size_t t)
+{
+    gsl_matrix_set(filt->F, 0, 1, 0.1 * (1 + t / 10));
+    gsl_matrix_set(filt->F, 1, 2, 0.1 * (1 + t / 10));
+    gsl_vector_set(filt->z, 0, 0.05 * t * t + (t % 3 ? 0.2 : -0.3));
+
+    EXEC_ASSERT(cfilt_kalman_filter_predict, filt);
+    if (t != 12)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_update, filt);
+    }
+
+    return GSL_SUCCESS;
+}
+
+// Fixed interval smoother over steps [0, last]
+static int
+reference(cfilt_kalman_filter* filt, cfilt_rts* rts, const size_t last)
+{
+    init_filter(filt);
+    cfilt_rts_reset(rts);
+    for (size_t t = 0; t <= last; ++t)
+    {
+        EXEC_ASSERT(step, filt, t);
+        EXEC_ASSERT(cfilt_rts_record, rts, filt);
+    }
+
+    return cfilt_rts_smooth(rts);
+}
+
+static int
+test_cfilt_fixed_lag_(const size_t stride,
+                      const cfilt_kalman_covariance_mode cov_mode)
+{
+    cfilt_kalman_filter filt, ref;
+    cfilt_rts rts;
+    cfilt_fixed_lag fl;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &ref, 3, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_rts_alloc, &rts, 3, STEPS, 1, NULL);
+    UTEST_EXEC_ASSERT(cfilt_fixed_lag_alloc, &fl, 3, LAG, stride);
+    gsl_vector* x = gsl_vector_alloc(3);
+    gsl_matrix* P = gsl_matrix_alloc(3, 3);
+
+    init_filter(&filt);
+    filt.cov_mode = cov_mode;
+
+    const size_t allocs = cfilt_allocator_get()->allocs;
+    size_t next = 0;
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        UTEST_EXEC_ASSERT(step, &filt, t);
+        UTEST_EXEC_ASSERT(cfilt_fixed_lag_push, &fl, &filt);
+        if (fl.ready == 0)
+        {
+            continue;
+        }
+
+        // Estimates come out in order, each smoothed over at least LAG steps
+        UTEST_ASSERT(fl.ready == stride && fl.first == next,
+                     "Unexpected batch");
+        UTEST_ASSERT(t + 1 - stride == fl.first + LAG, "Unexpected lag");
+        next += stride;
+
+        UTEST_EXEC_ASSERT(reference, &ref, &rts, t);
+        for (size_t i = 0; i < stride; ++i)
+        {
+            gsl_vector_view xs = gsl_matrix_row(fl.xs, i);
+            gsl_matrix_view Ps = gsl_matrix_submatrix(fl.Ps, i * 3, 0, 3, 3);
+            UTEST_EXEC_ASSERT(cfilt_rts_get, &rts, fl.first + i, x, P);
+            UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, &xs.vector, x, 1e-9);
+            UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, &Ps.matrix, P, 1e-9);
+        }
+    }
+
+    UTEST_ASSERT(next == STEPS - LAG - (STEPS - LAG) % stride,
+                 "Missing estimates");
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs,
+                 "Smoother allocated");
+
+    gsl_vector_free(x);
+    gsl_matrix_free(P);
+    cfilt_fixed_lag_free(&fl);
+    cfilt_rts_free(&rts);
+    cfilt_kalman_filter_free(&ref);
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_fixed_lag(void)
+{
+    return test_cfilt_fixed_lag_(1, CFILT_KALMAN_COVARIANCE_FULL);
+}
+
+int
+test_cfilt_fixed_lag_stride(void)
+{
+    return test_cfilt_fixed_lag_(4, CFILT_KALMAN_COVARIANCE_LOWER);
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_fixed_lag);
+    RUN_TEST(test_cfilt_fixed_lag_stride);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,254 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/cost.h"
+#include "cfilt/grid.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define T 200
+#define D 400
+
+static double
+uniform(const double lo, const double hi)
+{
+    return lo + (hi - lo) * rand() / RAND_MAX;
+}
+
+// Candidates must be exactly the pairs inside of the boxes, each once
+static int
+check_pairs(const size_t* pairs, const size_t count, const double* center,
+            const double* radius, const int* live, const gsl_matrix* Z)
+{
+    static unsigned char seen[T][D];
+    memset(seen, 0, sizeof(seen));
+
+    for (size_t p = 0; p < count; ++p)
+    {
+        const size_t i = pairs[2 * p];
+        const size_t j = pairs[2 * p + 1];
+        UTEST_ASSERT(!seen[i][j], "Pair (%zu, %zu) repeated", i, j);
+        seen[i][j] = 1;
+    }
+
+    for (size_t i = 0; i < T; ++i)
+    {
+        for (size_t j = 0; j < D; ++j)
+        {
+            const int inside =
+              live[i] &&
+              fabs(gsl_matrix_get(Z, j, 0) - center[2 * i]) <=
+                radius[2 * i] &&
+              fabs(gsl_matrix_get(Z, j, 1) - center[2 * i + 1]) <=
+                radius[2 * i + 1];
+            UTEST_ASSERT(inside == seen[i][j], "Pair (%zu, %zu) %s", i, j,
+                         inside ? "missed" : "spurious");
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_grid_query(void)
+{
+    srand(7);
+
+    cfilt_grid g;
+    UTEST_EXEC_ASSERT(cfilt_grid_alloc, &g, 2, T, 9, 4.0);
+
+    double center[2 * T];
+    double radius[2 * T];
+    int live[T];
+    for (size_t i = 0; i < T; ++i)
+    {
+        center[2 * i] = uniform(0.0, 100.0);
+        center[2 * i + 1] = uniform(-50.0, 50.0);
+        radius[2 * i] = uniform(0.5, 3.0);
+        radius[2 * i + 1] = i % 50 ? uniform(0.5, 3.0) : 40.0;
+        live[i] = 1;
+        UTEST_EXEC_ASSERT(cfilt_grid_update, &g, i, center + 2 * i,
+                          radius + 2 * i);
+    }
+
+    UTEST_ASSERT(g._big_count == T / 50, "%zu oversized tracks",
+                 g._big_count);
+
+    gsl_matrix* Z = gsl_matrix_alloc(D, 2);
+    const size_t max_pairs = T * D;
+    size_t* pairs = malloc(2 * max_pairs * sizeof(size_t));
+    const size_t allocs = cfilt_allocator_get()->allocs;
+
+    for (size_t t = 0; t < 10; ++t)
+    {
+        for (size_t j = 0; j < D; ++j)
+        {
+            gsl_matrix_set(Z, j, 0, uniform(-5.0, 105.0));
+            gsl_matrix_set(Z, j, 1, uniform(-55.0, 55.0));
+        }
+
+        size_t count;
+        UTEST_EXEC_ASSERT(cfilt_grid_query, &g, Z, pairs, max_pairs, &count);
+        UTEST_ASSERT(count > 0, "No candidates at t = %zu", t);
+        UTEST_EXEC_ASSERT(check_pairs, pairs, count, center, radius, live, Z);
+
+        // Drift, a few jumps, growing and shrinking boxes, removals
+        for (size_t i = 0; i < T; ++i)
+        {
+            if ((i + t) % 23 == 0)
+            {
+                live[i] = !live[i];
+                if (!live[i])
+                {
+                    cfilt_grid_remove(&g, i);
+                    continue;
+                }
+            }
+
+            if (!live[i])
+            {
+                continue;
+            }
+
+            center[2 * i] += i % 11 ? 0.3 : uniform(-30.0, 30.0);
+            center[2 * i + 1] -= 0.2;
+            radius[2 * i] = i % 7 ? radius[2 * i] : uniform(0.5, 6.0);
+            UTEST_EXEC_ASSERT(cfilt_grid_update, &g, i, center + 2 * i,
+                              radius + 2 * i);
+        }
+    }
+
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs,
+                 "Grid updates allocated");
+
+    size_t count;
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_grid_query, &g, Z, pairs, 1, &count);
+    gsl_set_error_handler(hdl);
+
+    free(pairs);
+    gsl_matrix_free(Z);
+    cfilt_grid_free(&g);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_grid_cost_pairs(void)
+{
+    const double gate = 9.21;
+
+    cfilt_cost_workspace w;
+    cfilt_grid g;
+    UTEST_EXEC_ASSERT(cfilt_cost_workspace_alloc, &w, 2, T);
+    UTEST_EXEC_ASSERT(cfilt_grid_alloc, &g, 2, T, 16, 3.0);
+
+    gsl_vector* mu[T];
+    gsl_matrix* S[T];
+    for (size_t i = 0; i < T; ++i)
+    {
+        mu[i] = gsl_vector_alloc(2);
+        S[i] = gsl_matrix_alloc(2, 2);
+
+        gsl_vector_set(mu[i], 0, uniform(0.0, 100.0));
+        gsl_vector_set(mu[i], 1, uniform(0.0, 100.0));
+        gsl_matrix_set(S[i], 0, 0, uniform(0.2, 1.0));
+        gsl_matrix_set(S[i], 1, 1, uniform(0.2, 1.0));
+        gsl_matrix_set(S[i], 0, 1, 0.1);
+        gsl_matrix_set(S[i], 1, 0, 0.1);
+    }
+
+    gsl_matrix* Z = gsl_matrix_alloc(D, 2);
+    for (size_t j = 0; j < D; ++j)
+    {
+        gsl_matrix_set(Z, j, 0, uniform(0.0, 100.0));
+        gsl_matrix_set(Z, j, 1, uniform(0.0, 100.0));
+    }
+
+    gsl_matrix* cost = gsl_matrix_alloc(T, D);
+    UTEST_EXEC_ASSERT(cfilt_cost_matrix, &w, (const gsl_vector* const*)mu,
+                      (const gsl_matrix* const*)S, T, Z, gate, cost);
+
+    for (size_t i = 0; i < T; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_grid_update, &g, i, w.mu + 2 * i,
+                          w.radius + 2 * i);
+    }
+
+    const size_t max_pairs = 8 * D;
+    size_t* pairs = malloc(2 * max_pairs * sizeof(size_t));
+    double* d2 = malloc(max_pairs * sizeof(double));
+
+    size_t count;
+    UTEST_EXEC_ASSERT(cfilt_grid_query, &g, Z, pairs, max_pairs, &count);
+    UTEST_EXEC_ASSERT(cfilt_cost_pairs, &w, Z, pairs, count, gate, d2);
+
+    // Every gated cell is among the candidates with the same distance
+    size_t gated = 0;
+    for (size_t p = 0; p < count; ++p)
+    {
+        const double c = gsl_matrix_get(cost, pairs[2 * p], pairs[2 * p + 1]);
+        UTEST_ASSERT(c == d2[p], "Pair %zu : expected %f, got %f", p, c,
+                     d2[p]);
+        gated += c != GSL_POSINF;
+    }
+
+    size_t cells = 0;
+    for (size_t i = 0; i < T; ++i)
+    {
+        for (size_t j = 0; j < D; ++j)
+        {
+            cells += gsl_matrix_get(cost, i, j) != GSL_POSINF;
+        }
+    }
+
+    UTEST_ASSERT(cells > 0 && gated == cells, "%zu of %zu cells found", gated,
+                 cells);
+    UTEST_ASSERT(count < T * D / 20, "%zu candidates", count);
+
+    for (size_t i = 0; i < T; ++i)
+    {
+        gsl_vector_free(mu[i]);
+        gsl_matrix_free(S[i]);
+    }
+
+    free(pairs);
+    free(d2);
+    gsl_matrix_free(Z);
+    gsl_matrix_free(cost);
+    cfilt_grid_free(&g);
+    cfilt_cost_workspace_free(&w);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_grid_query);
+    RUN_TEST(test_cfilt_grid_cost_pairs);
+
+    return GSL_SUCCESS;
+}
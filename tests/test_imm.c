@@ -0,0 +1,152 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/imm.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+
+// Constant velocity on a line, state (p, v), position measured
+static void
+init_model(cfilt_kalman_filter* filt, const double q)
+{
+    gsl_matrix_set_identity(filt->F);
+    gsl_matrix_set(filt->F, 0, 1, 1.0);
+    gsl_matrix_set_zero(filt->B);
+    gsl_matrix_set_zero(filt->Q);
+    gsl_matrix_set(filt->Q, 0, 0, q / 4);
+    gsl_matrix_set(filt->Q, 1, 1, q);
+    gsl_matrix_set_identity(filt->P);
+    gsl_matrix_scale(filt->P, 10.0);
+    gsl_matrix_set_zero(filt->H);
+    gsl_matrix_set(filt->H, 0, 0, 1.0);
+    gsl_matrix_set_identity(filt->R);
+    gsl_matrix_scale(filt->R, 0.01);
+    gsl_vector_set_zero(filt->x);
+    gsl_vector_set_zero(filt->u);
+}
+
+int
+test_cfilt_imm_single(void)
+{
+    // One model is a plain kalman filter
+    cfilt_imm imm;
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_imm_alloc, &imm, 1, 2, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 2, 1, 1);
+    init_model(&imm.models[0], 0.1);
+    init_model(&filt, 0.1);
+
+    for (size_t t = 0; t < 10; ++t)
+    {
+        const double z = 0.5 * t + (t % 2 ? 0.1 : -0.1);
+        gsl_vector_set(imm.z, 0, z);
+        gsl_vector_set(filt.z, 0, z);
+
+        UTEST_EXEC_ASSERT(cfilt_imm_predict, &imm);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+
+        // log N(z; Hx_, HP_H^T + R)
+        const double s = gsl_matrix_get(filt.P_, 0, 0) + 0.01;
+        const double y = z - gsl_vector_get(filt.x_, 0);
+        const double ll = -0.5 * (y * y / s + log(s) + log(2.0 * M_PI));
+
+        UTEST_EXEC_ASSERT(cfilt_imm_update, &imm);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, imm.x, filt.x, 1e-12);
+        UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, imm.P, filt.P, 1e-12);
+        UTEST_ASSERT(IS_EQ_TOL(imm.log_likelihood, ll, 1e-9),
+                     "Wrong likelihood %f instead of %f", imm.log_likelihood,
+                     ll);
+        UTEST_ASSERT(IS_EQ_TOL(gsl_vector_get(imm.mu, 0), 1.0, 1e-12),
+                     "Wrong model probability");
+    }
+
+    // A model that would freeze its gain is refused
+    imm.models[0].freeze_window = 3;
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_imm_predict, &imm);
+    gsl_set_error_handler(hdl);
+
+    cfilt_kalman_filter_free(&filt);
+    cfilt_imm_free(&imm);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_imm_maneuver(void)
+{
+    // Quiet and maneuvering models, the target turns around at t = 20
+    cfilt_imm imm;
+    UTEST_EXEC_ASSERT(cfilt_imm_alloc, &imm, 2, 2, 1, 1);
+    init_model(&imm.models[0], 1e-4);
+    init_model(&imm.models[1], 1.0);
+
+    const size_t allocs = cfilt_allocator_get()->allocs;
+
+    double p = 0.0;
+    for (size_t t = 1; t <= 40; ++t)
+    {
+        p += t <= 20 ? 1.0 : -2.0;
+        gsl_vector_set(imm.z, 0, p);
+
+        UTEST_EXEC_ASSERT(cfilt_imm_predict, &imm);
+        UTEST_EXEC_ASSERT(cfilt_imm_update, &imm);
+
+        const double mu = gsl_vector_get(imm.mu, 0);
+        const double sum = mu + gsl_vector_get(imm.mu, 1);
+        UTEST_ASSERT(IS_EQ_TOL(sum, 1.0, 1e-12), "Probabilities sum to %f",
+                     sum);
+
+        if (t == 20)
+        {
+            UTEST_ASSERT(mu > 0.8, "Quiet model at %f before the turn", mu);
+        }
+        else if (t == 22)
+        {
+            UTEST_ASSERT(mu < 0.2, "Quiet model at %f after the turn", mu);
+        }
+    }
+
+    UTEST_ASSERT(IS_EQ_TOL(gsl_vector_get(imm.x, 1), -2.0, 1e-2),
+                 "Wrong velocity %f", gsl_vector_get(imm.x, 1));
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs, "IMM steps allocated");
+
+    // Model estimates are contiguous
+    UTEST_ASSERT(imm.models[1].x->data == imm.models[0].x->data + 2 &&
+                   imm.models[1].P->data == imm.models[0].P->data + 4,
+                 "Model estimates are not contiguous");
+
+    cfilt_imm_free(&imm);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_imm_single);
+    RUN_TEST(test_cfilt_imm_maneuver);
+
+    return GSL_SUCCESS;
+}
@@ -17,10 +17,15 @@
  * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "cfilt/cfilt.h"
 #include "cfilt/kalman.h"
 #include "utest.h"
 
+#include <gsl/gsl_blas.h>
 #include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+
+#include <stdint.h>
 
 int
 test_cfilt_kalman_filter_alloc(void)
@@ -31,7 +36,23 @@ test_cfilt_kalman_filter_alloc(void)
     UTEST_EXEC_ASSERT_(cfilt_kalman_filter_alloc, &filt, 0, 3, 3);
     gsl_set_error_handler(hdl);
 
-    cfilt_kalman_filter_alloc(&filt, 3, 3, 3);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 2, 4);
+
+    // Every array of the arena starts on its own cache line
+    const double* data[] = { filt.F->data, filt.B->data, filt.P->data,
+                             filt.H->data, filt.R->data, filt.K->data,
+                             filt.x->data, filt.u->data, filt.z->data };
+    for (size_t i = 0; i < sizeof(data) / sizeof(data[0]); ++i)
+    {
+        UTEST_ASSERT((uintptr_t)data[i] % 64 == 0, "array %zu misaligned", i);
+    }
+
+    UTEST_ASSERT(filt.B->size1 == 3 && filt.B->size2 == 2 &&
+                   filt.B->tda == 2,
+                 "B has the wrong shape");
+    UTEST_ASSERT(filt.H->size1 == 4 && filt.z->size == 4,
+                 "H or z has the wrong shape");
+
     cfilt_kalman_filter_free(&filt);
 
     return GSL_SUCCESS;
@@ -79,12 +100,528 @@ test_cfilt_kalman_filter_update(void)
     return GSL_SUCCESS;
 }
 
+int
+test_cfilt_kalman_filter_gain(void)
+{
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 3, 3);
+
+    gsl_matrix* expected = gsl_matrix_alloc(3, 3);
+    gsl_matrix_set_identity(filt.H);
+    gsl_matrix_set_identity(filt.P_);
+    gsl_vector_set_zero(filt.x_);
+    gsl_vector_set_zero(filt.z);
+
+    // S = 2I is positive definite, K comes from the cholesky solve
+    gsl_matrix_set_identity(filt.R);
+    gsl_matrix_set_identity(expected);
+    gsl_matrix_scale(expected, 0.5);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.K, expected, 1e-12);
+
+    // S = -2I is not, K comes from the LU fallback
+    gsl_matrix_set_identity(filt.R);
+    gsl_matrix_scale(filt.R, -3.0);
+    gsl_matrix_scale(expected, -1.0);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.K, expected, 1e-12);
+
+    gsl_matrix_free(expected);
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+static void
+init_filter(cfilt_kalman_filter* filt)
+{
+    gsl_matrix_set_identity(filt->F);
+    gsl_matrix_set(filt->F, 0, 1, 0.1);
+    gsl_matrix_set(filt->F, 1, 2, 0.1);
+    gsl_matrix_set_zero(filt->B);
+    gsl_matrix_set_identity(filt->Q);
+    gsl_matrix_scale(filt->Q, 0.01);
+    gsl_matrix_set_identity(filt->P);
+    gsl_matrix_set_zero(filt->H);
+    gsl_matrix_set(filt->H, 0, 0, 1.0);
+    gsl_matrix_set(filt->H, 1, 1, 1.0);
+    gsl_matrix_set_identity(filt->R);
+
+    gsl_vector_set_zero(filt->x);
+    gsl_vector_set_zero(filt->u);
+    gsl_vector_set(filt->z, 0, 1.0);
+    gsl_vector_set(filt->z, 1, 0.5);
+}
+
+static int
+test_cfilt_kalman_filter_covariance_lower_(cfilt_kalman_update_mode mode)
+{
+    cfilt_kalman_filter full, lower;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &full, 3, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &lower, 3, 1, 2);
+
+    init_filter(&full);
+    init_filter(&lower);
+    full.update_mode = mode;
+    lower.update_mode = mode;
+    lower.cov_mode = CFILT_KALMAN_COVARIANCE_LOWER;
+
+    // The upper triangle must never be read
+    gsl_matrix_set(lower.P, 0, 2, NAN);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &full);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &full);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &lower);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &lower);
+    }
+
+    UTEST_EXEC_ASSERT(cfilt_matrix_symmetrize, lower.P, 0);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, full.P, lower.P, 1e-9);
+    UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, full.x, lower.x, 1e-9);
+
+    cfilt_kalman_filter_free(&full);
+    cfilt_kalman_filter_free(&lower);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_filter_covariance_lower(void)
+{
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_covariance_lower_,
+                      CFILT_KALMAN_UPDATE_JOINT);
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_covariance_lower_,
+                      CFILT_KALMAN_UPDATE_SEQUENTIAL);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_filter_update_sequential(void)
+{
+    cfilt_kalman_filter joint, seq;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &joint, 3, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &seq, 3, 1, 2);
+
+    init_filter(&joint);
+    init_filter(&seq);
+    gsl_matrix_set(joint.H, 1, 2, 0.5);
+    gsl_matrix_set(seq.H, 1, 2, 0.5);
+    joint.update_mode = CFILT_KALMAN_UPDATE_JOINT;
+    seq.update_mode = CFILT_KALMAN_UPDATE_SEQUENTIAL;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &joint);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &joint);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &seq);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &seq);
+    }
+
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, joint.P, seq.P, 1e-9);
+    UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, joint.x, seq.x, 1e-9);
+    UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, joint.y, seq.y, 1e-9);
+
+    // A non positive scalar innovation variance falls back on the joint update
+    gsl_matrix_set(joint.R, 0, 0, -100.0);
+    gsl_matrix_set(seq.R, 0, 0, -100.0);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &joint);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &joint);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &seq);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &seq);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, joint.K, seq.K, 1e-9);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, joint.P, seq.P, 1e-9);
+    UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, joint.x, seq.x, 1e-9);
+
+    cfilt_kalman_filter_free(&joint);
+    cfilt_kalman_filter_free(&seq);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_filter_solve_dare(void)
+{
+    // The riccati solution is the limit of the regular recursion
+    cfilt_kalman_filter filt, steady;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &steady, 3, 1, 2);
+
+    init_filter(&filt);
+    init_filter(&steady);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+    }
+
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_solve_dare, &steady, 1e-12, 100);
+    UTEST_ASSERT(steady.steady_state, "Steady state mode was not enabled");
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.P_, steady.P_, 1e-6);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.P, steady.P, 1e-6);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.K, steady.K, 1e-6);
+
+    // Both filters now apply the same gain
+    gsl_vector_memcpy(steady.x, filt.x);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &steady);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &steady);
+    UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, filt.x, steady.x, 1e-6);
+
+    cfilt_kalman_filter_free(&filt);
+    cfilt_kalman_filter_free(&steady);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_filter_freeze(void)
+{
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 2);
+
+    init_filter(&filt);
+    filt.freeze_tol = 1e-9;
+    filt.freeze_window = 5;
+
+    for (int i = 0; i < 500 && !filt.steady_state; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+    }
+
+    UTEST_ASSERT(filt.steady_state, "P never converged");
+
+    // A skipped update resumes covariance propagation
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    UTEST_ASSERT(!filt.steady_state, "Skipped update did not unfreeze");
+
+    for (int i = 0; i < 500 && !filt.steady_state; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    }
+
+    UTEST_ASSERT(filt.steady_state, "P never converged");
+
+    // So does a new measurement model
+    gsl_matrix_scale(filt.R, 2.0);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+    UTEST_ASSERT(!filt.steady_state, "New R did not unfreeze");
+
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_filter_fixed(void)
+{
+    cfilt_kalman_filter fixed, generic;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &fixed, 3, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &generic, 3, 1, 2);
+
+    UTEST_ASSERT(fixed._predict_fixed && fixed._update_fixed,
+                 "No kernel selected for n = 3");
+    generic._predict_fixed = NULL;
+    generic._update_fixed = NULL;
+
+    init_filter(&fixed);
+    init_filter(&generic);
+    gsl_matrix_set(fixed.B, 2, 0, 1.0);
+    gsl_matrix_set(generic.B, 2, 0, 1.0);
+    gsl_vector_set(fixed.u, 0, 0.2);
+    gsl_vector_set(generic.u, 0, 0.2);
+    gsl_matrix_set(fixed.R, 0, 1, 0.3);
+    gsl_matrix_set(fixed.R, 1, 0, 0.3);
+    gsl_matrix_set(generic.R, 0, 1, 0.3);
+    gsl_matrix_set(generic.R, 1, 0, 0.3);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &fixed);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &fixed);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &generic);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &generic);
+    }
+
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, fixed.P_, generic.P_, 1e-12);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, fixed.P, generic.P, 1e-12);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, fixed.K, generic.K, 1e-12);
+    UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, fixed.x, generic.x, 1e-12);
+
+    cfilt_kalman_filter_free(&fixed);
+    cfilt_kalman_filter_free(&generic);
+
+    // Out of range dimensions keep the generic path
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &fixed, 9, 1, 2);
+    UTEST_ASSERT(!fixed._predict_fixed && !fixed._update_fixed,
+                 "Kernel selected for n = 9");
+    cfilt_kalman_filter_free(&fixed);
+
+    return GSL_SUCCESS;
+}
+
+// y^TS^-1y, log|S| and log N(z; Hx_, S) computed from scratch
+static int
+check_innovation_stats(cfilt_kalman_filter* filt)
+{
+    const size_t n = filt->F->size1;
+    const size_t k = filt->H->size1;
+
+    gsl_matrix* P_ = gsl_matrix_alloc(n, n);
+    gsl_matrix* HP = gsl_matrix_alloc(k, n);
+    gsl_matrix* S = gsl_matrix_alloc(k, k);
+    gsl_vector* y = gsl_vector_alloc(k);
+    cfilt_mahalanobis_workspace w;
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_workspace_alloc, &w, k);
+
+    gsl_matrix_memcpy(P_, filt->P_);
+    if (filt->cov_mode == CFILT_KALMAN_COVARIANCE_LOWER)
+    {
+        UTEST_EXEC_ASSERT(cfilt_matrix_symmetrize, P_, 0);
+    }
+
+    gsl_matrix_memcpy(S, filt->R);
+    gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, filt->H, P_, 0.0, HP);
+    gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, HP, filt->H, 1.0, S);
+    gsl_vector_memcpy(y, filt->z);
+    gsl_blas_dgemv(CblasNoTrans, -1.0, filt->H, filt->x_, 1.0, y);
+
+    double d;
+    UTEST_EXEC_ASSERT(cfilt_mahalanobis_ws, y, NULL, S, &w, &d);
+
+    double log_det = 0.0;
+    for (size_t i = 0; i < k; ++i)
+    {
+        log_det += 2.0 * log(gsl_matrix_get(w.L, i, i));
+    }
+
+    const double ll = -0.5 * (d * d + log_det + k * log(2.0 * M_PI));
+
+    UTEST_ASSERT(IS_EQ_TOL(filt->nis, d * d, 1e-9), "Wrong nis %f instead of %f",
+                 filt->nis, d * d);
+    UTEST_ASSERT(IS_EQ_TOL(filt->log_det_S, log_det, 1e-9),
+                 "Wrong log|S| %f instead of %f", filt->log_det_S, log_det);
+    UTEST_ASSERT(IS_EQ_TOL(filt->log_likelihood, ll, 1e-9),
+                 "Wrong log likelihood %f instead of %f", filt->log_likelihood,
+                 ll);
+
+    cfilt_mahalanobis_workspace_free(&w);
+    gsl_matrix_free(P_);
+    gsl_matrix_free(HP);
+    gsl_matrix_free(S);
+    gsl_vector_free(y);
+
+    return GSL_SUCCESS;
+}
+
+static int
+test_cfilt_kalman_filter_innovation_stats_(cfilt_kalman_update_mode mode,
+                                           cfilt_kalman_covariance_mode cov,
+                                           const int fixed, const int steady)
+{
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 2);
+
+    init_filter(&filt);
+    filt.update_mode = mode;
+    filt.cov_mode = cov;
+    filt.innovation_stats = 1;
+    if (!fixed)
+    {
+        filt._predict_fixed = NULL;
+        filt._update_fixed = NULL;
+    }
+
+    if (mode != CFILT_KALMAN_UPDATE_SEQUENTIAL)
+    {
+        gsl_matrix_set(filt.R, 0, 1, 0.3);
+        gsl_matrix_set(filt.R, 1, 0, 0.3);
+    }
+
+    if (steady)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_solve_dare, &filt, 1e-12, 100);
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+        gsl_vector_set(filt.z, 0, 0.3 * i);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+        UTEST_EXEC_ASSERT(check_innovation_stats, &filt);
+    }
+
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_filter_innovation_stats(void)
+{
+    const cfilt_kalman_update_mode joint = CFILT_KALMAN_UPDATE_JOINT;
+    const cfilt_kalman_covariance_mode full = CFILT_KALMAN_COVARIANCE_FULL;
+
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_innovation_stats_, joint, full,
+                      1, 0);
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_innovation_stats_, joint, full,
+                      0, 0);
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_innovation_stats_, joint,
+                      CFILT_KALMAN_COVARIANCE_LOWER, 0, 0);
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_innovation_stats_,
+                      CFILT_KALMAN_UPDATE_SEQUENTIAL, full, 0, 0);
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_innovation_stats_, joint, full,
+                      1, 1);
+
+    // Left alone unless asked for
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 2);
+    init_filter(&filt);
+    filt.nis = -1.0;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+    UTEST_ASSERT(filt.nis == -1.0, "nis computed without innovation_stats");
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+// Predictions of filt's estimate by ref, stepped in place, at the offsets
+static int
+check_horizon(cfilt_kalman_filter* ref, const size_t* offsets,
+              const size_t count, const gsl_matrix* X, const gsl_matrix* Ps)
+{
+    size_t t = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (; t < offsets[i]; ++t)
+        {
+            UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, ref);
+            gsl_vector_memcpy(ref->x, ref->x_);
+            gsl_matrix_memcpy(ref->P, ref->P_);
+        }
+
+        gsl_vector_const_view x = gsl_matrix_const_row(X, i);
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, &x.vector, ref->x, 1e-9);
+        if (Ps)
+        {
+            gsl_matrix_const_view P =
+              gsl_matrix_const_submatrix(Ps, i * 3, 0, 3, 3);
+            UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, &P.matrix, ref->P, 1e-9);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+test_cfilt_kalman_filter_predict_horizon_(const size_t levels)
+{
+    cfilt_kalman_filter filt, ref;
+    cfilt_kalman_horizon_workspace w;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &ref, 3, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_horizon_workspace_alloc, &w, 3, levels);
+
+    const size_t offsets[] = { 0, 1, 2, 3, 5, 8, 8, 13, 21, 40 };
+    const size_t count = sizeof(offsets) / sizeof(offsets[0]);
+    gsl_matrix* X = gsl_matrix_alloc(count, 3);
+    gsl_matrix* Ps = gsl_matrix_alloc(count * 3, 3);
+    gsl_matrix* X_ = gsl_matrix_alloc(count, 3);
+
+    // From the initial estimate of a fresh filter
+    init_filter(&filt);
+    filt.cov_mode = CFILT_KALMAN_COVARIANCE_LOWER;
+    gsl_matrix_set(filt.B, 2, 0, 0.05);
+    gsl_vector_set(filt.u, 0, 1.0);
+    gsl_vector_set(filt.x, 0, 2.0);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict_horizon, &filt, offsets,
+                      count, X, Ps, &w);
+    init_filter(&ref);
+    gsl_matrix_set(ref.B, 2, 0, 0.05);
+    gsl_vector_set(ref.u, 0, 1.0);
+    gsl_vector_set(ref.x, 0, 2.0);
+    UTEST_EXEC_ASSERT(check_horizon, &ref, offsets, count, X, Ps);
+
+    // From the posterior
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict_horizon, &filt, offsets,
+                      count, X, Ps, &w);
+    init_filter(&ref);
+    gsl_matrix_set(ref.B, 2, 0, 0.05);
+    gsl_vector_set(ref.u, 0, 1.0);
+    gsl_vector_set(ref.x, 0, 2.0);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &ref);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &ref);
+    UTEST_EXEC_ASSERT(check_horizon, &ref, offsets, count, X, Ps);
+
+    // From the prior, after Q changed
+    const size_t allocs = cfilt_allocator_get()->allocs;
+    gsl_matrix_set(filt.Q, 2, 2, 0.02);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict_horizon, &filt, offsets,
+                      count, X, Ps, &w);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict_horizon, &filt, offsets,
+                      count, X_, NULL, &w);
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs,
+                 "Horizon allocated");
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, X_, X, 0.0);
+
+    init_filter(&ref);
+    gsl_matrix_set(ref.B, 2, 0, 0.05);
+    gsl_vector_set(ref.u, 0, 1.0);
+    gsl_vector_set(ref.x, 0, 2.0);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &ref);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &ref);
+    gsl_matrix_set(ref.Q, 2, 2, 0.02);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &ref);
+    gsl_vector_memcpy(ref.x, ref.x_);
+    gsl_matrix_memcpy(ref.P, ref.P_);
+    UTEST_EXEC_ASSERT(check_horizon, &ref, offsets, count, X, Ps);
+
+    gsl_matrix_free(X);
+    gsl_matrix_free(X_);
+    gsl_matrix_free(Ps);
+    cfilt_kalman_horizon_workspace_free(&w);
+    cfilt_kalman_filter_free(&ref);
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_filter_predict_horizon(void)
+{
+    // Only 4 steps at a time with 3 levels
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_predict_horizon_, 3);
+    UTEST_EXEC_ASSERT(test_cfilt_kalman_filter_predict_horizon_, 6);
+
+    return GSL_SUCCESS;
+}
+
 int
 main(void)
 {
     RUN_TEST(test_cfilt_kalman_filter_alloc);
     RUN_TEST(test_cfilt_kalman_filter_predict);
     RUN_TEST(test_cfilt_kalman_filter_update);
+    RUN_TEST(test_cfilt_kalman_filter_gain);
+    RUN_TEST(test_cfilt_kalman_filter_covariance_lower);
+    RUN_TEST(test_cfilt_kalman_filter_update_sequential);
+    RUN_TEST(test_cfilt_kalman_filter_solve_dare);
+    RUN_TEST(test_cfilt_kalman_filter_freeze);
+    RUN_TEST(test_cfilt_kalman_filter_fixed);
+    RUN_TEST(test_cfilt_kalman_filter_innovation_stats);
+    RUN_TEST(test_cfilt_kalman_filter_predict_horizon);
 
     return GSL_SUCCESS;
 }
@@ -0,0 +1,176 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/kalman.h"
+#include "cfilt/kalman_bank.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+
+#define COUNT 11
+
+static void
+init_filter(cfilt_kalman_filter* filt, const size_t seed)
+{
+    // Constant velocity model with position and velocity sensors
+    const double dt = 0.1 * (1 + seed % 3);
+
+    gsl_matrix_set_identity(filt->F);
+    gsl_matrix_set(filt->F, 0, 1, dt);
+    gsl_matrix_set_zero(filt->B);
+    gsl_matrix_set_identity(filt->Q);
+    gsl_matrix_scale(filt->Q, 0.01);
+    gsl_matrix_set_identity(filt->P);
+    gsl_matrix_scale(filt->P, 1.0 + seed);
+    gsl_matrix_set_identity(filt->H);
+    gsl_matrix_set_identity(filt->R);
+    gsl_matrix_set(filt->R, 0, 1, 0.5);
+    gsl_matrix_set(filt->R, 1, 0, 0.5);
+
+    gsl_vector_set(filt->x, 0, seed);
+    gsl_vector_set(filt->x, 1, 1.0);
+    gsl_vector_set_zero(filt->u);
+    gsl_vector_set(filt->z, 0, seed + 0.5);
+    gsl_vector_set(filt->z, 1, 0.8);
+}
+
+int
+test_cfilt_kalman_bank_alloc(void)
+{
+    cfilt_kalman_bank bank;
+
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_kalman_bank_alloc, &bank, 0, 2, 1, 1);
+    UTEST_EXEC_ASSERT_(cfilt_kalman_bank_alloc, &bank, 4, 1, 1, 1);
+    gsl_set_error_handler(hdl);
+
+    UTEST_EXEC_ASSERT(cfilt_kalman_bank_alloc, &bank, COUNT, 2, 1, 1);
+    cfilt_kalman_bank_free(&bank);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_bank_step(void)
+{
+    // Every lane must follow its scalar counterpart
+    cfilt_kalman_bank bank;
+    cfilt_kalman_filter filt, lane;
+    UTEST_EXEC_ASSERT(cfilt_kalman_bank_alloc, &bank, COUNT, 2, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 2, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &lane, 2, 1, 2);
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        init_filter(&filt, i);
+        UTEST_EXEC_ASSERT(cfilt_kalman_bank_load, &bank, i, &filt);
+    }
+
+    for (size_t step = 0; step < 3; ++step)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_bank_predict, &bank);
+        UTEST_EXEC_ASSERT(cfilt_kalman_bank_update, &bank);
+    }
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        init_filter(&filt, i);
+        for (size_t step = 0; step < 3; ++step)
+        {
+            UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+            UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+        }
+
+        UTEST_EXEC_ASSERT(cfilt_kalman_bank_store, &bank, i, &lane);
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, filt.x, lane.x, 1e-9);
+        UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.P, lane.P, 1e-9);
+    }
+
+    cfilt_kalman_filter_free(&lane);
+    cfilt_kalman_filter_free(&filt);
+    cfilt_kalman_bank_free(&bank);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_kalman_bank_degenerate(void)
+{
+    // A negative R makes S indefinite in one lane only
+    const size_t bad = 5;
+    cfilt_kalman_bank bank;
+    cfilt_kalman_filter filt, lane;
+    UTEST_EXEC_ASSERT(cfilt_kalman_bank_alloc, &bank, COUNT, 2, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 2, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &lane, 2, 1, 2);
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        init_filter(&filt, i);
+        if (i == bad)
+        {
+            gsl_matrix_scale(filt.R, -100.0);
+        }
+
+        UTEST_EXEC_ASSERT(cfilt_kalman_bank_load, &bank, i, &filt);
+    }
+
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT(cfilt_kalman_bank_predict, &bank);
+    UTEST_ASSERT(cfilt_kalman_bank_update(&bank) == GSL_EDOM,
+                 "Degenerate lane went unreported");
+    gsl_set_error_handler(hdl);
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        UTEST_EXEC_ASSERT(cfilt_kalman_bank_store, &bank, i, &lane);
+        if (i == bad)
+        {
+            UTEST_ASSERT(bank.status[i] == GSL_EDOM, "Lane %zu not flagged", i);
+            UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, lane.x, lane.x_, 0.0);
+            UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, lane.P, lane.P_, 0.0);
+            continue;
+        }
+
+        init_filter(&filt, i);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+
+        UTEST_ASSERT(bank.status[i] == GSL_SUCCESS, "Lane %zu flagged", i);
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, filt.x, lane.x, 1e-9);
+        UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.P, lane.P, 1e-9);
+    }
+
+    cfilt_kalman_filter_free(&lane);
+    cfilt_kalman_filter_free(&filt);
+    cfilt_kalman_bank_free(&bank);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_kalman_bank_alloc);
+    RUN_TEST(test_cfilt_kalman_bank_step);
+    RUN_TEST(test_cfilt_kalman_bank_degenerate);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,267 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/oosm.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STEPS 20
+#define DEPTH 8
+
+static void
+init_filter(cfilt_kalman_filter* filt)
+{
+    gsl_matrix_set_identity(filt->F);
+    gsl_matrix_set_zero(filt->B);
+    gsl_matrix_set(filt->B, 2, 0, 0.5);
+    gsl_matrix_set_identity(filt->Q);
+    gsl_matrix_scale(filt->Q, 0.01);
+    gsl_matrix_set_identity(filt->P);
+    gsl_matrix_set_zero(filt->H);
+    gsl_matrix_set(filt->H, 0, 0, 1.0);
+    gsl_matrix_set_identity(filt->R);
+    gsl_vector_set_zero(filt->x);
+    gsl_vector_set(filt->u, 0, 1.0);
+}
+
+// Step t of the run, there is no measurement at t = 12. With varying, the
+// time step changes every 10 steps and the control every step.
+static int
+step(cfilt_kalman_filter* filt, const size_t t, const int varying)
+{
+    const size_t dt = varying ? 1 + t / 10 : 1;
+    gsl_matrix_set(filt->F, 0, 1, 0.1 * dt);
+    gsl_matrix_set(filt->F, 1, 2, 0.1 * dt);
+    gsl_matrix_set(filt->Q, 2, 2, 0.01 * dt);
+    if (varying)
+    {
+        gsl_vector_set(filt->u, 0, t % 2 ? -1.0 : 2.0);
+    }
+
+    gsl_vector_set(filt->z, 0, 0.05 * t * t + (t % 3 ? 0.2 : -0.3));
+
+    EXEC_ASSERT(cfilt_kalman_filter_predict, filt);
+    if (t != 12)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_update, filt);
+    }
+
+    return GSL_SUCCESS;
+}
+
+static double
+late_z(const size_t t)
+{
+    return 0.05 * t * t + 0.1;
+}
+
+// Applies the late measurement of step t in sequence
+static int
+late_update(cfilt_kalman_filter* filt, const size_t t)
+{
+    if (filt->_updated)
+    {
+        EXEC_ASSERT(gsl_vector_memcpy, filt->x_, filt->x);
+        EXEC_ASSERT(gsl_matrix_memcpy, filt->P_, filt->P);
+    }
+
+    gsl_vector_set(filt->z, 0, late_z(t));
+    return cfilt_kalman_filter_update(filt);
+}
+
+// Run up to step last with the late measurements of steps a and b in
+// sequence
+static int
+reference(cfilt_kalman_filter* filt, const size_t last, const size_t a,
+          const size_t b, const int varying)
+{
+    init_filter(filt);
+    for (size_t t = 0; t <= last; ++t)
+    {
+        EXEC_ASSERT(step, filt, t, varying);
+        if (t == a)
+        {
+            EXEC_ASSERT(late_update, filt, t);
+        }
+
+        if (t == b)
+        {
+            EXEC_ASSERT(late_update, filt, t);
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+static int
+late(cfilt_oosm* oosm, cfilt_kalman_filter* filt, const size_t t,
+     const size_t s, gsl_vector* z)
+{
+    gsl_vector_set(z, 0, late_z(s));
+    return cfilt_oosm_update(oosm, filt, t - s, z);
+}
+
+static int
+check(const cfilt_kalman_filter* filt, const cfilt_kalman_filter* ref)
+{
+    EXEC_ASSERT(cfilt_vector_cmp_tol, filt->x, ref->x, 1e-9);
+    EXEC_ASSERT(cfilt_matrix_cmp_tol, filt->P, ref->P, 1e-9);
+    EXEC_ASSERT(cfilt_vector_cmp_tol, filt->x_, ref->x_, 1e-9);
+    EXEC_ASSERT(cfilt_matrix_cmp_tol, filt->P_, ref->P_, 1e-9);
+
+    return GSL_SUCCESS;
+}
+
+// Late measurements of steps a then b arrive at step 15
+static int
+test_cfilt_oosm_(const cfilt_oosm_mode mode, const size_t a, const size_t b,
+                 const int varying)
+{
+    cfilt_kalman_filter filt, ref;
+    cfilt_oosm oosm;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &ref, 3, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_oosm_alloc, &oosm, 3, 1, 1, DEPTH, varying);
+    gsl_vector* z = gsl_vector_alloc(1);
+    oosm.mode = mode;
+    init_filter(&filt);
+
+    const size_t allocs = cfilt_allocator_get()->allocs;
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        UTEST_EXEC_ASSERT(step, &filt, t, varying);
+        UTEST_EXEC_ASSERT(cfilt_oosm_push, &oosm, &filt);
+
+        if (t == 15)
+        {
+            UTEST_EXEC_ASSERT(late, &oosm, &filt, t, a, z);
+            UTEST_EXEC_ASSERT(reference, &ref, t, a, STEPS, varying);
+            UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, filt.x, ref.x, 1e-9);
+            UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, filt.P, ref.P, 1e-9);
+
+            UTEST_EXEC_ASSERT(late, &oosm, &filt, t, b, z);
+            UTEST_EXEC_ASSERT(reference, &ref, t, a, b, varying);
+            UTEST_EXEC_ASSERT(check, &filt, &ref);
+
+            // Past the oldest step held
+            gsl_set_error_handler_off();
+            UTEST_EXEC_ASSERT_(late, &oosm, &filt, t, t - DEPTH, z);
+        }
+    }
+
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs,
+                 "Measurement history allocated");
+
+    // Later steps carry the late measurements
+    UTEST_EXEC_ASSERT(reference, &ref, STEPS - 1, a, b, varying);
+    UTEST_EXEC_ASSERT(check, &filt, &ref);
+
+    gsl_vector_free(z);
+    cfilt_oosm_free(&oosm);
+    cfilt_kalman_filter_free(&ref);
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_oosm_replay(void)
+{
+    // Step 12 had no measurement, step 10 is replayed through it
+    return test_cfilt_oosm_(CFILT_OOSM_REPLAY, 12, 10, 1);
+}
+
+int
+test_cfilt_oosm_retrodict(void)
+{
+    // Step 14 is retrodicted, then replayed through by the one of step 11
+    return test_cfilt_oosm_(CFILT_OOSM_RETRODICT, 14, 11, 1);
+}
+
+int
+test_cfilt_oosm_retrodict_fixed(void)
+{
+    // The filter's F, Q and u are those of every step
+    return test_cfilt_oosm_(CFILT_OOSM_RETRODICT, 14, 11, 0);
+}
+
+int
+test_cfilt_oosm_retrodict_twice(void)
+{
+    // The second one of step 14 finds its posterior stale and replays
+    return test_cfilt_oosm_(CFILT_OOSM_RETRODICT, 14, 14, 1);
+}
+
+int
+test_cfilt_oosm_rewind(void)
+{
+    // Every step is retrodicted, a later measurement finds no posterior to
+    // rewind to and must leave the history as it was
+    cfilt_kalman_filter filt;
+    cfilt_oosm oosm;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_oosm_alloc, &oosm, 3, 1, 1, DEPTH, 1);
+    gsl_vector* z = gsl_vector_alloc(1);
+    oosm.mode = CFILT_OOSM_RETRODICT;
+    init_filter(&filt);
+
+    for (size_t t = 0; t <= DEPTH; ++t)
+    {
+        UTEST_EXEC_ASSERT(step, &filt, t, 1);
+        UTEST_EXEC_ASSERT(cfilt_oosm_push, &oosm, &filt);
+        if (t > 0)
+        {
+            UTEST_EXEC_ASSERT(late, &oosm, &filt, t, t - 1, z);
+        }
+    }
+
+    const size_t size = oosm.depth * oosm._record * sizeof(double);
+    double* data = malloc(size);
+    memcpy(data, oosm._data, size);
+
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(late, &oosm, &filt, DEPTH, DEPTH - 2, z);
+    gsl_set_error_handler(hdl);
+    UTEST_ASSERT(memcmp(data, oosm._data, size) == 0,
+                 "Failed update changed the history");
+
+    free(data);
+    gsl_vector_free(z);
+    cfilt_oosm_free(&oosm);
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_oosm_replay);
+    RUN_TEST(test_cfilt_oosm_retrodict);
+    RUN_TEST(test_cfilt_oosm_retrodict_fixed);
+    RUN_TEST(test_cfilt_oosm_retrodict_twice);
+    RUN_TEST(test_cfilt_oosm_rewind);
+
+    return GSL_SUCCESS;
+}
@@ -0,0 +1,217 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/rts.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#define STEPS 30
+
+static void
+init_filter(cfilt_kalman_filter* filt)
+{
+    gsl_matrix_set_identity(filt->F);
+    gsl_matrix_set(filt->F, 0, 1, 0.1);
+    gsl_matrix_set(filt->F, 1, 2, 0.1);
+    gsl_matrix_set_zero(filt->B);
+    gsl_matrix_set_identity(filt->Q);
+    gsl_matrix_scale(filt->Q, 0.01);
+    gsl_matrix_set_identity(filt->P);
+    gsl_matrix_set_zero(filt->H);
+    gsl_matrix_set(filt->H, 0, 0, 1.0);
+    gsl_matrix_set_identity(filt->R);
+    gsl_vector_set_zero(filt->x);
+    gsl_vector_set_zero(filt->u);
+}
+
+// Step t of the run, the time step changes every 10 steps and there is no
+// measurement at t = 12
+static int
+step(cfilt_kalman_filter* filt, const size_t t)
+{
+    gsl_matrix_set(filt->F, 0, 1, 0.1 * (1 + t / 10));
+    gsl_matrix_set(filt->F, 1, 2, 0.1 * (1 + t / 10));
+    gsl_vector_set(filt->z, 0, 0.05 * t * t + (t % 3 ? 0.2 : -0.3));
+
+    EXEC_ASSERT(cfilt_kalman_filter_predict, filt);
+    if (t != 12)
+    {
+        EXEC_ASSERT(cfilt_kalman_filter_update, filt);
+    }
+
+    return GSL_SUCCESS;
+}
+
+// Textbook smoother over arrays of matrices with explicit inverses
+static int
+reference(gsl_vector** xs, gsl_matrix** Ps)
+{
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 1);
+    init_filter(&filt);
+
+    gsl_vector* x_[STEPS];
+    gsl_matrix* P_[STEPS];
+    gsl_matrix* F[STEPS];
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        UTEST_EXEC_ASSERT(step, &filt, t);
+
+        x_[t] = gsl_vector_alloc(3);
+        P_[t] = gsl_matrix_alloc(3, 3);
+        F[t] = gsl_matrix_alloc(3, 3);
+        gsl_vector_memcpy(x_[t], filt.x_);
+        gsl_matrix_memcpy(P_[t], filt.P_);
+        gsl_matrix_memcpy(F[t], filt.F);
+        gsl_vector_memcpy(xs[t], t == 12 ? filt.x_ : filt.x);
+        gsl_matrix_memcpy(Ps[t], t == 12 ? filt.P_ : filt.P);
+    }
+
+    gsl_matrix* inv = gsl_matrix_alloc(3, 3);
+    gsl_matrix* C = gsl_matrix_alloc(3, 3);
+    gsl_matrix* T = gsl_matrix_alloc(3, 3);
+    gsl_matrix* D = gsl_matrix_alloc(3, 3);
+    gsl_vector* d = gsl_vector_alloc(3);
+    gsl_permutation* perm = gsl_permutation_alloc(3);
+
+    for (size_t t = STEPS - 1; t-- > 0;)
+    {
+        gsl_matrix_memcpy(D, P_[t + 1]);
+        UTEST_EXEC_ASSERT(cfilt_matrix_invert, D, inv, perm);
+        gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, Ps[t], F[t + 1], 0.0, T);
+        gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, T, inv, 0.0, C);
+
+        gsl_vector_memcpy(d, xs[t + 1]);
+        gsl_vector_sub(d, x_[t + 1]);
+        gsl_blas_dgemv(CblasNoTrans, 1.0, C, d, 1.0, xs[t]);
+
+        gsl_matrix_memcpy(D, Ps[t + 1]);
+        gsl_matrix_sub(D, P_[t + 1]);
+        gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, C, D, 0.0, T);
+        gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, T, C, 1.0, Ps[t]);
+    }
+
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        gsl_vector_free(x_[t]);
+        gsl_matrix_free(P_[t]);
+        gsl_matrix_free(F[t]);
+    }
+
+    gsl_matrix_free(inv);
+    gsl_matrix_free(C);
+    gsl_matrix_free(T);
+    gsl_matrix_free(D);
+    gsl_vector_free(d);
+    gsl_permutation_free(perm);
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+static int
+test_cfilt_rts_smooth_(const char* path)
+{
+    gsl_vector* xs[STEPS];
+    gsl_matrix* Ps[STEPS];
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        xs[t] = gsl_vector_alloc(3);
+        Ps[t] = gsl_matrix_alloc(3, 3);
+    }
+
+    UTEST_EXEC_ASSERT(reference, xs, Ps);
+
+    cfilt_kalman_filter filt;
+    cfilt_rts rts;
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 3, 1, 1);
+    UTEST_EXEC_ASSERT(cfilt_rts_alloc, &rts, 3, STEPS, 1, path);
+    init_filter(&filt);
+
+    const size_t allocs = cfilt_allocator_get()->allocs;
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        UTEST_EXEC_ASSERT(step, &filt, t);
+        UTEST_EXEC_ASSERT(cfilt_rts_record, &rts, &filt);
+    }
+
+    gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_rts_record, &rts, &filt);
+
+    UTEST_EXEC_ASSERT(cfilt_rts_smooth, &rts);
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs,
+                 "Smoother allocated");
+
+    gsl_vector* x = gsl_vector_alloc(3);
+    gsl_matrix* P = gsl_matrix_alloc(3, 3);
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        UTEST_EXEC_ASSERT(cfilt_rts_get, &rts, t, x, P);
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, x, xs[t], 1e-9);
+        UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, P, Ps[t], 1e-9);
+    }
+
+    gsl_vector_free(x);
+    gsl_matrix_free(P);
+    for (size_t t = 0; t < STEPS; ++t)
+    {
+        gsl_vector_free(xs[t]);
+        gsl_matrix_free(Ps[t]);
+    }
+
+    cfilt_rts_free(&rts);
+    cfilt_kalman_filter_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_rts_smooth(void)
+{
+    return test_cfilt_rts_smooth_(NULL);
+}
+
+int
+test_cfilt_rts_smooth_mapped(void)
+{
+    char path[] = "/tmp/cfilt_rts_XXXXXX";
+    const int fd = mkstemp(path);
+    UTEST_ASSERT(fd >= 0, "Could not create a temporary file");
+    close(fd);
+
+    const int status = test_cfilt_rts_smooth_(path);
+    unlink(path);
+
+    return status;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_rts_smooth);
+    RUN_TEST(test_cfilt_rts_smooth_mapped);
+
+    return GSL_SUCCESS;
+}
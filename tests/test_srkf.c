@@ -0,0 +1,111 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/kalman.h"
+#include "cfilt/srkf.h"
+#include "utest.h"
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+int
+test_cfilt_srkf_alloc(void)
+{
+    cfilt_srkf filt;
+
+    gsl_error_handler_t* hdl = gsl_set_error_handler_off();
+    UTEST_EXEC_ASSERT_(cfilt_srkf_alloc, &filt, 0, 3, 3);
+    gsl_set_error_handler(hdl);
+
+    UTEST_EXEC_ASSERT(cfilt_srkf_alloc, &filt, 3, 3, 3);
+    cfilt_srkf_free(&filt);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_srkf_step(void)
+{
+    // Must match the covariance form filter : P = SS^T
+    cfilt_srkf srkf;
+    cfilt_kalman_filter kf;
+    UTEST_EXEC_ASSERT(cfilt_srkf_alloc, &srkf, 3, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &kf, 3, 1, 2);
+
+    gsl_matrix_set_identity(kf.F);
+    gsl_matrix_set(kf.F, 0, 1, 0.1);
+    gsl_matrix_set(kf.F, 1, 2, 0.1);
+    gsl_matrix_set_zero(kf.B);
+    gsl_matrix_set_identity(kf.Q);
+    gsl_matrix_scale(kf.Q, 0.04);
+    gsl_matrix_set_identity(kf.P);
+    gsl_matrix_set_zero(kf.H);
+    gsl_matrix_set(kf.H, 0, 0, 1.0);
+    gsl_matrix_set(kf.H, 1, 1, 1.0);
+    gsl_matrix_set_identity(kf.R);
+    gsl_matrix_scale(kf.R, 0.25);
+    gsl_vector_set_zero(kf.x);
+    gsl_vector_set_zero(kf.u);
+
+    gsl_matrix_memcpy(srkf.F, kf.F);
+    gsl_matrix_memcpy(srkf.B, kf.B);
+    gsl_matrix_memcpy(srkf.H, kf.H);
+    gsl_matrix_set_identity(srkf.Q);
+    gsl_matrix_scale(srkf.Q, 0.2);
+    gsl_matrix_set_identity(srkf.S);
+    gsl_matrix_set_identity(srkf.R);
+    gsl_matrix_scale(srkf.R, 0.5);
+    gsl_vector_set_zero(srkf.x);
+    gsl_vector_set_zero(srkf.u);
+
+    gsl_matrix* P = gsl_matrix_alloc(3, 3);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        gsl_vector_set(kf.z, 0, 0.1 * i);
+        gsl_vector_set(kf.z, 1, 1.0);
+        gsl_vector_memcpy(srkf.z, kf.z);
+
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &kf);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &kf);
+        UTEST_EXEC_ASSERT(cfilt_srkf_predict, &srkf);
+        UTEST_EXEC_ASSERT(cfilt_srkf_update, &srkf);
+    }
+
+    UTEST_EXEC_ASSERT(gsl_blas_dgemm, CblasNoTrans, CblasTrans, 1.0, srkf.S,
+                      srkf.S, 0.0, P);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, kf.P, P, 1e-9);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, kf.K, srkf.K, 1e-9);
+    UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, kf.x, srkf.x, 1e-9);
+
+    gsl_matrix_free(P);
+    cfilt_kalman_filter_free(&kf);
+    cfilt_srkf_free(&srkf);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_srkf_alloc);
+    RUN_TEST(test_cfilt_srkf_step);
+
+    return GSL_SUCCESS;
+}
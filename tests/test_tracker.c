@@ -0,0 +1,393 @@
+/**
+ * Copyright 2020 Feras Boulala <ferasboulala@gmail.com>
+ *
+ * This file is part of cfilt.
+ *
+ * cfilt is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cfilt is distributed in the hope it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cfilt. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cfilt/tracker.h"
+#include "cfilt/util.h"
+#include "utest.h"
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+
+int
+test_cfilt_tracker_assign(void)
+{
+    cfilt_tracker tr;
+    UTEST_EXEC_ASSERT(cfilt_tracker_alloc, &tr, 2, 1, 1, 4, 4);
+
+    // Greedy would give row 0 column 0 for a total of 1 + 9
+    const double cells[3][4] = {
+        { 1.0, 2.0, GSL_POSINF, 8.0 },
+        { 2.0, GSL_POSINF, 9.0, GSL_POSINF },
+        { GSL_POSINF, GSL_POSINF, GSL_POSINF, GSL_POSINF },
+    };
+
+    gsl_matrix* cost = gsl_matrix_alloc(3, 4);
+    gsl_matrix* cost_t = gsl_matrix_alloc(4, 3);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        for (size_t j = 0; j < 4; ++j)
+        {
+            gsl_matrix_set(cost, i, j, cells[i][j]);
+            gsl_matrix_set(cost_t, j, i, cells[i][j]);
+        }
+    }
+
+    size_t row_of[4];
+    UTEST_EXEC_ASSERT(cfilt_tracker_assign, &tr, cost, 3, 4, row_of);
+    UTEST_ASSERT(row_of[0] == 1 && row_of[1] == 0 &&
+                   row_of[2] == CFILT_TRACKER_NONE &&
+                   row_of[3] == CFILT_TRACKER_NONE,
+                 "Wrong assignment %zu %zu %zu %zu", row_of[0], row_of[1],
+                 row_of[2], row_of[3]);
+
+    // Same problem with more rows than columns
+    UTEST_EXEC_ASSERT(cfilt_tracker_assign, &tr, cost_t, 4, 3, row_of);
+    UTEST_ASSERT(row_of[0] == 1 && row_of[1] == 0 &&
+                   row_of[2] == CFILT_TRACKER_NONE,
+                 "Wrong transposed assignment %zu %zu %zu", row_of[0],
+                 row_of[1], row_of[2]);
+
+    gsl_matrix_free(cost);
+    gsl_matrix_free(cost_t);
+    cfilt_tracker_free(&tr);
+
+    return GSL_SUCCESS;
+}
+
+// Constant velocity targets in the plane, state (px, py, vx, vy)
+static void
+init_model(cfilt_kalman_filter* model)
+{
+    gsl_matrix_set_identity(model->F);
+    gsl_matrix_set(model->F, 0, 2, 1.0);
+    gsl_matrix_set(model->F, 1, 3, 1.0);
+    gsl_matrix_set_zero(model->B);
+    gsl_matrix_set_identity(model->Q);
+    gsl_matrix_scale(model->Q, 0.01);
+    gsl_matrix_set_identity(model->P);
+    gsl_matrix_set(model->P, 2, 2, 4.0);
+    gsl_matrix_set(model->P, 3, 3, 4.0);
+    gsl_matrix_set_zero(model->H);
+    gsl_matrix_set(model->H, 0, 0, 1.0);
+    gsl_matrix_set(model->H, 1, 1, 1.0);
+    gsl_matrix_set_identity(model->R);
+    gsl_matrix_scale(model->R, 0.01);
+    gsl_vector_set_zero(model->u);
+}
+
+static int
+run_scenario(const cfilt_tracker_mode mode)
+{
+    const double start[3][2] = { { 0.0, 0.0 }, { 50.0, 0.0 }, { 0.0, 50.0 } };
+    const double speed[3][2] = { { 1.0, 0.5 }, { -1.0, 1.0 }, { 0.5, -1.0 } };
+
+    cfilt_tracker tr;
+    UTEST_EXEC_ASSERT(cfilt_tracker_alloc, &tr, 4, 1, 2, 8, 8);
+    init_model(&tr.model);
+    tr.mode = mode;
+    tr.max_misses = 2;
+
+    gsl_matrix* Z = gsl_matrix_alloc(4, 2);
+    size_t ids[3];
+    const size_t allocs = cfilt_allocator_get()->allocs;
+
+    for (size_t t = 0; t < 20; ++t)
+    {
+        // Target 2 disappears after t = 9, clutter shows up at t = 5
+        const size_t targets = t < 10 ? 3 : 2;
+        const size_t D = targets + (t == 5);
+        gsl_matrix_view rows = gsl_matrix_submatrix(Z, 0, 0, D, 2);
+
+        // Reversed order on odd frames
+        for (size_t i = 0; i < targets; ++i)
+        {
+            const size_t row = t % 2 ? targets - 1 - i : i;
+            gsl_matrix_set(Z, row, 0, start[i][0] + t * speed[i][0]);
+            gsl_matrix_set(Z, row, 1, start[i][1] + t * speed[i][1]);
+        }
+
+        if (t == 5)
+        {
+            gsl_matrix_set(Z, targets, 0, 1000.0);
+            gsl_matrix_set(Z, targets, 1, 1000.0);
+        }
+
+        UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, &rows.matrix);
+
+        // Every target keeps the track it started with
+        for (size_t i = 0; i < targets; ++i)
+        {
+            const size_t row = t % 2 ? targets - 1 - i : i;
+
+            const cfilt_track* track = NULL;
+            for (size_t a = 0; a < tr.count; ++a)
+            {
+                if (tr.tracks[tr.active[a]].detection == row)
+                {
+                    track = &tr.tracks[tr.active[a]];
+                }
+            }
+
+            UTEST_ASSERT(track, "Target %zu lost at t = %zu", i, t);
+            if (t == 0)
+            {
+                ids[i] = track->id;
+            }
+
+            UTEST_ASSERT(track->id == ids[i], "Target %zu switched at t = %zu",
+                         i, t);
+        }
+
+        // Tracks are deleted on their third consecutive miss
+        const size_t clutter = t >= 5 && t < 8;
+        const size_t expected = (t < 12 ? 3 : 2) + clutter;
+        UTEST_ASSERT(tr.count == expected, "%zu tracks at t = %zu", tr.count,
+                     t);
+    }
+
+    // The velocity is recovered
+    for (size_t a = 0; a < tr.count; ++a)
+    {
+        const cfilt_track* track = &tr.tracks[tr.active[a]];
+        const size_t i = track->id == ids[0] ? 0 : 1;
+        UTEST_ASSERT(IS_EQ_TOL(gsl_vector_get(track->filt.x, 2), speed[i][0],
+                               1e-2),
+                     "Wrong velocity for target %zu", i);
+    }
+
+    UTEST_ASSERT(cfilt_allocator_get()->allocs == allocs,
+                 "Tracker steps allocated");
+
+    gsl_matrix_free(Z);
+    cfilt_tracker_free(&tr);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_tracker_step(void)
+{
+    return run_scenario(CFILT_TRACKER_GNN);
+}
+
+int
+test_cfilt_tracker_miss_freeze(void)
+{
+    // A lone target whose track froze its gain is missed once, the track
+    // keeps following a plain filter that skipped the update
+    cfilt_tracker tr;
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_tracker_alloc, &tr, 4, 1, 2, 4, 4);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 4, 1, 2);
+    init_model(&tr.model);
+    init_model(&filt);
+    tr.model.freeze_tol = 1e-9;
+    tr.model.freeze_window = 3;
+    filt.freeze_tol = 1e-9;
+    filt.freeze_window = 3;
+
+    gsl_matrix* Z = gsl_matrix_alloc(1, 2);
+    gsl_matrix_set(Z, 0, 0, 0.0);
+    gsl_matrix_set(Z, 0, 1, 0.0);
+    UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, Z);
+
+    const cfilt_kalman_filter* track = &tr.tracks[tr.active[0]].filt;
+    for (size_t t = 1; t < 200; ++t)
+    {
+        gsl_matrix_set(Z, 0, 0, t + 0.1 * sin(t));
+        gsl_matrix_set(Z, 0, 1, 0.5 * t + 0.1 * cos(t));
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+
+        // Clutter far away instead of the target at t = 150
+        if (t == 150)
+        {
+            gsl_matrix_set(Z, 0, 0, 1000.0);
+            gsl_matrix_set(Z, 0, 1, 1000.0);
+            UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, Z);
+            UTEST_ASSERT(track->steady_state, "Track did not freeze");
+
+            gsl_vector_memcpy(filt.x, filt.x_);
+            gsl_matrix_memcpy(filt.P, filt.P_);
+        }
+        else
+        {
+            UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, Z);
+
+            gsl_vector_set(filt.z, 0, gsl_matrix_get(Z, 0, 0));
+            gsl_vector_set(filt.z, 1, gsl_matrix_get(Z, 0, 1));
+            UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+        }
+
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, track->x, filt.x, 1e-6);
+        UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, track->P, filt.P, 1e-9);
+    }
+
+    UTEST_ASSERT(track->steady_state, "Track did not freeze again");
+
+    gsl_matrix_free(Z);
+    cfilt_kalman_filter_free(&filt);
+    cfilt_tracker_free(&tr);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_tracker_jpda(void)
+{
+    UTEST_EXEC_ASSERT(run_scenario, CFILT_TRACKER_JPDA);
+
+    // A lone detection that is almost surely the target is a kalman update
+    cfilt_tracker tr;
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_tracker_alloc, &tr, 4, 1, 2, 4, 4);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 4, 1, 2);
+    init_model(&tr.model);
+    init_model(&filt);
+    tr.mode = CFILT_TRACKER_JPDA;
+    tr.pd = 1.0 - 1e-12;
+
+    gsl_matrix* Z = gsl_matrix_alloc(2, 2);
+    gsl_matrix_set(Z, 0, 0, 1.0);
+    gsl_matrix_set(Z, 0, 1, 2.0);
+    gsl_matrix_view first = gsl_matrix_submatrix(Z, 0, 0, 1, 2);
+    UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, &first.matrix);
+
+    gsl_vector_set(filt.x, 0, 1.0);
+    gsl_vector_set(filt.x, 1, 2.0);
+    gsl_vector_set(filt.z, 0, 1.5);
+    gsl_vector_set(filt.z, 1, 2.5);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+
+    gsl_matrix_set(Z, 0, 0, 1.5);
+    gsl_matrix_set(Z, 0, 1, 2.5);
+    UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, &first.matrix);
+
+    const cfilt_kalman_filter* track = &tr.tracks[tr.active[0]].filt;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        UTEST_ASSERT(IS_EQ_TOL(gsl_vector_get(track->x, i),
+                               gsl_vector_get(filt.x, i), 1e-6),
+                     "Wrong state");
+        for (size_t j = 0; j < 4; ++j)
+        {
+            UTEST_ASSERT(IS_EQ_TOL(gsl_matrix_get(track->P, i, j),
+                                   gsl_matrix_get(filt.P, i, j), 1e-6),
+                         "Wrong covariance");
+        }
+    }
+
+    cfilt_tracker_free(&tr);
+
+    // Two tracks sharing a detection halfway are pulled alike
+    UTEST_EXEC_ASSERT(cfilt_tracker_alloc, &tr, 4, 1, 2, 4, 4);
+    init_model(&tr.model);
+    tr.mode = CFILT_TRACKER_JPDA;
+
+    gsl_matrix_set(Z, 0, 0, -1.0);
+    gsl_matrix_set(Z, 0, 1, 0.0);
+    gsl_matrix_set(Z, 1, 0, 1.0);
+    gsl_matrix_set(Z, 1, 1, 0.0);
+    UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, Z);
+
+    gsl_matrix_set(Z, 0, 0, 0.0);
+    UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, &first.matrix);
+    UTEST_ASSERT(tr.count == 2, "%zu tracks", tr.count);
+
+    const double a = gsl_vector_get(tr.tracks[tr.active[0]].filt.x, 0);
+    const double b = gsl_vector_get(tr.tracks[tr.active[1]].filt.x, 0);
+    UTEST_ASSERT(IS_EQ_TOL(a, -b, 1e-9) && fabs(a) < 1.0 && fabs(a) > 0.0,
+                 "Asymmetric update %f %f", a, b);
+    UTEST_ASSERT(tr.tracks[tr.active[0]].detection == 0 &&
+                   tr.tracks[tr.active[1]].detection == 0,
+                 "Shared detection not associated");
+
+    gsl_matrix_free(Z);
+    cfilt_kalman_filter_free(&filt);
+    cfilt_tracker_free(&tr);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_tracker_jpda_freeze(void)
+{
+    // A lone target seen every step follows a plain filter, freezes like it
+    // and keeps its steady state
+    cfilt_tracker tr;
+    cfilt_kalman_filter filt;
+    UTEST_EXEC_ASSERT(cfilt_tracker_alloc, &tr, 4, 1, 2, 4, 4);
+    UTEST_EXEC_ASSERT(cfilt_kalman_filter_alloc, &filt, 4, 1, 2);
+    init_model(&tr.model);
+    init_model(&filt);
+    tr.mode = CFILT_TRACKER_JPDA;
+    tr.pd = 1.0 - 1e-12;
+    tr.model.freeze_tol = 1e-9;
+    tr.model.freeze_window = 3;
+    tr.model.innovation_stats = 1;
+    filt.freeze_tol = 1e-9;
+    filt.freeze_window = 3;
+    filt.innovation_stats = 1;
+
+    gsl_matrix* Z = gsl_matrix_alloc(1, 2);
+    gsl_matrix_set(Z, 0, 0, 0.0);
+    gsl_matrix_set(Z, 0, 1, 0.0);
+    UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, Z);
+
+    const cfilt_kalman_filter* track = &tr.tracks[tr.active[0]].filt;
+    for (size_t t = 1; t < 200; ++t)
+    {
+        gsl_matrix_set(Z, 0, 0, t + 0.1 * sin(t));
+        gsl_matrix_set(Z, 0, 1, 0.5 * t + 0.1 * cos(t));
+        UTEST_EXEC_ASSERT(cfilt_tracker_step, &tr, Z);
+
+        gsl_vector_set(filt.z, 0, gsl_matrix_get(Z, 0, 0));
+        gsl_vector_set(filt.z, 1, gsl_matrix_get(Z, 0, 1));
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_predict, &filt);
+        UTEST_EXEC_ASSERT(cfilt_kalman_filter_update, &filt);
+
+        UTEST_ASSERT(tr.count == 1, "%zu tracks at t = %zu", tr.count, t);
+        UTEST_EXEC_ASSERT(cfilt_vector_cmp_tol, track->x, filt.x, 1e-6);
+        UTEST_ASSERT(IS_EQ_TOL(track->nis, filt.nis, 1e-6) &&
+                       IS_EQ_TOL(track->log_likelihood, filt.log_likelihood,
+                                 1e-6),
+                     "Innovation stats differ at t = %zu", t);
+    }
+
+    UTEST_ASSERT(filt.steady_state, "Reference filter did not freeze");
+    UTEST_ASSERT(track->steady_state, "JPDA track did not freeze");
+
+    gsl_matrix_free(Z);
+    cfilt_kalman_filter_free(&filt);
+    cfilt_tracker_free(&tr);
+
+    return GSL_SUCCESS;
+}
+
+int
+main(void)
+{
+    RUN_TEST(test_cfilt_tracker_assign);
+    RUN_TEST(test_cfilt_tracker_step);
+    RUN_TEST(test_cfilt_tracker_miss_freeze);
+    RUN_TEST(test_cfilt_tracker_jpda);
+    RUN_TEST(test_cfilt_tracker_jpda_freeze);
+
+    return GSL_SUCCESS;
+}
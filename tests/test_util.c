@@ -69,6 +69,63 @@ test_cfilt_matrix_invert(void)
     return GSL_SUCCESS;
 }
 
+int
+test_cfilt_matrix_cholesky(void)
+{
+    gsl_matrix* src = gsl_matrix_alloc(2, 2);
+    gsl_matrix* sol = gsl_matrix_alloc(2, 2);
+
+    gsl_matrix_set(src, 0, 0, 4.0);
+    gsl_matrix_set(src, 0, 1, 2.0);
+    gsl_matrix_set(src, 1, 0, 2.0);
+    gsl_matrix_set(src, 1, 1, 5.0);
+
+    gsl_matrix_set(sol, 0, 0, 2.0);
+    gsl_matrix_set(sol, 0, 1, 2.0);
+    gsl_matrix_set(sol, 1, 0, 1.0);
+    gsl_matrix_set(sol, 1, 1, 2.0);
+
+    // The upper triangle is left untouched
+    UTEST_EXEC_ASSERT(cfilt_matrix_cholesky, src);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, src, sol, 0.1);
+
+    // Not positive definite
+    gsl_matrix_set_identity(src);
+    gsl_matrix_set(src, 1, 1, -1.0);
+    UTEST_EXEC_ASSERT_(cfilt_matrix_cholesky, src);
+
+    gsl_matrix_free(src);
+    gsl_matrix_free(sol);
+
+    return GSL_SUCCESS;
+}
+
+int
+test_cfilt_matrix_sym_pack(void)
+{
+    gsl_matrix* src = gsl_matrix_alloc(3, 3);
+    gsl_matrix* dst = gsl_matrix_alloc(3, 3);
+    double packed[6];
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        for (size_t j = 0; j < 3; ++j)
+        {
+            gsl_matrix_set(src, i, j, i + j);
+        }
+    }
+
+    UTEST_EXEC_ASSERT(cfilt_matrix_sym_pack, src, packed);
+    UTEST_ASSERT(packed[4] == 3.0, "Unexpected packed layout");
+    UTEST_EXEC_ASSERT(cfilt_matrix_sym_unpack, packed, dst);
+    UTEST_EXEC_ASSERT(cfilt_matrix_cmp_tol, src, dst, 0.1);
+
+    gsl_matrix_free(src);
+    gsl_matrix_free(dst);
+
+    return GSL_SUCCESS;
+}
+
 int
 test_cfilt_matrix_tri_zero(void)
 {
@@ -211,6 +268,8 @@ int
 main(void)
 {
     RUN_TEST(test_cfilt_matrix_invert);
+    RUN_TEST(test_cfilt_matrix_cholesky);
+    RUN_TEST(test_cfilt_matrix_sym_pack);
     RUN_TEST(test_cfilt_matrix_tri_zero);
     RUN_TEST(test_cfilt_matrix_cmp);
     RUN_TEST(test_cfilt_matrix_cmp_tol);